@@ -0,0 +1,31 @@
+#ifndef BOOT_H
+#define BOOT_H
+
+#include "main.h"
+
+// --- Boot Timing ---
+// After a reset (brown-out while cranking, watchdog, !RST) the outputs are
+// restored from the backup registers before the clocks are set up, see
+// GPIO_Status_Restore(). This module measures how long that and the first
+// received CAN frame take, counted from the start of main():
+//
+//   "!BOT:RST,<POR|PIN|SFT|IWDG|WWDG|LPWR>"  reset cause (after !OK:INIT)
+//   "!BOT:OUT,<us>,<pins>"  outputs valid, pins restored (GPIOB, hex)
+//   "!BOT:CAN,<us>"         first frame through the filters (when it comes)
+//   !BOT                    all three again (CAN "-" if none yet), then
+//                            "!BOT:END"
+//
+// Until SystemClock_Config() switches to the PLL the core runs from the
+// 8 MHz HSI, so early times are DWT cycles / 8; later ones continue from
+// Sched_Micros(). The startup code before main() (.data/.bss setup) is not
+// included.
+#define BOOT_HSI_MHZ  8U
+
+void Boot_Start(void);                    // First thing in main(): cycle counter, reset cause
+void Boot_OutputsValid(uint16_t pins);    // After GPIO_Status_Restore()
+void Boot_ClockReady(void);               // After SystemClock_Config(), before Perf_Init()
+void Boot_Report(void);                   // After !OK:INIT
+void Boot_FirstFrame(uint32_t stamp_us);  // From the decoder, per frame (returns at once after the first)
+void Boot_Command(const char *value);     // Handles the value of !BOT
+
+#endif // BOOT_H
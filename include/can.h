@@ -9,10 +9,28 @@ extern CAN_HandleTypeDef hcan; // Declare hcan as external
 #endif
 
 void CAN_Init(void);
-void CAN_Transmit(uint32_t id, uint8_t *data, uint8_t len);
+bool CAN_Transmit(uint32_t id, const uint8_t *data, uint8_t len); // Non-blocking, see can_tx.h
+void CAN_ProcessPending(void); // Drain the RX rings, call from the main loop
 void ProcessCanMessage(uint32_t can_id, uint8_t *data, uint8_t data_len);
 #ifndef USE_QEMU
+// --- RX Paths ---
+// FIFO0 (sets A/B, sniffer: the high-rate IDs): the interrupt copies frames
+// into its RX ring and everything else happens in the main loop.
+// FIFO1 (bank 12, CAN_FILTER_FIFO1_SIGNALS: key, reverse gear): the RX1
+// interrupt runs at IRQ_PRIO_CAN_FAST and drives the outputs that follow
+// CAN_FILTER_FAST_SIGNALS straight away (REV -> REAR), before queuing the
+// frame in the FIFO1 ring. It is the only reader of FIFO1: the HAL callback
+// reached from the other vectors leaves frames to it. Each FIFO counts its own full and overrun events
+// (!BUS FULL/FOVR for FIFO0, FULL1/FOVR1 for FIFO1).
+void USB_LP_CAN1_RX0_IRQHandler(void);
+void CAN1_RX1_IRQHandler(void);
+void USB_HP_CAN1_TX_IRQHandler(void);
+void CAN1_SCE_IRQHandler(void);
+void HAL_CAN_ErrorCallback(CAN_HandleTypeDef *hcan);
+void HAL_CAN_RxFifo0FullCallback(CAN_HandleTypeDef *hcan);
 void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan);
+void HAL_CAN_RxFifo1FullCallback(CAN_HandleTypeDef *hcan);
+void HAL_CAN_RxFifo1MsgPendingCallback(CAN_HandleTypeDef *hcan);
 #endif
 
 #endif // CAN_H
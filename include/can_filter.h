@@ -0,0 +1,62 @@
+#ifndef CAN_FILTER_H
+#define CAN_FILTER_H
+
+#include "main.h"
+#include "signal_db.h"
+
+// --- CAN Acceptance Filter Manager ---
+// The set of wanted IDs is generated from the signal table (signal_db.h) with
+// the live configuration and packed
+// four per bank in 16-bit identifier-list mode. Banks are split into two sets
+// that are used alternately: the new filters are programmed and enabled in the
+// idle set before the old set is disabled, so reprogramming at runtime never
+// drops a wanted frame.
+//
+// Bank layout (STM32F103, banks 0..13 belong to CAN1):
+//   0..5   set A, FIFO0
+//   6..11  set B, FIFO0
+//   12     FIFO1: the IDs carrying CAN_FILTER_FIFO1_SIGNALS
+//   13     sniffer, FIFO0: one 16-bit mask filter that accepts everything. List
+//          entries win over mask entries, so wanted IDs keep their FMI.
+#define CAN_FILTER_SET_BANKS 6
+#define CAN_FILTER_FIFO1_BANK 12
+#define CAN_FILTER_SNIFFER_BANK 13
+#define CAN_FILTER_IDS_PER_BANK 4
+#define CAN_FILTER_MAX_IDS (CAN_FILTER_SET_BANKS * CAN_FILTER_IDS_PER_BANK)
+
+// --- FIFO Split ---
+// FIFO0 takes the high-rate periodic IDs (ignition, dashboard 0x128, ...)
+// and FIFO1 the low-rate ones that must not wait: IDs carrying
+// CAN_FILTER_FIFO1_SIGNALS are left out of sets A/B and listed in bank 12
+// instead, those with CAN_FILTER_FAST_SIGNALS first. A burst on FIFO0
+// can then no longer overrun a key press or reverse gear frame; each FIFO
+// has its own three slots, interrupt and full/overrun counters (can.h).
+// Frames of CAN_FILTER_FAST_SIGNALS also drive their outputs straight from
+// the FIFO1 interrupt (fast path).
+//
+// Bank 12's FIFO1 filter numbers are reported as CAN_FILTER_FIFO1_FMI + n,
+// after both sets. It is reprogrammed in place between enabling the new
+// set and retiring the old one, so a moved ID is always matched by one of
+// them. IDs beyond its four slots stay in FIFO0.
+#define CAN_FILTER_FAST_SIGNALS SIG_BIT(REV)
+#define CAN_FILTER_FIFO1_SIGNALS (CAN_FILTER_FAST_SIGNALS | SIG_BIT(KEY))
+#define CAN_FILTER_FIFO1_FMI (2 * CAN_FILTER_MAX_IDS)
+
+#define CAN_FILTER_NO_FMI 0xFF
+#define CAN_FILTER_NO_ENTRY 0xFF
+
+// --- Payload Cache ---
+// Most wanted IDs are periodic broadcasts that repeat the same payload. The
+// last DLC and payload of every filter entry are kept, and a frame equal to
+// them is not decoded again (one 64-bit compare). Reprogramming a set
+// invalidates its entries. Hits and misses are counted in !STA (CHIT, CMISS).
+
+bool CAN_Filter_Apply(void); // Recompute from config and reprogram if changed
+// Signals carried by a frame; *entry is its filter entry (CAN_FILTER_NO_ENTRY if none)
+SignalMask CAN_Filter_SignalsFor(uint32_t fmi, uint32_t id, uint8_t *entry);
+bool CAN_Filter_IsRepeat(uint8_t entry, const uint8_t *data, uint8_t dlc); // Same payload as last time
+SignalMask CAN_Filter_Fifo1SignalsFor(uint32_t fmi, uint32_t id); // Interrupt-safe, bank 12 only
+uint8_t CAN_Filter_GetIds(const uint16_t **ids); // Currently programmed IDs (sets A/B)
+bool CAN_Filter_SetSniffer(bool open); // Accept every frame (sniffer mode) or only wanted IDs
+
+#endif // CAN_FILTER_H
@@ -0,0 +1,77 @@
+#ifndef CAN_HEALTH_H
+#define CAN_HEALTH_H
+
+#include "main.h"
+
+// --- CAN Bus Health ---
+// The controller runs with AutoBusOff disabled, so bus-off is left in
+// software: EVT_CAN_HEALTH restarts the controller (HAL_CAN_Stop/Start)
+// after a back-off that starts at CAN_HEALTH_BACKOFF_MIN_MS and doubles on
+// every bus-off in a row up to CAN_HEALTH_BACKOFF_MAX_MS. Once the bus has
+// stayed up for CAN_HEALTH_STABLE_MS the back-off starts over. A controller
+// that does not start at boot is retried the same way instead of halting.
+//
+// The status change interrupt counts error-warning, error-passive and
+// bus-off transitions and the last error codes; the periodic sample keeps
+// the state and the TEC/REC peaks. Bus load is estimated from the frames the
+// acceptance filters pass (all frames while the sniffer is on), so it is a
+// lower bound.
+//
+// Each receive FIFO counts its own overruns (a frame lost because all three
+// mailboxes were taken) and the times it filled up, so a flood on FIFO0
+// shows up there without hiding what happened to the FIFO1 IDs.
+//
+//   !BUS / !BUS:GET   "!BUS:STATE,<ACTIVE|WARN|PASSIVE|OFF>", one
+//                     "!BUS:<counter>,<value>" line per counter, then
+//                     "!BUS:END"
+//   !BUS:RST          zero the counters, answers "!OK:BUS"
+//
+// State changes are also reported unprompted as "!BUS:STATE,<state>".
+#define CAN_HEALTH_PERIOD_MS       100
+#define CAN_HEALTH_BACKOFF_MIN_MS  100
+#define CAN_HEALTH_BACKOFF_MAX_MS  5000
+#define CAN_HEALTH_STABLE_MS       10000
+#define CAN_HEALTH_BITRATE         125000U
+
+typedef enum {
+    CAN_BUS_ACTIVE,  // Error active, TEC and REC < 96
+    CAN_BUS_WARNING, // TEC or REC >= 96
+    CAN_BUS_PASSIVE, // TEC or REC >= 128
+    CAN_BUS_OFF,     // TEC > 255, or the controller could not be started
+} CanBusState;
+
+#define CAN_HEALTH_COUNTERS(X)    \
+    X(warnings,   "EWG")          \
+    X(passives,   "EPV")          \
+    X(bus_offs,   "BOFF")         \
+    X(recoveries, "RECOV")        \
+    X(stuff,      "STF")          \
+    X(form,       "FOR")          \
+    X(ack,        "ACK")          \
+    X(bit_rec,    "BR")           \
+    X(bit_dom,    "BD")           \
+    X(crc,        "CRC")          \
+    X(overruns,   "FOVR")         /* FIFO0 */ \
+    X(fulls,      "FULL")         /* FIFO0 */ \
+    X(overruns1,  "FOVR1")        \
+    X(fulls1,     "FULL1")        \
+    X(tec_max,    "TECMAX")       \
+    X(rec_max,    "RECMAX")       \
+    X(load,       "LOAD")         // Per mille, last CAN_HEALTH_PERIOD_MS
+
+typedef struct {
+#define CAN_HEALTH_COUNTER_FIELD(name, tag) uint32_t name;
+    CAN_HEALTH_COUNTERS(CAN_HEALTH_COUNTER_FIELD)
+#undef CAN_HEALTH_COUNTER_FIELD
+} CanHealthStats;
+
+void CAN_Health_Started(bool started);     // CAN_Init: controller start result
+void CAN_Health_OnError(uint32_t error_code); // From HAL_CAN_ErrorCallback
+void CAN_Health_OnFifoFull(uint32_t fifo); // From the FIFO full interrupt
+void CAN_Health_OnFrame(uint32_t fifo, uint8_t dlc); // From that FIFO's RX interrupt, for the bus load
+void CAN_Health_Service(void);             // EVT_CAN_HEALTH: sample, recover
+void CAN_Health_Command(const char *value); // Handles the value of !BUS
+CanBusState CAN_Health_GetState(void);
+void CAN_Health_GetStats(CanHealthStats *stats);
+
+#endif // CAN_HEALTH_H
@@ -0,0 +1,54 @@
+#ifndef CAN_PERIODIC_H
+#define CAN_PERIODIC_H
+
+#include "main.h"
+
+// --- Periodic CAN TX ---
+// Frames the box sends on its own: keep-alive/presence messages some units
+// expect, or emulated frames such as the rear camera power request. Each
+// slot has an ID, payload, period and phase, and an optional condition on
+// a boolean signal from SIGNAL_TABLE. It is released only while that signal
+// is on (or off).
+//
+// Slots are released from the TIM3 update interrupt at 1 kHz, not from the
+// main loop, so decoding or a UART burst cannot delay them. A slot is due
+// when (ms % period) == phase on the timer's millisecond count. Slots with
+// the same period and different phases therefore never share a tick. The
+// frame goes through the CAN TX queue, which hands it to a free mailbox
+// straight away.
+//
+// A release that finds the previous frame of the slot still queued (bus
+// busy, bus-off) is skipped and counted as missed, so stale copies never
+// pile up. Jitter is the deviation of the release-to-release interval from
+// the period, in us.
+//
+//   !PTX:SET:<slot>,<id>,<period ms>,<phase ms>,<cond>,<data>
+//        id and data in hex; cond is "-" (always), "<signal>" (while on)
+//        or "!<signal>" (while off), e.g. !PTX:SET:0,1A0,100,0,REV,0102
+//   !PTX:DEL:<slot>        stop and free the slot
+//   !PTX / !PTX:GET        "!PTX:<slot>,<id>,<period>,<phase>,<cond>,<data>,
+//                          <sent>,<missed>,<jitter mean>,<jitter max>" per
+//                          slot in use, then "!PTX:END"
+//   !PTX:RST               zero the counters
+//
+// Slots are not saved: the head unit sets them up after every "!OK:INIT".
+#define CAN_PERIODIC_SLOTS     8
+#define CAN_PERIODIC_MAX_MS    60000
+#define CAN_PERIODIC_ALWAYS    0xFF // Condition: no signal
+
+typedef struct {
+    uint32_t sent;       // Released into the TX queue
+    uint32_t missed;     // Due, but the previous frame had not left or the queue was full
+    uint32_t jitter_sum; // us, over jitter_count intervals
+    uint32_t jitter_count;
+    uint32_t jitter_max;
+} CanPeriodicStats;
+
+void CAN_Periodic_Init(void);               // TIM3 at 1 kHz, after CAN_Init
+void CAN_Periodic_Command(const char *value); // Handles the value of !PTX
+void CAN_Periodic_GetStats(uint8_t slot, CanPeriodicStats *stats);
+#ifndef USE_QEMU
+void TIM3_IRQHandler(void);
+#endif
+
+#endif // CAN_PERIODIC_H
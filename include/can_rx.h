@@ -0,0 +1,44 @@
+#ifndef CAN_RX_H
+#define CAN_RX_H
+
+#include "main.h"
+
+// --- CAN RX Rings ---
+// One single-producer/single-consumer ring per receive FIFO, between its RX
+// interrupt (producer) and the main loop (consumer). Each ring has exactly
+// one producer, so neither side masks interrupts, even though the FIFO1
+// interrupt preempts the FIFO0 one. The ISRs only copy frames in; all
+// decoding happens in the main loop, so the hardware FIFOs are emptied as
+// fast as possible. The consumer takes FIFO1's latency-critical frames first.
+#define CAN_RX_RING_SIZE       32 // FIFO0, must be a power of two
+#define CAN_RX_FIFO1_RING_SIZE 8  // FIFO1 (a few low-rate IDs), must be a power of two
+
+#define CAN_RX_ID_EXT 0x80000000U // Set in id for a 29-bit identifier (sniffer only)
+#define CAN_RX_MAX_DLC 8          // Classic CAN: DLC 9-15 still carry 8 data bytes
+
+typedef enum {
+    CAN_RX_RING_FIFO0,
+    CAN_RX_RING_FIFO1,
+    CAN_RX_RING_COUNT
+} CanRxRingId;
+
+typedef struct {
+    uint32_t id;        // Standard identifier, or extended | CAN_RX_ID_EXT
+    uint32_t stamp_us;  // Sched_Micros() at reception
+    uint8_t dlc;        // 0..CAN_RX_MAX_DLC, clamped on reception
+    uint8_t fmi;        // Filter match index (CAN_FILTER_NO_FMI if unknown)
+    uint8_t data[8];
+} CanRxFrame;
+
+typedef struct {
+    uint32_t pushed;     // Frames accepted into the ring
+    uint32_t overflows;  // Frames dropped because the ring was full
+    uint32_t high_water; // Highest fill level seen
+} CanRxRingStats;
+
+bool CAN_RxRing_Push(CanRxRingId ring, const CanRxFrame *frame); // That ring's ISR only
+bool CAN_RxRing_Pop(CanRxFrame *frame);        // Consumer (main loop) side only, FIFO1 first
+void CAN_RxRing_GetStats(CanRxRingId ring, CanRxRingStats *stats);
+void CAN_RxRing_ResetStats(void);
+
+#endif // CAN_RX_H
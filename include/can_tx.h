@@ -0,0 +1,37 @@
+#ifndef CAN_TX_H
+#define CAN_TX_H
+
+#include "main.h"
+
+// --- CAN TX Queue ---
+// Software queue in front of the three bxCAN mailboxes, ordered by CAN
+// priority (lowest ID first) and refilled from the TX-mailbox-empty interrupt.
+// The controller runs without automatic retransmission, so every failed
+// attempt comes back to us and is retried here a bounded number of times,
+// ahead of any newer frame with the same ID.
+#define CAN_TX_QUEUE_SIZE   16
+#define CAN_TX_MAX_ATTEMPTS 3   // Transmit errors tolerated per frame before abort
+#define CAN_TX_MAX_AGE_MS   100 // Frames older than this are dropped (queued too long)
+#define CAN_TX_STATS_SLOTS  8   // Distinct IDs with their own counters
+
+//   !CTX / !CTX:GET   "!CTX:<id>,<sent>,<aborted>,<expired>,<rejected>" per ID
+//                     sent so far ("OTH" for the IDs beyond
+//                     CAN_TX_STATS_SLOTS), then "!CTX:END"
+//   !CTX:RST          zero the counters, answers "!OK:CTX"
+
+typedef struct {
+    uint32_t id;
+    uint32_t sent;
+    uint32_t aborted;  // Gave up after CAN_TX_MAX_ATTEMPTS or aborted in a mailbox
+    uint32_t expired;  // Waited longer than CAN_TX_MAX_AGE_MS
+    uint32_t rejected; // Queue was full
+} CanTxIdStats;
+
+bool CAN_TxQueue_Push(uint32_t id, const uint8_t *data, uint8_t len); // Thread or ISR context
+void CAN_TxQueue_Service(void);                 // Main loop: expire stale frames
+void CAN_TxQueue_OnError(uint32_t error_code);  // From HAL_CAN_ErrorCallback
+bool CAN_TxQueue_IsPending(uint32_t id);        // A frame with this ID is queued or in a mailbox
+const CanTxIdStats *CAN_TxQueue_GetStats(uint8_t *count);
+void CAN_TxQueue_Command(const char *value);    // Handles the value of !CTX
+
+#endif // CAN_TX_H
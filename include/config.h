@@ -2,6 +2,8 @@
 #define CONFIG_H
 
 #include "main.h"
+#include "keys.h" // For the key timing defaults
+#include "status.h" // For the delta window default
 
 // --- CAN IDs (Configurable - Defaults) ---
 // Default values, can be overridden by loading from flash
@@ -11,6 +13,46 @@
 #define REVERSE_GEAR_ID            0x0F6
 #define DOOR_STATUS_ID             0x220
 
+// --- Parameter Registry ---
+// One line per parameter. The order is also the storage order in the flash
+// record, so a new parameter may only be appended. min/max are inclusive;
+// CONFIG_HEX values are read and shown in hex, CONFIG_DEC in decimal.
+// CONFIG_REFILTER parameters are CAN IDs: changing one reprograms the
+// acceptance filters.
+//
+//   !CFG:GET:<name>        "!CFG:<name>:<value>"
+//   !CFG:GET:*             every parameter, one line each, then "!CFG:END"
+//   !CFG:SET:<name>:<value>[,<name>:<value>...]
+//                          all or nothing: one bad entry rejects the line.
+//                          Applied and saved at once, or staged while a
+//                          transaction is open.
+//   !CFG:BEGIN             open a transaction
+//   !CFG:COMMIT            apply everything staged, one flash save
+//   !CFG:ABORT             drop everything staged
+//
+// Every SET, BEGIN, COMMIT and ABORT is answered with "!OK:CFG" or an error.
+#define CONFIG_HEX      0x01
+#define CONFIG_DEC      0x02
+#define CONFIG_REFILTER 0x10
+
+//  name           variable              default                 min   max     flags
+#define CONFIG_TABLE(X) \
+    X(ign_src,       config_ign_src,       IGNITION_STATUS_ID,     0,    0x7FF,  CONFIG_HEX | CONFIG_REFILTER) \
+    X(illum_src,     config_illum_src,     DASHBOARD_LIGHTS_ID,    0,    0x7FF,  CONFIG_HEX | CONFIG_REFILTER) \
+    X(rev_src,       config_rev_src,       REVERSE_GEAR_ID,        0,    0x7FF,  CONFIG_HEX | CONFIG_REFILTER) \
+    X(park_src,      config_park_src,      DASHBOARD_LIGHTS_ID,    0,    0x7FF,  CONFIG_HEX | CONFIG_REFILTER) \
+    X(door_src,      config_door_src,      DOOR_STATUS_ID,         0,    0x7FF,  CONFIG_HEX | CONFIG_REFILTER) \
+    X(key_long_ms,   config_key_long_ms,   KEY_LONG_MS_DEFAULT,    100,  10000,  CONFIG_DEC) \
+    X(key_repeat_ms, config_key_repeat_ms, KEY_REPEAT_MS_DEFAULT,  50,   5000,   CONFIG_DEC) \
+    X(sts_win_ms,    config_sts_win_ms,    STATUS_WINDOW_MS_DEFAULT, 0,  1000,   CONFIG_DEC)
+
+typedef enum {
+#define CONFIG_PARAM_ENUM(name, var, def, min, max, flags) CFG_##name,
+    CONFIG_TABLE(CONFIG_PARAM_ENUM)
+#undef CONFIG_PARAM_ENUM
+    CFG_COUNT
+} ConfigParam;
+
 // Function prototypes for config
 void load_config(void);
 void save_config(void);
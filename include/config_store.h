@@ -0,0 +1,37 @@
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include "main.h"
+
+// --- Flash Config Store ---
+// Append-only log of config records spread over CONFIG_STORE_PAGES flash
+// pages. Every record is a full, CRC-protected snapshot with a sequence
+// number; at startup the newest valid one wins, so a record torn by a
+// reset is simply skipped and the previous one is used.
+//
+// Saving only stages the snapshot. EVT_CONFIG_WRITE then programs it one
+// half-word per scheduler pass, so CAN and UART events run between the
+// ~50 us flash writes. A page is erased only when the active one is full:
+// the next page is erased and the snapshot starts it (compaction). That
+// erase is the one step that still stalls the core, once every
+// CONFIG_STORE_SLOTS saves.
+
+// *IMPORTANT*: the pages must lie past the end of the program (check the .map file)
+#define CONFIG_STORE_ADDRESS   0x0800F000
+#define CONFIG_STORE_PAGES     2
+#define CONFIG_STORE_PAGE_SIZE 1024 // 2048 on high-density parts
+#define CONFIG_RECORD_SIZE     64   // One slot: header, payload and CRC
+#define CONFIG_RECORD_PAYLOAD  (CONFIG_RECORD_SIZE - 12)
+#define CONFIG_STORE_SLOTS     (CONFIG_STORE_PAGE_SIZE / CONFIG_RECORD_SIZE)
+
+// Scans the pages, call once at startup before any save. Copies up to size
+// bytes of the newest record into data and returns how many were copied
+// (0: no valid record). *version is the layout version it was saved with.
+uint8_t ConfigStore_Load(void *data, uint8_t size, uint8_t *version);
+// Stages a snapshot (size <= CONFIG_RECORD_PAYLOAD). A save made while a
+// record is being written is queued behind it; only the latest is kept.
+bool ConfigStore_Save(const void *data, uint8_t size, uint8_t version);
+bool ConfigStore_Busy(void);
+void ConfigStore_Service(void); // EVT_CONFIG_WRITE handler: one program step
+
+#endif // CONFIG_STORE_H
@@ -0,0 +1,15 @@
+#ifndef CRC16_H
+#define CRC16_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --- CRC-16/CCITT-FALSE ---
+// Polynomial 0x1021, initial value 0xFFFF, no reflection or final XOR.
+// Pass CRC16_INIT to start and the previous result to continue a CRC
+// over several buffers.
+#define CRC16_INIT 0xFFFFU
+
+uint16_t Crc16(uint16_t crc, const void *data, size_t len);
+
+#endif // CRC16_H
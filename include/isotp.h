@@ -0,0 +1,70 @@
+#ifndef ISOTP_H
+#define ISOTP_H
+
+#include "main.h"
+
+// --- ISO-TP Receiver (ISO 15765-2) ---
+// Reassembles segmented messages (first frame + consecutive frames) for the
+// IDs in ISOTP_TABLE and hands complete payloads to the entry's handler.
+// Single frames are delivered straight from the CAN frame.
+//
+// Buffers come from a static pool of ISOTP_SESSIONS, so memory is fixed at
+// ISOTP_SESSIONS * ISOTP_MAX_PAYLOAD bytes. Every ID reassembles into its own
+// session, so a slow sender never holds up another one. A first frame that
+// finds the pool full, or announces more than ISOTP_MAX_PAYLOAD bytes, is
+// dropped (and refused with a flow-control overflow when we are the
+// addressee). A session that sees no consecutive frame for ISOTP_TIMEOUT_MS
+// (N_Cr) is abandoned; the buffer is reclaimed by the next first frame.
+//
+//   fc id    0: passive. Another ECU is the addressee and sends the flow
+//            control; we only listen to the transfer.
+//            Otherwise, active: we are the addressee and answer first
+//            frames with flow control on this ID.
+//
+// Consecutive frames are processed as they arrive, so separation time
+// (STmin) is 0 and the block size is ISOTP_BLOCK_SIZE.
+#define ISOTP_SESSIONS     2
+#define ISOTP_MAX_PAYLOAD  160  // Largest accepted message, bytes (ISO-TP allows 4095)
+#define ISOTP_TIMEOUT_MS   1000 // N_Cr
+#define ISOTP_BLOCK_SIZE   0    // Consecutive frames per flow control, 0 = all
+
+typedef void (*IsoTpHandler)(uint32_t id, const uint8_t *data, uint16_t len);
+
+void IsoTp_Forward(uint32_t id, const uint8_t *data, uint16_t len); // Hex to the head unit
+
+// Segmented messages on the 407 comfort bus (verify on your car)
+//  name        rx id  fc id  handler
+#define ISOTP_TABLE(X) \
+    X(RADIO_TEXT, 0x0A4, 0,     IsoTp_Forward)
+
+// Payloads forwarded by IsoTp_Forward() as "!TP:<id>,<offset>/<len>,<hex>",
+// ISOTP_FORWARD_CHUNK bytes per line; messages that do not fit into the
+// UART queue at once are dropped. ISOTP_MAX_PAYLOAD is capped so that the
+// largest message fits into the empty queue (UART_TX_RING_SIZE).
+#define ISOTP_FORWARD_CHUNK 20
+
+//   !ITP / !ITP:GET   one "!ITP:<counter>,<value>" line per counter, then
+//                     "!ITP:END"
+//   !ITP:RST          zero the counters, answers "!OK:ITP"
+#define ISOTP_COUNTERS(X)      \
+    X(single,    "SF")         \
+    X(complete,  "MF")         \
+    X(sequence,  "SEQ")        \
+    X(timeout,   "TMO")        \
+    X(oversize,  "BIG")        \
+    X(no_buffer, "BUSY")       \
+    X(aborted,   "ABRT")       \
+    X(forward_dropped, "FDROP")
+
+typedef struct {
+#define ISOTP_COUNTER_FIELD(name, tag) uint32_t name;
+    ISOTP_COUNTERS(ISOTP_COUNTER_FIELD)
+#undef ISOTP_COUNTER_FIELD
+} IsoTpStats;
+
+uint8_t IsoTp_GetIds(uint16_t *ids, uint8_t max); // IDs the acceptance filters must pass
+bool IsoTp_Receive(uint32_t id, const uint8_t *data, uint8_t dlc); // Main loop; false if not an ISO-TP ID
+void IsoTp_Command(const char *value); // Handles the value of !ITP
+void IsoTp_GetStats(IsoTpStats *stats);
+
+#endif // ISOTP_H
@@ -0,0 +1,50 @@
+#ifndef KEYS_H
+#define KEYS_H
+
+#include "main.h"
+
+// --- Steering Wheel Keys ---
+// 0x165 repeats the pressed-key bitmask in every frame for as long as the
+// keys are held. Each key in KEY_TABLE has its own press/hold/release state
+// machine, driven by frame arrival (Keys_Update) and a periodic tick
+// (EVT_KEYS), so the UART carries one line per user action instead of one
+// per frame:
+//
+//   "!KEY:VOL+"       press, once the bit has been stable for KEY_DEBOUNCE_MS
+//   "!KEY:OK:LONG"    KEY_HOLD_LONG keys, once, after config_key_long_ms
+//   "!KEY:VOL+"       KEY_HOLD_REPEAT keys, again every config_key_repeat_ms
+//                     once held for config_key_long_ms (auto-repeat)
+//   "!KEY:VOL+:UP"    release, also stable for KEY_DEBOUNCE_MS
+//
+// Several keys can be held at once. If 0x165 stops arriving for
+// KEY_TIMEOUT_MS the held keys are released.
+#define KEY_DEBOUNCE_MS 30
+#define KEY_TIMEOUT_MS  300
+#define KEY_SERVICE_MS  10 // EVT_KEYS timer period
+
+#define KEY_LONG_MS_DEFAULT   800
+#define KEY_REPEAT_MS_DEFAULT 200
+
+#define KEY_EVENT_LONG    "LONG"
+#define KEY_EVENT_RELEASE "UP"
+
+typedef enum {
+    KEY_HOLD_LONG,   // Holding sends :LONG once
+    KEY_HOLD_REPEAT, // Holding repeats the press
+} KeyHold;
+
+// Steering wheel key bits (fazerxlo/canbox naming)
+//  bit   name     hold
+#define KEY_TABLE(X)                    \
+    X(0x01, "SRC",   KEY_HOLD_LONG)     \
+    X(0x02, "VOL+",  KEY_HOLD_REPEAT)   \
+    X(0x04, "VOL-",  KEY_HOLD_REPEAT)   \
+    X(0x08, "SEEK+", KEY_HOLD_LONG)     \
+    X(0x10, "SEEK-", KEY_HOLD_LONG)     \
+    X(0x40, "OK",    KEY_HOLD_LONG)     \
+    X(0x80, "END",   KEY_HOLD_LONG)
+
+void Keys_Update(uint8_t bits); // Main loop, per 0x165 frame (from the decoder)
+void Keys_Service(void);        // EVT_KEYS: debounce, hold and timeout deadlines
+
+#endif // KEYS_H
@@ -12,6 +12,15 @@
 #define CMD_KEY         "KEY"
 #define CMD_GET_VER     "VER"
 #define CMD_CFG         "CFG"
+#define CMD_STATS       "STA"
+#define CMD_BIN         "BIN"
+#define CMD_SNIFF       "SNF"
+#define CMD_BUS         "BUS"
+#define CMD_PTX         "PTX"
+#define CMD_BOOT        "BOT"
+#define CMD_STATUS      "STS"
+#define CMD_ISOTP       "ITP"
+#define CMD_CAN_TX      "CTX"
 
 // --- CANBox -> Android Responses ---
 #define RESP_KEY        "KEY"
@@ -24,10 +33,20 @@
 #define RESP_VER        "VER"
 #define RESP_ERR        "ERR"
 #define RESP_CFG        "CFG"
+#define RESP_STATS      "STA"
+#define RESP_SNIFF      "SNF"
+#define RESP_ISOTP      "TP"
+#define RESP_BUS        "BUS"
+#define RESP_PTX        "PTX"
+#define RESP_BOOT       "BOT"
+#define RESP_STATUS     "STS"
+#define RESP_ISOTP_STATS "ITP"
+#define RESP_CAN_TX     "CTX"
 
 // --- Error Codes ---
 #define ERR_INVALID_COMMAND  "INVALID_CMD"
 #define ERR_INVALID_CONFIG   "INVALID_CFG"
+#define ERR_CONFIG_RANGE     "CFG_RANGE" // Value outside the parameter's range
 #define ERR_CAN_ERROR       "CAN_ERROR" // Generic CAN error
 
 // --- Ignition Modes (from 0x036) ---
@@ -37,14 +56,38 @@
 #define IGN_MODE_START      0x03
 #define IGN_MODE_UNKNOWN    0x07
 
+// --- Interrupt Priorities ---
+// NVIC_PRIORITYGROUP_4: 16 preemption levels, no subpriority; lower numbers
+// preempt higher ones. Grouped by how late each class may be:
+//   0  CAN RX FIFO1: the REV -> REAR fast path (can.h), under 1 ms
+//      from frame to pin
+//   1  the other CAN interrupts (RX FIFO0, TX mailboxes, status/error):
+//      they share HAL_CAN_IRQHandler() and must not preempt each other.
+//      FIFO0 has to be emptied within three frames.
+//   2  TIM3: periodic CAN TX release jitter
+//   3  USART1 and its DMA channels: the byte ring absorbs delays
+//   15 SysTick (TICK_INT_PRIORITY): tick and timer wheel
+// Decoding, UART messages and everything else run in the main loop.
+#define IRQ_PRIO_CAN_FAST  0
+#define IRQ_PRIO_CAN       1
+#define IRQ_PRIO_TIMER     2
+#define IRQ_PRIO_UART      3
+
 // --- UART Baud Rate ---
 #define UART_BAUD_RATE 38400 // Moved here from main.c
 
+// --- Common Functions (main.c) ---
+void SystemClock_Config(void);
+void Error_Handler(void);
+
 // --- Extern Declarations (for global variables) ---
 extern uint32_t config_ign_src;
 extern uint32_t config_illum_src;
 extern uint32_t config_rev_src;
 extern uint32_t config_park_src;
 extern uint32_t config_door_src;
+extern uint32_t config_key_long_ms;
+extern uint32_t config_key_repeat_ms;
+extern uint32_t config_sts_win_ms;
 
 #endif // MAIN_H
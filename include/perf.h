@@ -0,0 +1,132 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include "main.h"
+#include "signal_db.h" // SIG_COUNT, latency is kept per signal
+
+// --- Hot-Path Profiling ---
+// Sections are timed with the DWT cycle counter (72 cycles = 1 us at 72 MHz)
+// and keep count/min/max/total plus a log2 histogram. Event counters sit
+// alongside. FAST is the fast path (can.h), from the FIFO1 interrupt entry
+// to the output edge it causes; frames that change no pin are not timed.
+// Build with -D PERF_DISABLE to compile every probe out; the
+// QEMU build always does.
+//
+// !STA / !STA:GET   one "!STA:<section>,<n>,<min>,<mean>,<max>" line per
+//                   section, then "!STA:<counter>,<value>", "!STA:IDLE,<per
+//                   mille of time asleep>", then "!STA:END"
+// !STA:HIST         "!STA:<section>:H0,..." and ":H4,..." bucket counts
+// !STA:LAT          "!STA:LAT:<signal>,<n>,<min>,<mean>,<max>" in us, one
+//                   line per signal that has reported anything
+// !STA:LATH         "!STA:LAT:<signal>:H0,..." and ":H4,..." bucket counts
+// !STA:RST          zero everything, answers "!OK:STA"
+
+#if defined(USE_QEMU) && !defined(PERF_DISABLE)
+#define PERF_DISABLE
+#endif
+
+#define PERF_SECTIONS(X)          \
+    X(CAN_RX_ISR,  "CANRX")       \
+    X(CAN_FAST,    "FAST")        \
+    X(CAN_DECODE,  "DECODE")      \
+    X(UART_ISR,    "UARTIRQ")     \
+    X(UART_SEND,   "SEND")        \
+    X(EVENT_LATENCY, "EVLAT")     \
+    X(SLEEP,       "SLEEP")
+
+#define PERF_COUNTERS(X)          \
+    X(FRAMES_RX,      "RX")       /* FIFO0 */ \
+    X(FRAMES_RX1,     "RX1")      /* FIFO1 */ \
+    X(FRAMES_DECODED, "DEC")      \
+    X(FIFO_OVERRUNS,  "FOVR")     \
+    X(UART_BYTES,     "UTX")      \
+    X(CACHE_HITS,     "CHIT")     \
+    X(CACHE_MISSES,   "CMISS")    \
+    X(LATENCY_LOST,   "LATX")     // Messages not timed: PERF_LATENCY_HELD/MARKS full
+
+typedef enum {
+#define PERF_SECTION_ENUM(name, tag) PERF_##name,
+    PERF_SECTIONS(PERF_SECTION_ENUM)
+#undef PERF_SECTION_ENUM
+    PERF_SECTION_COUNT
+} PerfSection;
+
+typedef enum {
+#define PERF_COUNTER_ENUM(name, tag) PERF_CNT_##name,
+    PERF_COUNTERS(PERF_COUNTER_ENUM)
+#undef PERF_COUNTER_ENUM
+    PERF_COUNTER_COUNT
+} PerfCounter;
+
+// Bucket b counts runs of [2^(b+5), 2^(b+6)) cycles; the first bucket also
+// takes anything shorter and the last anything longer (< 64 ... >= 4096).
+#define PERF_HIST_BUCKETS 8
+
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+    uint32_t hist[PERF_HIST_BUCKETS];
+} PerfStats;
+
+#ifndef PERF_DISABLE
+extern volatile uint32_t perf_counters[PERF_COUNTER_COUNT];
+
+#define PERF_START(section)     uint32_t perf_start_##section = DWT->CYCCNT
+#define PERF_STOP(section)      Perf_Record(PERF_##section, DWT->CYCCNT - perf_start_##section)
+#define PERF_COUNT(counter, n)  (perf_counters[PERF_CNT_##counter] += (n))
+#else
+#define PERF_START(section)     do { } while (0)
+#define PERF_STOP(section)      do { } while (0)
+#define PERF_COUNT(counter, n)  do { } while (0)
+#endif
+
+// --- End-to-End Latency ---
+// From the CAN RX interrupt to the last byte of the resulting message
+// leaving the USART, per signal. The RX interrupt stamps each frame with
+// Sched_Micros(). While the frame is decoded that stamp is the current
+// origin, and every message queued for a signal holds on to it. Held
+// origins are turned into marks at the ring position where their message
+// ends once it is in the UART TX ring. At USART TC each mark the DMA has
+// passed is recorded, less the time the bytes after it took on the wire.
+// Frames that report nothing, and messages not caused by a frame (timers,
+// commands), are not measured.
+//
+// Bucket b counts [2^(b+8), 2^(b+9)) us (< 512 us ... >= 32.768 ms).
+#define PERF_LATENCY_HELD  8  // Messages per binary batch that are tracked
+#define PERF_LATENCY_MARKS 32 // Tracked messages in the UART TX ring
+
+#ifndef PERF_DISABLE
+#define PERF_LATENCY_BEGIN(stamp_us) Perf_LatencyBegin(stamp_us)
+#define PERF_LATENCY_SIGNAL(sig)     Perf_LatencySignal(sig)
+#define PERF_LATENCY_END()           Perf_LatencyBegin(PERF_LATENCY_NONE)
+#define PERF_LATENCY_HOLD()          Perf_LatencyHold()
+#define PERF_LATENCY_QUEUED(end)     Perf_LatencyQueued(end)
+#define PERF_LATENCY_DISCARD()       Perf_LatencyQueued(PERF_LATENCY_NONE)
+#define PERF_LATENCY_SENT(sent)      Perf_LatencySent(sent)
+#else
+#define PERF_LATENCY_BEGIN(stamp_us) do { } while (0)
+#define PERF_LATENCY_SIGNAL(sig)     do { } while (0)
+#define PERF_LATENCY_END()           do { } while (0)
+#define PERF_LATENCY_HOLD()          do { } while (0)
+#define PERF_LATENCY_QUEUED(end)     do { } while (0)
+#define PERF_LATENCY_DISCARD()       do { } while (0)
+#define PERF_LATENCY_SENT(sent)      do { } while (0)
+#endif
+
+#define PERF_LATENCY_NONE 0xFFFFFFFFU
+
+void Perf_Init(void);  // Enable the cycle counter, call once after clock setup
+void Perf_Record(PerfSection section, uint32_t cycles);
+void Perf_GetStats(PerfSection section, PerfStats *stats);
+void Perf_Reset(void);
+void Perf_Command(const char *value); // Handles the value of !STA
+void Perf_LatencyBegin(uint32_t stamp_us); // Main loop: frame being decoded (NONE = done)
+void Perf_LatencySignal(uint8_t sig);      // Main loop: signal about to report
+void Perf_LatencyHold(void);               // Any context: a message for the current origin was queued
+void Perf_LatencyQueued(uint32_t end);     // UART, masked: held messages end at ring position end
+void Perf_LatencySent(uint32_t sent);      // UART TC: ring position the wire has reached
+void Perf_GetLatency(uint8_t sig, PerfStats *stats);
+
+#endif // PERF_H
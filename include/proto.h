@@ -0,0 +1,47 @@
+#ifndef PROTO_H
+#define PROTO_H
+
+#include "main.h"
+
+// --- Binary Protocol ---
+// Optional framing for the Android link. The ASCII "!CMD:value\n" lines stay
+// the default; "!BIN:1" switches both directions to binary after the
+// "!OK:BIN" reply, "!BIN:0" (sent as a TEXT message) switches back, and a
+// reset always starts in ASCII.
+//
+// Frame on the wire:  COBS( message... | CRC-16 ) 0x00
+//   message           type (1 byte) | length (1 byte) | payload
+//   CRC-16            CCITT-FALSE over all messages, little-endian
+//
+// Messages queued during one scheduler pass share a frame (EVT_UART_FLUSH
+// sends it), so a burst of state changes costs one delimiter and one CRC.
+//
+// Types, either direction unless noted:
+//   PROTO_MSG_STATE   device -> head unit: repeated { signal id, value },
+//                     the id is the SignalId from signal_db.h and the value a
+//                     zigzag varint (bools 0/1, keys the raw key code)
+//   PROTO_MSG_TEXT    "TAG:value" as in the ASCII protocol, without '!' and
+//                     '\n'; carries every command and every other response
+//   PROTO_MSG_FRAME   device -> head unit, sniffer: timestamp (us, u32),
+//                     ID (u32, bit 31 = extended), DLC (0-8), data;
+//                     little-endian
+#define PROTO_MSG_STATE 0x01
+#define PROTO_MSG_TEXT  0x02
+#define PROTO_MSG_FRAME 0x03
+
+#define PROTO_FRAME_MAX 64 // Messages plus CRC, before COBS
+
+bool Proto_IsBinary(void);
+void Proto_Command(const char *value); // Handles the value of !BIN
+
+// Device -> head unit, binary mode only. Thread or ISR context.
+void Proto_SendText(const char *response, const char *value);
+void Proto_SendSignal(uint8_t signal, int32_t value);
+void Proto_SendFrame(uint32_t stamp_us, uint32_t id, uint8_t dlc, const uint8_t *data);
+void Proto_Flush(void); // EVT_UART_FLUSH handler: send the pending frame
+
+// Head unit -> device: one frame without its 0x00 delimiter, decoded in
+// place. Returns false (and drops it) on a COBS, CRC or length error.
+bool Proto_Receive(uint8_t *frame, uint16_t len);
+
+#endif // PROTO_H
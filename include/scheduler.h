@@ -0,0 +1,42 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "main.h"
+
+// --- Event Scheduler ---
+// Interrupts post event bits; the main loop sleeps in WFI until at least one
+// is set and then runs the handlers in bit order (lowest bit first), so an
+// event waits at most for the handlers already running plus the ones ahead
+// of it. Periodic jobs come from a timer wheel advanced by SysTick, which
+// posts their event when they fall due.
+//
+// Event-to-handler latency and the time spent asleep are recorded in the
+// !STA sections EVLAT and SLEEP (see perf.h); IDLE reports the sleep share.
+
+typedef enum {
+    EVT_CAN_RX,         // Frames waiting in the CAN RX ring
+    EVT_UART_RX,        // Complete command line(s) or an RX restart
+    EVT_CAN_TX_SERVICE, // Periodic: expire stale CAN TX frames
+    EVT_KEYS,           // Periodic: key debounce, hold and release deadlines
+    EVT_OUTPUTS,        // Periodic: refresh the output pins
+    EVT_CAN_HEALTH,     // Periodic or on bus-off: bus state, recovery
+    EVT_STATUS,         // Periodic: send a coalesced state delta whose window has passed
+    EVT_UART_FLUSH,     // Send the binary frame batched during this pass
+    EVT_CONFIG_WRITE,   // Program the next step of a config record
+    EVT_COUNT
+} SchedEvent;
+
+#define SCHED_WHEEL_SLOTS 16 // Power of two; timers hash by due tick
+#define SCHED_MAX_TIMERS  8
+
+typedef void (*SchedHandler)(void);
+
+void Sched_Init(void);
+void Sched_SetHandler(SchedEvent event, SchedHandler handler);
+bool Sched_StartTimer(SchedEvent event, uint32_t period_ms); // Periodic, posts event
+void Sched_Post(SchedEvent event);  // Any context
+void Sched_Tick(void);              // From SysTick_Handler, once per ms
+void Sched_RunOnce(void);           // Sleep until events, then dispatch them
+uint32_t Sched_Micros(void);        // Any context; wraps after ~71 minutes
+
+#endif // SCHEDULER_H
@@ -0,0 +1,71 @@
+#ifndef SIGNAL_DB_H
+#define SIGNAL_DB_H
+
+#include "main.h"
+#include "config.h"
+
+// --- Signal Database ---
+// One line per decoded signal. Everything else (acceptance filter list,
+// FMI-to-signal lookup, change-detection state) is generated from this table,
+// so adding a signal is a single line here.
+//
+//   id     CAN ID expression, evaluated whenever the filters are rebuilt, so
+//          configurable sources follow !CFG:SET
+//   byte   first (most significant) byte of the field, big-endian as in PSA frames
+//   bit    position of the field's LSB, counted from bit 0 of the last byte
+//   len    field width in bits (1..16)
+//   kind   SIGNAL_BOOL: on while min <= raw <= max, reported as on/off strings
+//          SIGNAL_VALUE: raw * scale, reported when it moves by >= hyst
+//          SIGNAL_KEY: steering wheel key bitmask, fed to keys.c on every frame
+//
+//  name   id                          byte bit len kind          scale min max hyst response    on      off
+#define SIGNAL_TABLE(X) \
+    X(KEY,   STEERING_WHEEL_CONTROLS_ID, 0,   0,  8,  SIGNAL_KEY,   1,    0,  0,  0,   RESP_KEY,   NULL,   NULL)    \
+    X(IGN,   config_ign_src,             0,   0,  3,  SIGNAL_BOOL,  1,    1,  3,  0,   RESP_IGN,   "ON",   "OFF")   \
+    X(ILLUM, config_illum_src,           0,   4,  1,  SIGNAL_BOOL,  1,    1,  1,  0,   RESP_ILLUM, "ON",   "OFF")   \
+    X(PARK,  config_park_src,            0,   7,  1,  SIGNAL_BOOL,  1,    1,  1,  0,   RESP_PARK,  "ON",   "OFF")   \
+    X(REV,   config_rev_src,             0,   2,  1,  SIGNAL_BOOL,  1,    1,  1,  0,   RESP_REV,   "ON",   "OFF")   \
+    X(DOOR,  config_door_src,            0,   7,  1,  SIGNAL_BOOL,  1,    1,  1,  0,   RESP_DOOR,  "OPEN", "CLOSE")
+
+typedef enum {
+    SIGNAL_BOOL,
+    SIGNAL_VALUE,
+    SIGNAL_KEY,
+} SignalKind;
+
+typedef enum {
+#define SIGNAL_ENUM(name, id, byte, bit, len, kind, scale, min, max, hyst, resp, on, off) SIG_##name,
+    SIGNAL_TABLE(SIGNAL_ENUM)
+#undef SIGNAL_ENUM
+    SIG_COUNT
+} SignalId;
+
+#if SIG_COUNT > 64
+#error "Signal masks are 64 bits wide"
+#endif
+
+typedef uint64_t SignalMask; // Bit n = signal n
+
+// Change-detection state for all signals, in one place
+typedef struct {
+    SignalMask bits;           // SIGNAL_BOOL signals: bit n set = signal n on
+    int32_t value[SIG_COUNT];  // Last reported value per signal
+} SignalState;
+
+#define SIG_BIT(name) ((SignalMask)1 << SIG_##name)
+
+// Signals needed on every frame rather than on change (the key state
+// machine times releases from frame arrival). Frames carrying one are
+// always decoded, never skipped as repeats.
+#define SIGNAL_EVERY_FRAME(name, id, byte, bit, len, kind, scale, min, max, hyst, resp, on, off) \
+    | ((kind) == SIGNAL_KEY ? SIG_BIT(name) : 0)
+#define SIGNAL_EVERY_FRAME_MASK (0 SIGNAL_TABLE(SIGNAL_EVERY_FRAME))
+
+uint32_t SignalDb_GetId(SignalId sig);   // Current CAN ID of a signal
+void SignalDb_Decode(SignalMask signals, const uint8_t *data, uint8_t data_len);
+uint64_t SignalDb_FieldMask(SignalMask signals); // Payload bits read (byte n = bits 8n..8n+7)
+SignalMask SignalDb_GetState(void);      // SignalState.bits (vehicle state word)
+int32_t SignalDb_GetValue(SignalId sig); // Last reported value (0/1 for SIGNAL_BOOL)
+SignalMask SignalDb_Peek(SignalMask signals, const uint8_t *data, uint8_t data_len); // On booleans, no state change
+
+#endif // SIGNAL_DB_H
@@ -2,6 +2,7 @@
 #define SIGNALS_H
 
 #include "main.h"
+#include "signal_db.h" // For SignalMask
 
 // --- GPIO Pins for Status Signals (only for real hardware) ---
 //Moved from main.h
@@ -14,9 +15,47 @@
 #define PARK_PORT       GPIOB
 #define REAR_PIN        GPIO_PIN_4
 #define REAR_PORT       GPIOB
+
+// All outputs share one port so a single BSRR write moves them together
+#define OUTPUT_PORT     GPIOB
+
+// --- Output Table ---
+// Each output follows one bit of the vehicle state word (SignalDb_GetState).
+//   on_delay/off_delay  the signal must stay in its new state this long (ms)
+//                       before the pin follows, e.g. IGN rides out cranking
+//   min_on/min_off      shortest time the pin stays on/off once switched (ms)
+//
+//  name   pin        signal     on_delay off_delay min_on min_off
+#define OUTPUT_TABLE(X) \
+    X(IGN,   IGN_PIN,   SIG_IGN,   0,       2000,     0,     500)  \
+    X(ILLUM, ILLUM_PIN, SIG_ILLUM, 0,       0,        100,   100)  \
+    X(PARK,  PARK_PIN,  SIG_PARK,  0,       0,        100,   100)  \
+    X(REAR,  REAR_PIN,  SIG_REV,   0,       500,      200,   0)
+
+// --- Fast Boot ---
+// Every output change is mirrored into the backup registers (DR2 = pins,
+// DR1 = OUTPUT_BKP_MAGIC ^ pins, written in that order so a reset between
+// the two leaves them invalid). They survive a reset while VDD or VBAT
+// holds, so after a brown-out during cranking GPIO_Status_Restore() drives
+// the same pins again before the clocks are even set up. Restored pins stay
+// on for OUTPUT_BOOT_HOLD_MS, long enough for the decoder to see the bus
+// state again, and then follow it with their normal delays.
+#define OUTPUT_BKP_MAGIC     0xC4B0U
+#define OUTPUT_BOOT_HOLD_MS  1000
+
+// --- Fast Path ---
+// Outputs whose signal is in CAN_FILTER_FAST_SIGNALS (REAR) are switched on
+// from the CAN FIFO1 interrupt, ahead of the main-loop decoder, when their
+// on_delay is 0. Until the decoder reports the signal on, the pin is held
+// for up to OUTPUT_FAST_CONFIRM_MS (a frame lost on the way to the decoder).
+#define OUTPUT_FAST_CONFIRM_MS  100
 #endif
 
 void GPIO_Status_Init(void);
+uint16_t GPIO_Status_Restore(void); // Restores and inits the outputs; returns the pins set
 void CheckStatusSignals(void);
+#ifndef USE_QEMU
+uint16_t GPIO_Status_FastPath(SignalMask signals, SignalMask on); // From the FIFO1 interrupt; returns the pins set
+#endif
 
 #endif // SIGNALS_H
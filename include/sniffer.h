@@ -0,0 +1,53 @@
+#ifndef SNIFFER_H
+#define SNIFFER_H
+
+#include "main.h"
+#include "can_rx.h"
+#include "uart.h"
+
+// --- Bus Sniffer ---
+// !SNF:1 opens the acceptance filters (bank 13) and streams every received
+// frame to the head unit, !SNF:0 closes them again. Signal decoding goes on
+// as usual in between.
+//
+//   ASCII   "!SNF:<time us>,<id>,<dlc>,<data>", all hex except the DLC;
+//           the time wraps after ~71 minutes, extended IDs have 8 digits
+//   binary  one PROTO_MSG_FRAME message per frame (see proto.h)
+//
+// 125 kbit/s of CAN does not fit into 38400 baud, so:
+//   !SNF:DIV:<n>       forward one frame in n of every ID (default 1)
+//   !SNF:DIV:<id>:<n>  the same for a single ID (hex)
+//   !SNF:CHG:<0|1>     forward a frame only if its DLC or data changed
+// and every forwarded frame spends credits that refill at
+// SNIFFER_BYTES_PER_SEC. Frames are only queued while the UART ring has more
+// than SNIFFER_TX_RESERVE bytes free, so the sniffer backs off whenever the
+// normal KEY, IGN, ... traffic needs the link. Frames refused either way are
+// counted as dropped.
+//
+//   !SNF:CNT           one "!SNF:<counter>,<value>" line per counter, then
+//                      "!SNF:END"
+#define SNIFFER_ID_SLOTS      64   // IDs with their own decimation/change state, power of two
+#define SNIFFER_BYTES_PER_SEC 2400 // Sniffer share of the ~3840 B/s UART
+#define SNIFFER_CREDIT_MAX    256  // Burst allowance, bytes
+#define SNIFFER_TX_RESERVE    (UART_TX_RING_SIZE * 3 / 4) // Ring bytes kept for normal messages
+
+#define SNIFFER_COUNTERS(X)   \
+    X(seen,      "SEEN")      \
+    X(sent,      "SENT")      \
+    X(decimated, "DIV")       \
+    X(unchanged, "SAME")      \
+    X(dropped,   "DROP")      \
+    X(untracked, "UNTR") // IDs beyond SNIFFER_ID_SLOTS: no decimation or change state
+
+typedef struct {
+#define SNIFFER_COUNTER_FIELD(name, tag) uint32_t name;
+    SNIFFER_COUNTERS(SNIFFER_COUNTER_FIELD)
+#undef SNIFFER_COUNTER_FIELD
+} SnifferStats;
+
+bool Sniffer_IsActive(void);
+void Sniffer_Forward(const CanRxFrame *frame); // Main loop, from CAN_ProcessPending()
+void Sniffer_Command(const char *value);       // Handles the value of !SNF
+void Sniffer_GetStats(SnifferStats *stats);
+
+#endif // SNIFFER_H
@@ -0,0 +1,35 @@
+#ifndef STATUS_H
+#define STATUS_H
+
+#include "main.h"
+
+// --- Vehicle State Reports ---
+// By default every change of a SIGNAL_BOOL or SIGNAL_VALUE signal is sent
+// on its own line (!IGN:ON, !REV:OFF, ...), as older head units expect.
+// !STS adds a snapshot and, on request, coalesced deltas:
+//
+//   !STS / !STS:GET   the whole vehicle state in one line, e.g.
+//                     "!STS:IGN=ON,ILL=OFF,PARK=OFF,REV=OFF,DOOR=CLOSE", so a
+//                     head unit that reconnects or reboots need not wait for
+//                     the next transition
+//   !STS:CHG:1        deltas instead of per-signal lines. The first change
+//                     opens a window of config_sts_win_ms; every signal that
+//                     changed within it is sent in one "!STS:<tag>=<value>,..."
+//                     line, with its value at the end of the window.
+//                     Answers "!OK:STS".
+//   !STS:CHG:0        back to per-signal lines (the default after a reset);
+//                     a delta still pending is sent first
+//
+// A delta has the form of the snapshot with fewer fields, so one parser
+// handles both. At ignition-on the half dozen lines of a burst become one.
+// A window of 0 only merges the changes of one scheduler pass. In binary
+// mode (proto.h) both go out as a PROTO_MSG_STATE message. Keys are events,
+// not state: they keep their own !KEY lines.
+#define STATUS_SERVICE_MS        10 // EVT_STATUS timer period, the window's resolution
+#define STATUS_WINDOW_MS_DEFAULT 20
+
+void Status_Command(const char *value); // Handles the value of !STS
+bool Status_Coalesce(uint8_t sig);      // Decoder: true if the change is left to the next delta
+void Status_Service(void);              // EVT_STATUS: send the delta once its window has passed
+
+#endif // STATUS_H
@@ -8,10 +8,44 @@
 extern UART_HandleTypeDef huart1; // Declare huart1 as external
 #endif
 
+// --- UART TX Queue ---
+// SendToAndroid() never waits for the wire: lines are queued here and sent
+// by DMA. When the queue is full the new message is dropped (drop-newest).
+#define UART_TX_RING_SIZE 512 // Must be a power of two
+#define UART_TX_LINE_SIZE 64  // Longest line SendToAndroid() sends, '\n' and NUL included
+
+typedef struct {
+    uint32_t bytes_queued;
+    uint32_t bytes_sent;
+    uint32_t dropped_msgs;  // Messages rejected because the queue was full
+    uint32_t dropped_bytes;
+    uint32_t high_water;    // Highest queue fill level in bytes
+} UartTxStats;
+
+// --- UART RX ---
+// USART1 RX runs on a circular DMA buffer. Interrupts only publish line
+// boundaries; lines are parsed and executed by ReceiveFromAndroid().
+#define UART_RX_DMA_SIZE  256 // Must be a power of two
+#define UART_RX_LINE_SIZE 128 // Longest accepted command line
+
+typedef struct {
+    uint32_t lines;      // Lines (or binary frames) dispatched
+    uint32_t overflows;  // Lines discarded for exceeding UART_RX_LINE_SIZE, or cut
+                         // by the RX DMA lapping a stalled main loop
+    uint32_t errors;     // UART errors (DMA restarted)
+    uint32_t bad_frames; // Binary frames dropped on a COBS or CRC error
+} UartRxStats;
+
 void UART_Init(void);
 void SendToAndroid(const char *response, const char *value);
 void ReceiveFromAndroid(void);
 #ifndef USE_QEMU
+bool UART_TxWrite(const uint8_t *data, uint16_t len); // Thread or ISR context
+uint32_t UART_TxFree(void); // Bytes that can be queued right now
+void UART_TxGetStats(UartTxStats *stats);
+void UART_RxGetStats(UartRxStats *stats);
 void USART1_IRQHandler(void);
+void DMA1_Channel4_IRQHandler(void);
+void DMA1_Channel5_IRQHandler(void);
 #endif
 #endif // UART_H
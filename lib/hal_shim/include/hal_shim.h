@@ -0,0 +1,57 @@
+#ifndef HAL_SHIM_H
+#define HAL_SHIM_H
+
+// Host control surface of the HAL shim ([env:native] only).
+//
+// By default HAL_Init() starts an "interrupt" thread that ticks SysTick once
+// per host millisecond, exposes USART1 as a pseudo-terminal and bridges CAN1
+// to a SocketCAN interface. Interrupt handlers run on that thread while it
+// holds the shim's IRQ lock, which __disable_irq() also takes, so firmware
+// critical sections behave as they do on the target.
+//
+// Tools that need determinism (replay, benchmarks) call HalShim_SetManual()
+// before HAL_Init(): no thread is started, time only moves through
+// HalShim_AdvanceTime() and interrupts only run from HalShim_ServiceIrqs().
+// UART and CAN transfers still take their wire time, in virtual time.
+//
+// Environment variables:
+//   CANBOX_CAN       SocketCAN interface (default "vcan0", "none" to disable)
+//   CANBOX_FLASH     file backing the 64 KB flash image (default "canbox_flash.bin")
+//   CANBOX_PTY_LINK  optional symlink created to the USART1 pseudo-terminal
+//   HALSHIM_CAN_START_FAILS  number of HAL_CAN_Start() calls that time out
+//                    (error state, as with no transceiver power); default 0
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "stm32f1xx_hal.h"
+
+// --- Time and interrupts ---
+void HalShim_SetManual(bool manual);
+void HalShim_AdvanceTime(uint32_t ms);   // Manual mode: one SysTick per ms
+void HalShim_ServiceIrqs(void);          // Manual mode: run pending handlers
+void HalShim_SetPending(IRQn_Type irqn);
+uint64_t HalShim_NowUs(void);
+
+// --- CAN ---
+typedef void (*HalShim_CanTxHook)(uint32_t id, uint8_t dlc, const uint8_t *data);
+// Offers a frame to the acceptance filters as if it arrived from the bus.
+// Returns false if no filter matched. *overrun reports that a full FIFO
+// overwrote its last message (may be NULL). A dlc of 9-15 is reported as it
+// is, as bxCAN does, with 8 bytes of data.
+bool HalShim_CanInject(uint32_t id, uint8_t dlc, const uint8_t *data, bool *overrun);
+void HalShim_CanSetTxHook(HalShim_CanTxHook hook);
+// Sets the error counters in ESR and raises the status change interrupt for
+// the flags that become set (EWG >= 96, EPV >= 128, bus-off for tec > 255,
+// which also stops reception until HAL_CAN_Start()). lec is the ESR code.
+void HalShim_CanSetErrors(uint16_t tec, uint8_t rec, uint8_t lec);
+
+// --- USART1 ---
+typedef void (*HalShim_UartTxHook)(const uint8_t *data, size_t len);
+void HalShim_UartInject(const uint8_t *data, size_t len);
+void HalShim_UartSetTxHook(HalShim_UartTxHook hook);
+
+// --- GPIO ---
+uint32_t HalShim_GpioOdr(const GPIO_TypeDef *port);
+
+#endif // HAL_SHIM_H
@@ -0,0 +1,588 @@
+#ifndef STM32F1XX_HAL_H
+#define STM32F1XX_HAL_H
+
+// Host-side stand-in for the STM32F1 HAL used by the [env:native] build.
+// Only the subset of types, macros and functions the firmware touches is
+// provided. Peripheral registers are plain structs in host memory, so the
+// firmware can poke them exactly as it does on the target.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define __IO volatile
+#define __weak __attribute__((weak))
+
+typedef enum { HAL_OK = 0x00U, HAL_ERROR = 0x01U, HAL_BUSY = 0x02U, HAL_TIMEOUT = 0x03U } HAL_StatusTypeDef;
+typedef enum { RESET = 0U, SET = !RESET } FlagStatus, ITStatus;
+typedef enum { DISABLE = 0U, ENABLE = !DISABLE } FunctionalState;
+
+#define HAL_MAX_DELAY 0xFFFFFFFFU
+
+// --- Core (CMSIS) ---
+typedef enum {
+    SysTick_IRQn = -1,
+    DMA1_Channel4_IRQn = 14,
+    DMA1_Channel5_IRQn = 15,
+    USB_HP_CAN1_TX_IRQn = 19,
+    USB_LP_CAN1_RX0_IRQn = 20,
+    CAN1_RX1_IRQn = 21,
+    CAN1_SCE_IRQn = 22,
+    TIM3_IRQn = 29,
+    USART1_IRQn = 37,
+} IRQn_Type;
+
+void __disable_irq(void);
+void __enable_irq(void);
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t primask);
+void __WFI(void);
+// Register access helpers (stm32f1xx.h). WRITE_REG goes through the shim so
+// writes to set/reset registers such as GPIOx->BSRR update the ODR image.
+void HalShim_WriteReg(volatile uint32_t *reg, uint32_t val);
+#define WRITE_REG(REG, VAL)   HalShim_WriteReg(&(REG), (VAL))
+#define READ_REG(REG)         ((REG))
+#define SET_BIT(REG, BIT)     ((REG) |= (BIT))
+#define CLEAR_BIT(REG, BIT)   ((REG) &= ~(BIT))
+#define READ_BIT(REG, BIT)    ((REG) & (BIT))
+
+#define __DMB() __sync_synchronize()
+#define __DSB() __sync_synchronize()
+#define __ISB() __sync_synchronize()
+#define __NOP() do { } while (0)
+
+typedef struct {
+    __IO uint32_t CTRL;
+    __IO uint32_t CYCCNT;
+} DWT_Type;
+typedef struct {
+    __IO uint32_t DEMCR;
+} CoreDebug_Type;
+// CYCCNT is synthesised from the host clock each time DWT is dereferenced.
+DWT_Type *HalShim_Dwt(void);
+extern CoreDebug_Type HalShim_CoreDebug;
+#define DWT       (HalShim_Dwt())
+#define CoreDebug (&HalShim_CoreDebug)
+#define DWT_CTRL_CYCCNTENA_Msk          (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk      (1UL << 24)
+
+typedef struct {
+    __IO uint32_t CTRL;
+    __IO uint32_t LOAD;
+    __IO uint32_t VAL;
+    __IO uint32_t CALIB;
+} SysTick_Type;
+typedef struct {
+    __IO uint32_t ICSR;
+} SCB_Type;
+// SysTick reloads every millisecond of shim time; VAL counts down through
+// it and ICSR.PENDSTSET reports a tick that is due but not yet taken.
+SysTick_Type *HalShim_SysTick(void);
+SCB_Type *HalShim_Scb(void);
+#define SysTick   (HalShim_SysTick())
+#define SCB       (HalShim_Scb())
+#define SCB_ICSR_PENDSTSET_Msk          (1UL << 26)
+
+#define NVIC_PRIORITYGROUP_4 0x00000003U
+#define TICK_INT_PRIORITY    0x0FU
+void HAL_NVIC_SetPriorityGrouping(uint32_t PriorityGroup);
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority);
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn);
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn);
+void HAL_NVIC_SystemReset(void);
+
+HAL_StatusTypeDef HAL_Init(void);
+void HAL_IncTick(void);
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t Delay);
+extern uint32_t SystemCoreClock;
+
+// --- RCC ---
+typedef struct {
+    uint32_t PLLState;
+    uint32_t PLLSource;
+    uint32_t PLLMUL;
+} RCC_PLLInitTypeDef;
+typedef struct {
+    uint32_t OscillatorType;
+    uint32_t HSEState;
+    uint32_t HSEPredivValue;
+    uint32_t LSEState;
+    uint32_t HSIState;
+    uint32_t HSICalibrationValue;
+    uint32_t LSIState;
+    RCC_PLLInitTypeDef PLL;
+} RCC_OscInitTypeDef;
+typedef struct {
+    uint32_t ClockType;
+    uint32_t SYSCLKSource;
+    uint32_t AHBCLKDivider;
+    uint32_t APB1CLKDivider;
+    uint32_t APB2CLKDivider;
+} RCC_ClkInitTypeDef;
+typedef struct {
+    __IO uint32_t CR, CFGR, CIR, APB2RSTR, APB1RSTR, AHBENR, APB2ENR, APB1ENR, BDCR, CSR;
+} RCC_TypeDef;
+extern RCC_TypeDef HalShim_Rcc;
+#define RCC (&HalShim_Rcc)
+
+#define RCC_OSCILLATORTYPE_HSE  0x00000001U
+#define RCC_HSE_ON              0x00010000U
+#define RCC_HSE_PREDIV_DIV1     0x00000000U
+#define RCC_HSI_ON              0x00000001U
+#define RCC_PLL_ON              0x00000002U
+#define RCC_PLLSOURCE_HSE       0x00010000U
+#define RCC_PLL_MUL9            0x001C0000U
+#define RCC_CLOCKTYPE_SYSCLK    0x00000001U
+#define RCC_CLOCKTYPE_HCLK      0x00000002U
+#define RCC_CLOCKTYPE_PCLK1     0x00000004U
+#define RCC_CLOCKTYPE_PCLK2     0x00000008U
+#define RCC_SYSCLKSOURCE_PLLCLK 0x00000002U
+#define RCC_SYSCLK_DIV1         0x00000000U
+#define RCC_HCLK_DIV1           0x00000000U
+#define RCC_HCLK_DIV2           0x00000400U
+#define FLASH_LATENCY_2         0x00000002U
+
+HAL_StatusTypeDef HAL_RCC_OscConfig(RCC_OscInitTypeDef *RCC_OscInitStruct);
+HAL_StatusTypeDef HAL_RCC_ClockConfig(RCC_ClkInitTypeDef *RCC_ClkInitStruct, uint32_t FLatency);
+
+#define RCC_APB2ENR_IOPAEN (1UL << 2)
+#define RCC_APB2ENR_IOPBEN (1UL << 3)
+#define RCC_APB2ENR_IOPCEN (1UL << 4)
+
+#define __HAL_RCC_GPIOA_CLK_ENABLE()  (RCC->APB2ENR |= RCC_APB2ENR_IOPAEN)
+#define __HAL_RCC_GPIOB_CLK_ENABLE()  (RCC->APB2ENR |= RCC_APB2ENR_IOPBEN)
+#define __HAL_RCC_GPIOC_CLK_ENABLE()  (RCC->APB2ENR |= RCC_APB2ENR_IOPCEN)
+#define __HAL_RCC_CAN1_CLK_ENABLE()   do { } while (0)
+#define __HAL_RCC_USART1_CLK_ENABLE() do { } while (0)
+#define __HAL_RCC_DMA1_CLK_ENABLE()   do { } while (0)
+#define __HAL_RCC_TIM3_CLK_ENABLE()   do { } while (0)
+#define __HAL_RCC_PWR_CLK_ENABLE()    do { } while (0)
+#define __HAL_RCC_BKP_CLK_ENABLE()    do { } while (0)
+
+// Reset flags in RCC_CSR. The shim starts with POR and PIN set, and
+// HAL_NVIC_SystemReset() restarts it with SFT set.
+#define RCC_FLAG_PINRST    (1UL << 26)
+#define RCC_FLAG_PORRST    (1UL << 27)
+#define RCC_FLAG_SFTRST    (1UL << 28)
+#define RCC_FLAG_IWDGRST   (1UL << 29)
+#define RCC_FLAG_WWDGRST   (1UL << 30)
+#define RCC_FLAG_LPWRRST   (1UL << 31)
+#define __HAL_RCC_GET_FLAG(FLAG)      ((RCC->CSR & (FLAG)) != 0U)
+#define __HAL_RCC_CLEAR_RESET_FLAGS() (RCC->CSR &= ~0xFC000000U) // RMVF on the target
+
+// --- PWR / BKP ---
+// The backup registers keep their contents across HAL_NVIC_SystemReset()
+// (passed to the restarted process), not across a fresh start. Write
+// protection (DBP) is not enforced.
+typedef struct {
+    __IO uint32_t CR, CSR;
+} PWR_TypeDef;
+typedef struct {
+    uint32_t RESERVED0;
+    __IO uint32_t DR1, DR2, DR3, DR4, DR5, DR6, DR7, DR8, DR9, DR10;
+    __IO uint32_t RTCCR, CR, CSR;
+} BKP_TypeDef;
+extern PWR_TypeDef HalShim_Pwr;
+extern BKP_TypeDef HalShim_Bkp;
+#define PWR (&HalShim_Pwr)
+#define BKP (&HalShim_Bkp)
+#define PWR_CR_DBP (1UL << 8)
+void HAL_PWR_EnableBkUpAccess(void);
+void HAL_PWR_DisableBkUpAccess(void);
+
+// --- GPIO ---
+typedef struct {
+    __IO uint32_t CRL, CRH, IDR, ODR, BSRR, BRR, LCKR;
+} GPIO_TypeDef;
+typedef struct {
+    uint32_t Pin;
+    uint32_t Mode;
+    uint32_t Pull;
+    uint32_t Speed;
+} GPIO_InitTypeDef;
+typedef enum { GPIO_PIN_RESET = 0U, GPIO_PIN_SET } GPIO_PinState;
+
+extern GPIO_TypeDef HalShim_GpioA, HalShim_GpioB, HalShim_GpioC;
+#define GPIOA (&HalShim_GpioA)
+#define GPIOB (&HalShim_GpioB)
+#define GPIOC (&HalShim_GpioC)
+
+#define GPIO_PIN_0  ((uint16_t)0x0001)
+#define GPIO_PIN_1  ((uint16_t)0x0002)
+#define GPIO_PIN_2  ((uint16_t)0x0004)
+#define GPIO_PIN_3  ((uint16_t)0x0008)
+#define GPIO_PIN_4  ((uint16_t)0x0010)
+#define GPIO_PIN_5  ((uint16_t)0x0020)
+#define GPIO_PIN_6  ((uint16_t)0x0040)
+#define GPIO_PIN_7  ((uint16_t)0x0080)
+#define GPIO_PIN_8  ((uint16_t)0x0100)
+#define GPIO_PIN_9  ((uint16_t)0x0200)
+#define GPIO_PIN_10 ((uint16_t)0x0400)
+#define GPIO_PIN_11 ((uint16_t)0x0800)
+#define GPIO_PIN_12 ((uint16_t)0x1000)
+#define GPIO_PIN_13 ((uint16_t)0x2000)
+#define GPIO_PIN_14 ((uint16_t)0x4000)
+#define GPIO_PIN_15 ((uint16_t)0x8000)
+
+#define GPIO_MODE_INPUT        0x00000000U
+#define GPIO_MODE_OUTPUT_PP    0x00000001U
+#define GPIO_MODE_OUTPUT_OD    0x00000011U
+#define GPIO_MODE_AF_PP        0x00000002U
+#define GPIO_NOPULL            0x00000000U
+#define GPIO_PULLUP            0x00000001U
+#define GPIO_SPEED_FREQ_LOW    0x00000002U
+#define GPIO_SPEED_FREQ_MEDIUM 0x00000001U
+#define GPIO_SPEED_FREQ_HIGH   0x00000003U
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init);
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+
+// --- FLASH ---
+#define FLASH_BASE              0x08000000UL
+#define FLASH_PAGE_SIZE         0x400U
+#define FLASH_TYPEERASE_PAGES   0x00U
+#define FLASH_TYPEPROGRAM_HALFWORD   0x01U
+#define FLASH_TYPEPROGRAM_WORD       0x02U
+#define FLASH_TYPEPROGRAM_DOUBLEWORD 0x03U
+typedef struct {
+    uint32_t TypeErase;
+    uint32_t Banks;
+    uint32_t PageAddress;
+    uint32_t NbPages;
+} FLASH_EraseInitTypeDef;
+HAL_StatusTypeDef HAL_FLASH_Unlock(void);
+HAL_StatusTypeDef HAL_FLASH_Lock(void);
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data);
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *PageError);
+
+// --- DMA ---
+typedef struct {
+    __IO uint32_t CCR, CNDTR, CPAR, CMAR;
+} DMA_Channel_TypeDef;
+extern DMA_Channel_TypeDef HalShim_Dma1Channel4, HalShim_Dma1Channel5;
+#define DMA1_Channel4 (&HalShim_Dma1Channel4)
+#define DMA1_Channel5 (&HalShim_Dma1Channel5)
+typedef struct {
+    uint32_t Direction;
+    uint32_t PeriphInc;
+    uint32_t MemInc;
+    uint32_t PeriphDataAlignment;
+    uint32_t MemDataAlignment;
+    uint32_t Mode;
+    uint32_t Priority;
+} DMA_InitTypeDef;
+typedef struct __DMA_HandleTypeDef {
+    DMA_Channel_TypeDef *Instance;
+    DMA_InitTypeDef Init;
+    void *Parent;
+} DMA_HandleTypeDef;
+#define DMA_PERIPH_TO_MEMORY    0x00000000U
+#define DMA_MEMORY_TO_PERIPH    0x00000010U
+#define DMA_PINC_DISABLE        0x00000000U
+#define DMA_MINC_ENABLE         0x00000080U
+#define DMA_PDATAALIGN_BYTE     0x00000000U
+#define DMA_MDATAALIGN_BYTE     0x00000000U
+#define DMA_NORMAL              0x00000000U
+#define DMA_CIRCULAR            0x00000020U
+#define DMA_PRIORITY_LOW        0x00000000U
+#define DMA_PRIORITY_MEDIUM     0x00001000U
+#define DMA_PRIORITY_HIGH       0x00002000U
+#define __HAL_DMA_GET_COUNTER(h) ((h)->Instance->CNDTR)
+#define __HAL_LINKDMA(h, field, dma) do { (h)->field = &(dma); (dma).Parent = (h); } while (0)
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *hdma);
+void HAL_DMA_IRQHandler(DMA_HandleTypeDef *hdma);
+
+// --- UART ---
+typedef struct {
+    __IO uint32_t SR, DR, BRR, CR1, CR2, CR3, GTPR;
+} USART_TypeDef;
+extern USART_TypeDef HalShim_Usart1;
+#define USART1 (&HalShim_Usart1)
+typedef struct {
+    uint32_t BaudRate;
+    uint32_t WordLength;
+    uint32_t StopBits;
+    uint32_t Parity;
+    uint32_t Mode;
+    uint32_t HwFlowCtl;
+    uint32_t OverSampling;
+} UART_InitTypeDef;
+typedef struct __UART_HandleTypeDef {
+    USART_TypeDef *Instance;
+    UART_InitTypeDef Init;
+    uint8_t *pTxBuffPtr;
+    uint16_t TxXferSize;
+    __IO uint16_t TxXferCount;
+    uint8_t *pRxBuffPtr;
+    uint16_t RxXferSize;
+    __IO uint16_t RxXferCount;
+    DMA_HandleTypeDef *hdmatx;
+    DMA_HandleTypeDef *hdmarx;
+    __IO uint32_t gState;
+    __IO uint32_t RxState;
+    __IO uint32_t ErrorCode;
+} UART_HandleTypeDef;
+#define UART_WORDLENGTH_8B     0x00000000U
+#define UART_STOPBITS_1        0x00000000U
+#define UART_PARITY_NONE       0x00000000U
+#define UART_MODE_TX_RX        0x0000000CU
+#define UART_HWCONTROL_NONE    0x00000000U
+#define UART_OVERSAMPLING_16   0x00000000U
+#define UART_FLAG_TXE          (1UL << 7)
+#define UART_FLAG_TC           (1UL << 6)
+#define UART_FLAG_RXNE         (1UL << 5)
+#define UART_FLAG_IDLE         (1UL << 4)
+#define UART_FLAG_ORE          (1UL << 3)
+#define UART_IT_TXE            (1UL << 7)
+#define UART_IT_TC             (1UL << 6)
+#define UART_IT_RXNE           (1UL << 5)
+#define UART_IT_IDLE           (1UL << 4)
+#define __HAL_UART_GET_FLAG(h, f)    (((h)->Instance->SR & (f)) == (f))
+#define __HAL_UART_CLEAR_FLAG(h, f)  ((h)->Instance->SR = ~(f) & (h)->Instance->SR)
+#define __HAL_UART_CLEAR_IDLEFLAG(h) ((h)->Instance->SR &= ~UART_FLAG_IDLE)
+#define __HAL_UART_ENABLE_IT(h, it)  ((h)->Instance->CR1 |= (it))
+#define __HAL_UART_DISABLE_IT(h, it) ((h)->Instance->CR1 &= ~(it))
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart);
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_UART_Receive_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_UART_DMAStop(UART_HandleTypeDef *huart);
+HAL_StatusTypeDef HAL_UART_AbortReceive(UART_HandleTypeDef *huart);
+void HAL_UART_IRQHandler(UART_HandleTypeDef *huart);
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart);
+void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef *huart);
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart);
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart);
+
+// --- TIM ---
+// Update events only: the counter runs from the shim clock at the APB1
+// timer clock (SystemCoreClock, APB1 /2 doubled back).
+typedef struct {
+    __IO uint32_t CR1, CR2, SMCR, DIER, SR, EGR, CCMR1, CCMR2, CCER, CNT, PSC, ARR;
+} TIM_TypeDef;
+extern TIM_TypeDef HalShim_Tim3;
+#define TIM3 (&HalShim_Tim3)
+
+#define TIM_CR1_CEN   (1UL << 0)
+#define TIM_DIER_UIE  (1UL << 0)
+#define TIM_SR_UIF    (1UL << 0)
+
+#define TIM_COUNTERMODE_UP             0x00000000U
+#define TIM_CLOCKDIVISION_DIV1         0x00000000U
+#define TIM_AUTORELOAD_PRELOAD_DISABLE 0x00000000U
+
+typedef struct {
+    uint32_t Prescaler;
+    uint32_t CounterMode;
+    uint32_t Period;
+    uint32_t ClockDivision;
+    uint32_t RepetitionCounter;
+    uint32_t AutoReloadPreload;
+} TIM_Base_InitTypeDef;
+
+typedef enum {
+    HAL_TIM_STATE_RESET = 0x00U,
+    HAL_TIM_STATE_READY = 0x01U,
+    HAL_TIM_STATE_BUSY = 0x02U,
+} HAL_TIM_StateTypeDef;
+
+typedef struct {
+    TIM_TypeDef *Instance;
+    TIM_Base_InitTypeDef Init;
+    __IO HAL_TIM_StateTypeDef State;
+} TIM_HandleTypeDef;
+
+HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef *htim);
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef *htim);
+HAL_StatusTypeDef HAL_TIM_Base_Stop_IT(TIM_HandleTypeDef *htim);
+void HAL_TIM_IRQHandler(TIM_HandleTypeDef *htim);
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim);
+
+// --- CAN ---
+typedef struct {
+    __IO uint32_t TIR, TDTR, TDLR, TDHR;
+} CAN_TxMailBox_TypeDef;
+typedef struct {
+    __IO uint32_t RIR, RDTR, RDLR, RDHR;
+} CAN_FIFOMailBox_TypeDef;
+typedef struct {
+    __IO uint32_t MCR, MSR, TSR, RF0R, RF1R, IER, ESR, BTR;
+    CAN_TxMailBox_TypeDef sTxMailBox[3];
+    CAN_FIFOMailBox_TypeDef sFIFOMailBox[2];
+    __IO uint32_t FMR, FM1R, FS1R, FFA1R, FA1R;
+} CAN_TypeDef;
+extern CAN_TypeDef HalShim_Can1;
+#define CAN1 (&HalShim_Can1)
+
+#define CAN_ESR_EWGF      (1UL << 0)
+#define CAN_ESR_EPVF      (1UL << 1)
+#define CAN_ESR_BOFF      (1UL << 2)
+#define CAN_ESR_LEC_Pos   4U
+#define CAN_ESR_LEC       (7UL << CAN_ESR_LEC_Pos)
+#define CAN_ESR_TEC_Pos   16U
+#define CAN_ESR_TEC       (0xFFUL << CAN_ESR_TEC_Pos)
+#define CAN_ESR_REC_Pos   24U
+#define CAN_ESR_REC       (0xFFUL << CAN_ESR_REC_Pos)
+#define CAN_RF0R_FMP0     (3UL << 0)
+#define CAN_RF0R_FULL0    (1UL << 3)
+#define CAN_RF0R_FOVR0    (1UL << 4)
+#define CAN_RF1R_FMP1     (3UL << 0)
+#define CAN_RF1R_FULL1    (1UL << 3)
+#define CAN_RF1R_FOVR1    (1UL << 4)
+
+// RX FIFO flags, (fifo << 8) | RFxR bit here. FULL is latched until cleared.
+#define CAN_FLAG_FF0      (0x000U | CAN_RF0R_FULL0)
+#define CAN_FLAG_FOV0     (0x000U | CAN_RF0R_FOVR0)
+#define CAN_FLAG_FF1      (0x100U | CAN_RF1R_FULL1)
+#define CAN_FLAG_FOV1     (0x100U | CAN_RF1R_FOVR1)
+uint32_t HalShim_CanGetFlag(uint32_t flag);
+void HalShim_CanClearFlag(uint32_t flag);
+#define __HAL_CAN_GET_FLAG(h, f)   ((void)(h), HalShim_CanGetFlag(f))
+#define __HAL_CAN_CLEAR_FLAG(h, f) ((void)(h), HalShim_CanClearFlag(f))
+
+typedef struct {
+    uint32_t Prescaler;
+    uint32_t Mode;
+    uint32_t SyncJumpWidth;
+    uint32_t TimeSeg1;
+    uint32_t TimeSeg2;
+    FunctionalState TimeTriggeredMode;
+    FunctionalState AutoBusOff;
+    FunctionalState AutoWakeUp;
+    FunctionalState AutoRetransmission;
+    FunctionalState ReceiveFifoLocked;
+    FunctionalState TransmitFifoPriority;
+} CAN_InitTypeDef;
+typedef struct {
+    uint32_t FilterIdHigh;
+    uint32_t FilterIdLow;
+    uint32_t FilterMaskIdHigh;
+    uint32_t FilterMaskIdLow;
+    uint32_t FilterFIFOAssignment;
+    uint32_t FilterBank;
+    uint32_t FilterMode;
+    uint32_t FilterScale;
+    uint32_t FilterActivation;
+    uint32_t SlaveStartFilterBank;
+} CAN_FilterTypeDef;
+typedef struct {
+    uint32_t StdId;
+    uint32_t ExtId;
+    uint32_t IDE;
+    uint32_t RTR;
+    uint32_t DLC;
+    FunctionalState TransmitGlobalTime;
+} CAN_TxHeaderTypeDef;
+typedef struct {
+    uint32_t StdId;
+    uint32_t ExtId;
+    uint32_t IDE;
+    uint32_t RTR;
+    uint32_t DLC;
+    uint32_t Timestamp;
+    uint32_t FilterMatchIndex;
+} CAN_RxHeaderTypeDef;
+typedef enum {
+    HAL_CAN_STATE_RESET = 0x00U,
+    HAL_CAN_STATE_READY = 0x01U,
+    HAL_CAN_STATE_LISTENING = 0x02U,
+    HAL_CAN_STATE_SLEEP_PENDING = 0x03U,
+    HAL_CAN_STATE_SLEEP_ACTIVE = 0x04U,
+    HAL_CAN_STATE_ERROR = 0x05U
+} HAL_CAN_StateTypeDef;
+typedef struct __CAN_HandleTypeDef {
+    CAN_TypeDef *Instance;
+    CAN_InitTypeDef Init;
+    __IO HAL_CAN_StateTypeDef State;
+    __IO uint32_t ErrorCode;
+} CAN_HandleTypeDef;
+
+#define CAN_MODE_NORMAL         0x00000000U
+#define CAN_MODE_SILENT         0x80000000U
+#define CAN_SJW_1TQ             0x00000000U
+#define CAN_BS1_13TQ            0x000C0000U
+#define CAN_BS2_2TQ             0x00100000U
+#define CAN_ID_STD              0x00000000U
+#define CAN_ID_EXT              0x00000004U
+#define CAN_RTR_DATA            0x00000000U
+#define CAN_RTR_REMOTE          0x00000002U
+#define CAN_RX_FIFO0            0x00000000U
+#define CAN_RX_FIFO1            0x00000001U
+#define CAN_FILTER_FIFO0        0x00000000U
+#define CAN_FILTER_FIFO1        0x00000001U
+#define CAN_FILTERMODE_IDMASK   0x00000000U
+#define CAN_FILTERMODE_IDLIST   0x00000001U
+#define CAN_FILTERSCALE_16BIT   0x00000000U
+#define CAN_FILTERSCALE_32BIT   0x00000001U
+#define CAN_FILTER_DISABLE      0x00000000U
+#define CAN_FILTER_ENABLE       0x00000001U
+#define CAN_TX_MAILBOX0         0x00000001U
+#define CAN_TX_MAILBOX1         0x00000002U
+#define CAN_TX_MAILBOX2         0x00000004U
+
+#define CAN_IT_TX_MAILBOX_EMPTY     (1UL << 0)
+#define CAN_IT_RX_FIFO0_MSG_PENDING (1UL << 1)
+#define CAN_IT_RX_FIFO0_FULL        (1UL << 2)
+#define CAN_IT_RX_FIFO0_OVERRUN     (1UL << 3)
+#define CAN_IT_RX_FIFO1_MSG_PENDING (1UL << 4)
+#define CAN_IT_RX_FIFO1_FULL        (1UL << 5)
+#define CAN_IT_RX_FIFO1_OVERRUN     (1UL << 6)
+#define CAN_IT_WAKEUP               (1UL << 16)
+#define CAN_IT_SLEEP_ACK            (1UL << 17)
+#define CAN_IT_ERROR_WARNING        (1UL << 8)
+#define CAN_IT_ERROR_PASSIVE        (1UL << 9)
+#define CAN_IT_BUSOFF               (1UL << 10)
+#define CAN_IT_LAST_ERROR_CODE      (1UL << 11)
+#define CAN_IT_ERROR                (1UL << 15)
+
+#define HAL_CAN_ERROR_NONE      0x00000000U
+#define HAL_CAN_ERROR_EWG       0x00000001U
+#define HAL_CAN_ERROR_EPV       0x00000002U
+#define HAL_CAN_ERROR_BOF       0x00000004U
+#define HAL_CAN_ERROR_STF       0x00000008U
+#define HAL_CAN_ERROR_FOR       0x00000010U
+#define HAL_CAN_ERROR_ACK       0x00000020U
+#define HAL_CAN_ERROR_BR        0x00000040U
+#define HAL_CAN_ERROR_BD        0x00000080U
+#define HAL_CAN_ERROR_CRC       0x00000100U
+#define HAL_CAN_ERROR_RX_FOV0   0x00000200U
+#define HAL_CAN_ERROR_RX_FOV1   0x00000400U
+#define HAL_CAN_ERROR_TX_ALST0  0x00000800U
+#define HAL_CAN_ERROR_TX_TERR0  0x00001000U
+#define HAL_CAN_ERROR_TX_ALST1  0x00002000U
+#define HAL_CAN_ERROR_TX_TERR1  0x00004000U
+#define HAL_CAN_ERROR_TX_ALST2  0x00008000U
+#define HAL_CAN_ERROR_TX_TERR2  0x00010000U
+#define HAL_CAN_ERROR_TIMEOUT   0x00020000U
+#define HAL_CAN_ERROR_NOT_INITIALIZED 0x00040000U
+
+HAL_StatusTypeDef HAL_CAN_Init(CAN_HandleTypeDef *hcan);
+HAL_StatusTypeDef HAL_CAN_ConfigFilter(CAN_HandleTypeDef *hcan, CAN_FilterTypeDef *sFilterConfig);
+HAL_StatusTypeDef HAL_CAN_Start(CAN_HandleTypeDef *hcan);
+HAL_StatusTypeDef HAL_CAN_Stop(CAN_HandleTypeDef *hcan);
+HAL_StatusTypeDef HAL_CAN_ActivateNotification(CAN_HandleTypeDef *hcan, uint32_t ActiveITs);
+HAL_StatusTypeDef HAL_CAN_DeactivateNotification(CAN_HandleTypeDef *hcan, uint32_t InactiveITs);
+HAL_StatusTypeDef HAL_CAN_AddTxMessage(CAN_HandleTypeDef *hcan, CAN_TxHeaderTypeDef *pHeader, uint8_t aData[], uint32_t *pTxMailbox);
+HAL_StatusTypeDef HAL_CAN_AbortTxRequest(CAN_HandleTypeDef *hcan, uint32_t TxMailboxes);
+uint32_t HAL_CAN_GetTxMailboxesFreeLevel(CAN_HandleTypeDef *hcan);
+uint32_t HAL_CAN_IsTxMessagePending(CAN_HandleTypeDef *hcan, uint32_t TxMailboxes);
+HAL_StatusTypeDef HAL_CAN_GetRxMessage(CAN_HandleTypeDef *hcan, uint32_t RxFifo, CAN_RxHeaderTypeDef *pHeader, uint8_t aData[]);
+uint32_t HAL_CAN_GetRxFifoFillLevel(CAN_HandleTypeDef *hcan, uint32_t RxFifo);
+HAL_StatusTypeDef HAL_CAN_ResetError(CAN_HandleTypeDef *hcan);
+uint32_t HAL_CAN_GetError(CAN_HandleTypeDef *hcan);
+void HAL_CAN_IRQHandler(CAN_HandleTypeDef *hcan);
+void HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef *hcan);
+void HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef *hcan);
+void HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef *hcan);
+void HAL_CAN_TxMailbox0AbortCallback(CAN_HandleTypeDef *hcan);
+void HAL_CAN_TxMailbox1AbortCallback(CAN_HandleTypeDef *hcan);
+void HAL_CAN_TxMailbox2AbortCallback(CAN_HandleTypeDef *hcan);
+void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan);
+void HAL_CAN_RxFifo0FullCallback(CAN_HandleTypeDef *hcan);
+void HAL_CAN_RxFifo1MsgPendingCallback(CAN_HandleTypeDef *hcan);
+void HAL_CAN_RxFifo1FullCallback(CAN_HandleTypeDef *hcan);
+void HAL_CAN_ErrorCallback(CAN_HandleTypeDef *hcan);
+
+#endif // STM32F1XX_HAL_H
@@ -0,0 +1,7 @@
+#ifndef STM32F1XX_HAL_CAN_H
+#define STM32F1XX_HAL_CAN_H
+
+// CAN types and functions live in the shim's stm32f1xx_hal.h
+#include "stm32f1xx_hal.h"
+
+#endif // STM32F1XX_HAL_CAN_H
@@ -0,0 +1,553 @@
+#define _GNU_SOURCE
+#include "hal_shim_internal.h"
+#include <linux/can.h>
+#include <net/if.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// bxCAN model: 14 filter banks with the reference-manual match rules, two
+// three-deep RX FIFOs and three TX mailboxes. Frames leave through a
+// SocketCAN raw socket and/or a host hook; incoming frames come from the
+// socket or HalShim_CanInject(). Bus errors are not simulated on their own:
+// HalShim_CanSetErrors() sets the error counters and raises the status
+// change interrupt as the peripheral would.
+
+CAN_TypeDef HalShim_Can1;
+
+#define SHIM_CAN_BANKS       14U
+#define SHIM_CAN_FIFO_DEPTH  3U
+#define SHIM_CAN_MAILBOXES   3U
+// Rough wire time of a standard 8-byte frame at 125 kbps
+#define SHIM_CAN_FRAME_US    1000U
+
+typedef struct {
+    uint32_t fr1, fr2;
+    bool active;
+    uint32_t mode, scale, fifo;
+} ShimFilterBank;
+
+typedef struct {
+    CAN_RxHeaderTypeDef header;
+    uint8_t data[8];
+} ShimRxMsg;
+
+typedef struct {
+    ShimRxMsg msg[SHIM_CAN_FIFO_DEPTH];
+    uint8_t head, count;
+    bool full_event;
+    bool overrun;
+} ShimRxFifo;
+
+typedef enum { MB_FREE, MB_BUSY, MB_DONE } ShimMailboxState;
+
+typedef struct {
+    ShimMailboxState state;
+    bool aborted;
+    uint64_t due_us;
+    CAN_TxHeaderTypeDef header;
+    uint8_t data[8];
+} ShimMailbox;
+
+static struct {
+    CAN_HandleTypeDef *hcan;
+    ShimFilterBank bank[SHIM_CAN_BANKS];
+    ShimRxFifo fifo[2];
+    ShimMailbox mb[SHIM_CAN_MAILBOXES];
+    uint32_t it;
+    uint32_t error_pending; // HAL_CAN_ERROR_* waiting for the SCE interrupt
+    bool bus_off;
+    uint32_t start_fails; // HALSHIM_CAN_START_FAILS: starts left to time out
+    int sock;
+    HalShim_CanTxHook tx_hook;
+} can = { .sock = -1 };
+
+static void can_open_socket(void) {
+    const char *ifname = getenv("CANBOX_CAN");
+    if (!ifname) {
+        ifname = "vcan0";
+    }
+    if (strcmp(ifname, "none") == 0 || HalShim_IsManual()) {
+        return;
+    }
+    int sock = socket(PF_CAN, SOCK_RAW | SOCK_NONBLOCK, CAN_RAW);
+    struct ifreq ifr = { 0 };
+    strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+    if (sock >= 0 && ioctl(sock, SIOCGIFINDEX, &ifr) == 0) {
+        struct sockaddr_can addr = { .can_family = AF_CAN, .can_ifindex = ifr.ifr_ifindex };
+        if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+            can.sock = sock;
+            fprintf(stderr, "hal_shim: CAN1 on %s\n", ifname);
+            return;
+        }
+    }
+    fprintf(stderr, "hal_shim: CAN1 has no bus (%s unavailable)\n", ifname);
+    if (sock >= 0) {
+        close(sock);
+    }
+}
+
+HAL_StatusTypeDef HAL_CAN_Init(CAN_HandleTypeDef *hcan) {
+    can.hcan = hcan;
+    hcan->State = HAL_CAN_STATE_READY;
+    hcan->ErrorCode = HAL_CAN_ERROR_NONE;
+    if (can.sock < 0) {
+        can_open_socket();
+        const char *fails = getenv("HALSHIM_CAN_START_FAILS");
+        can.start_fails = fails ? (uint32_t)strtoul(fails, NULL, 0) : 0;
+    }
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_ConfigFilter(CAN_HandleTypeDef *hcan, CAN_FilterTypeDef *sFilterConfig) {
+    (void)hcan;
+    if (sFilterConfig->FilterBank >= SHIM_CAN_BANKS) {
+        return HAL_ERROR;
+    }
+    ShimFilterBank *b = &can.bank[sFilterConfig->FilterBank];
+    // Same register packing as the F1 HAL
+    if (sFilterConfig->FilterScale == CAN_FILTERSCALE_16BIT) {
+        b->fr1 = ((sFilterConfig->FilterMaskIdLow & 0xFFFFU) << 16) | (sFilterConfig->FilterIdLow & 0xFFFFU);
+        b->fr2 = ((sFilterConfig->FilterMaskIdHigh & 0xFFFFU) << 16) | (sFilterConfig->FilterIdHigh & 0xFFFFU);
+    } else {
+        b->fr1 = ((sFilterConfig->FilterIdHigh & 0xFFFFU) << 16) | (sFilterConfig->FilterIdLow & 0xFFFFU);
+        b->fr2 = ((sFilterConfig->FilterMaskIdHigh & 0xFFFFU) << 16) | (sFilterConfig->FilterMaskIdLow & 0xFFFFU);
+    }
+    b->mode = sFilterConfig->FilterMode;
+    b->scale = sFilterConfig->FilterScale;
+    b->fifo = sFilterConfig->FilterFIFOAssignment;
+    b->active = sFilterConfig->FilterActivation == CAN_FILTER_ENABLE;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_Start(CAN_HandleTypeDef *hcan) {
+    if (hcan->State != HAL_CAN_STATE_READY) {
+        return HAL_ERROR;
+    }
+    if (can.start_fails != 0) {
+        // The cell never acknowledged leaving initialization (no bus, no
+        // transceiver power): the HAL gives up after its timeout
+        can.start_fails--;
+        hcan->ErrorCode |= HAL_CAN_ERROR_TIMEOUT;
+        hcan->State = HAL_CAN_STATE_ERROR;
+        return HAL_ERROR;
+    }
+    hcan->State = HAL_CAN_STATE_LISTENING;
+    // Leaving initialization mode resets the error state. The real cell
+    // waits for 128 x 11 recessive bits first, far less than a tick.
+    can.bus_off = false;
+    HalShim_Can1.ESR = 0;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_Stop(CAN_HandleTypeDef *hcan) {
+    if (hcan->State != HAL_CAN_STATE_LISTENING) {
+        return HAL_ERROR;
+    }
+    hcan->State = HAL_CAN_STATE_READY;
+    return HAL_OK;
+}
+
+// Like the HAL, only in the READY or LISTENING state
+static bool can_state_ok(CAN_HandleTypeDef *hcan) {
+    if (hcan->State == HAL_CAN_STATE_READY || hcan->State == HAL_CAN_STATE_LISTENING) {
+        return true;
+    }
+    hcan->ErrorCode |= HAL_CAN_ERROR_NOT_INITIALIZED;
+    return false;
+}
+
+HAL_StatusTypeDef HAL_CAN_ActivateNotification(CAN_HandleTypeDef *hcan, uint32_t ActiveITs) {
+    if (!can_state_ok(hcan)) {
+        return HAL_ERROR;
+    }
+    can.it |= ActiveITs;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_DeactivateNotification(CAN_HandleTypeDef *hcan, uint32_t InactiveITs) {
+    if (!can_state_ok(hcan)) {
+        return HAL_ERROR;
+    }
+    can.it &= ~InactiveITs;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_ResetError(CAN_HandleTypeDef *hcan) {
+    hcan->ErrorCode = HAL_CAN_ERROR_NONE;
+    return HAL_OK;
+}
+
+uint32_t HAL_CAN_GetError(CAN_HandleTypeDef *hcan) {
+    return hcan->ErrorCode;
+}
+
+// --- RX ---
+// Returns the filter match index for a standard data/remote frame, or -1.
+// Priority follows RM0008: 32-bit before 16-bit, list before mask, then the
+// lowest bank. FMI numbering counts every bank assigned to the same FIFO,
+// active or not.
+static int can_match(uint32_t id, bool rtr, uint32_t *fifo_out) {
+    uint32_t word32 = (id << 21) | (rtr ? 2U : 0U);
+    uint32_t word16 = (id << 5) | (rtr ? 0x10U : 0U);
+    uint32_t fmi_base[2] = { 0, 0 };
+    int best = -1;
+    int best_rank = -1;
+
+    for (uint32_t n = 0; n < SHIM_CAN_BANKS; n++) {
+        const ShimFilterBank *b = &can.bank[n];
+        bool list = b->mode == CAN_FILTERMODE_IDLIST;
+        bool wide = b->scale == CAN_FILTERSCALE_32BIT;
+        uint32_t slots = wide ? (list ? 2U : 1U) : (list ? 4U : 2U);
+        uint32_t base = fmi_base[b->fifo];
+        fmi_base[b->fifo] += slots;
+        if (!b->active) {
+            continue;
+        }
+
+        int hit = -1;
+        if (wide && list) {
+            hit = word32 == b->fr1 ? 0 : word32 == b->fr2 ? 1 : -1;
+        } else if (wide) {
+            hit = ((word32 ^ b->fr1) & b->fr2) == 0 ? 0 : -1;
+        } else if (list) {
+            uint16_t ids[4] = { (uint16_t)b->fr1, (uint16_t)(b->fr1 >> 16),
+                                (uint16_t)b->fr2, (uint16_t)(b->fr2 >> 16) };
+            for (int i = 0; i < 4 && hit < 0; i++) {
+                hit = ids[i] == word16 ? i : -1;
+            }
+        } else {
+            if ((((word16 ^ b->fr1) & (b->fr1 >> 16)) & 0xFFFFU) == 0) {
+                hit = 0;
+            } else if ((((word16 ^ b->fr2) & (b->fr2 >> 16)) & 0xFFFFU) == 0) {
+                hit = 1;
+            }
+        }
+        int rank = (wide ? 2 : 0) + (list ? 1 : 0);
+        if (hit >= 0 && rank > best_rank) {
+            best = (int)(base + (uint32_t)hit);
+            best_rank = rank;
+            *fifo_out = b->fifo;
+        }
+    }
+    return best;
+}
+
+static void can_sync_rfr(uint32_t fifo) {
+    const ShimRxFifo *f = &can.fifo[fifo];
+    uint32_t rfr = f->count;
+    if (f->full_event) {
+        rfr |= CAN_RF0R_FULL0;
+    }
+    if (f->overrun) {
+        rfr |= CAN_RF0R_FOVR0;
+    }
+    if (fifo == 0) {
+        HalShim_Can1.RF0R = rfr;
+    } else {
+        HalShim_Can1.RF1R = rfr;
+    }
+}
+
+uint32_t HalShim_CanGetFlag(uint32_t flag) {
+    const ShimRxFifo *f = &can.fifo[(flag >> 8) & 1U];
+    if (flag & CAN_RF0R_FULL0) {
+        return f->full_event;
+    }
+    return (flag & CAN_RF0R_FOVR0) ? f->overrun : 0U;
+}
+
+void HalShim_CanClearFlag(uint32_t flag) {
+    uint32_t fifo = (flag >> 8) & 1U;
+    if (flag & CAN_RF0R_FULL0) {
+        can.fifo[fifo].full_event = false;
+    }
+    if (flag & CAN_RF0R_FOVR0) {
+        can.fifo[fifo].overrun = false;
+    }
+    can_sync_rfr(fifo);
+}
+
+bool HalShim_CanInject(uint32_t id, uint8_t dlc, const uint8_t *data, bool *overrun) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (overrun) {
+        *overrun = false;
+    }
+    uint32_t fifo = 0;
+    int fmi = (can.hcan && can.hcan->State == HAL_CAN_STATE_LISTENING && !can.bus_off)
+                  ? can_match(id, false, &fifo) : -1;
+    if (fmi >= 0) {
+        ShimRxFifo *f = &can.fifo[fifo];
+        ShimRxMsg *slot;
+        if (f->count == SHIM_CAN_FIFO_DEPTH) {
+            // Not locked: the newest message overwrites the last one
+            slot = &f->msg[(f->head + SHIM_CAN_FIFO_DEPTH - 1U) % SHIM_CAN_FIFO_DEPTH];
+            f->overrun = true;
+            if (overrun) {
+                *overrun = true;
+            }
+        } else {
+            slot = &f->msg[(f->head + f->count) % SHIM_CAN_FIFO_DEPTH];
+            if (++f->count == SHIM_CAN_FIFO_DEPTH) {
+                f->full_event = true;
+            }
+        }
+        slot->header = (CAN_RxHeaderTypeDef){
+            .StdId = id & 0x7FFU,
+            .IDE = CAN_ID_STD,
+            .RTR = CAN_RTR_DATA,
+            .DLC = dlc & 0x0FU, // As on the bus: DLC 9-15 carry 8 bytes
+            .Timestamp = (uint32_t)(HalShim_NowUs() / 8U) & 0xFFFFU, // 1 bit time at 125 kbps
+            .FilterMatchIndex = (uint32_t)fmi,
+        };
+        memset(slot->data, 0, sizeof(slot->data));
+        memcpy(slot->data, data, dlc > 8U ? 8U : dlc);
+        can_sync_rfr(fifo);
+        HalShim_SetPending(fifo == 0 ? USB_LP_CAN1_RX0_IRQn : CAN1_RX1_IRQn);
+    }
+    __set_PRIMASK(primask);
+    return fmi >= 0;
+}
+
+void HalShim_CanSetTxHook(HalShim_CanTxHook hook) {
+    can.tx_hook = hook;
+}
+
+int HalShim_CanFd(void) {
+    return can.sock;
+}
+
+void HalShim_CanReadable(void) {
+    struct can_frame frame;
+    while (read(can.sock, &frame, sizeof(frame)) == (ssize_t)sizeof(frame)) {
+        if (!(frame.can_id & (CAN_EFF_FLAG | CAN_RTR_FLAG | CAN_ERR_FLAG))) {
+            HalShim_CanInject(frame.can_id, frame.can_dlc, frame.data, NULL);
+        }
+    }
+}
+
+HAL_StatusTypeDef HAL_CAN_GetRxMessage(CAN_HandleTypeDef *hcan, uint32_t RxFifo, CAN_RxHeaderTypeDef *pHeader, uint8_t aData[]) {
+    (void)hcan;
+    ShimRxFifo *f = &can.fifo[RxFifo & 1U];
+    if (f->count == 0) {
+        return HAL_ERROR;
+    }
+    const ShimRxMsg *msg = &f->msg[f->head];
+    *pHeader = msg->header;
+    memcpy(aData, msg->data, 8);
+    f->head = (uint8_t)((f->head + 1U) % SHIM_CAN_FIFO_DEPTH);
+    f->count--;
+    can_sync_rfr(RxFifo & 1U);
+    return HAL_OK;
+}
+
+uint32_t HAL_CAN_GetRxFifoFillLevel(CAN_HandleTypeDef *hcan, uint32_t RxFifo) {
+    (void)hcan;
+    return can.fifo[RxFifo & 1U].count;
+}
+
+// --- TX ---
+HAL_StatusTypeDef HAL_CAN_AddTxMessage(CAN_HandleTypeDef *hcan, CAN_TxHeaderTypeDef *pHeader, uint8_t aData[], uint32_t *pTxMailbox) {
+    if (hcan->State != HAL_CAN_STATE_LISTENING) {
+        return HAL_ERROR;
+    }
+    for (uint32_t i = 0; i < SHIM_CAN_MAILBOXES; i++) {
+        ShimMailbox *mb = &can.mb[i];
+        if (mb->state != MB_FREE) {
+            continue;
+        }
+        mb->state = MB_BUSY;
+        mb->aborted = false;
+        mb->header = *pHeader;
+        memcpy(mb->data, aData, pHeader->DLC > 8U ? 8U : pHeader->DLC);
+        mb->due_us = HalShim_NowUs() + SHIM_CAN_FRAME_US;
+        *pTxMailbox = CAN_TX_MAILBOX0 << i;
+        return HAL_OK;
+    }
+    return HAL_ERROR;
+}
+
+HAL_StatusTypeDef HAL_CAN_AbortTxRequest(CAN_HandleTypeDef *hcan, uint32_t TxMailboxes) {
+    (void)hcan;
+    for (uint32_t i = 0; i < SHIM_CAN_MAILBOXES; i++) {
+        ShimMailbox *mb = &can.mb[i];
+        if ((TxMailboxes & (CAN_TX_MAILBOX0 << i)) && mb->state == MB_BUSY) {
+            mb->state = MB_DONE;
+            mb->aborted = true;
+            HalShim_SetPending(USB_HP_CAN1_TX_IRQn);
+        }
+    }
+    return HAL_OK;
+}
+
+uint32_t HAL_CAN_GetTxMailboxesFreeLevel(CAN_HandleTypeDef *hcan) {
+    (void)hcan;
+    uint32_t level = 0;
+    for (uint32_t i = 0; i < SHIM_CAN_MAILBOXES; i++) {
+        level += can.mb[i].state == MB_FREE;
+    }
+    return level;
+}
+
+uint32_t HAL_CAN_IsTxMessagePending(CAN_HandleTypeDef *hcan, uint32_t TxMailboxes) {
+    (void)hcan;
+    for (uint32_t i = 0; i < SHIM_CAN_MAILBOXES; i++) {
+        if ((TxMailboxes & (CAN_TX_MAILBOX0 << i)) && can.mb[i].state == MB_BUSY) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Puts mailboxes whose wire time has elapsed on the bus. Without a socket
+// or hook nobody would acknowledge on a real bus; the shim still reports
+// success so the firmware can run standalone.
+void HalShim_CanTick(uint64_t now_us) {
+    for (uint32_t i = 0; i < SHIM_CAN_MAILBOXES; i++) {
+        ShimMailbox *mb = &can.mb[i];
+        if (mb->state != MB_BUSY || now_us < mb->due_us) {
+            continue;
+        }
+        uint8_t dlc = (uint8_t)(mb->header.DLC > 8U ? 8U : mb->header.DLC);
+        if (can.sock >= 0) {
+            struct can_frame frame = { .can_id = mb->header.StdId & CAN_SFF_MASK, .can_dlc = dlc };
+            memcpy(frame.data, mb->data, dlc);
+            if (write(can.sock, &frame, sizeof(frame)) < 0) {
+                // Socket queue full: the frame is lost, as on a saturated bus
+            }
+        }
+        if (can.tx_hook) {
+            can.tx_hook(mb->header.StdId, dlc, mb->data);
+        }
+        // TME is set at once; RQCP waits for the interrupt if it is enabled
+        mb->state = (can.it & CAN_IT_TX_MAILBOX_EMPTY) ? MB_DONE : MB_FREE;
+        HalShim_SetPending(USB_HP_CAN1_TX_IRQn);
+    }
+}
+
+// --- IRQ ---
+void __attribute__((weak)) HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef *hcan) { (void)hcan; }
+void __attribute__((weak)) HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef *hcan) { (void)hcan; }
+void __attribute__((weak)) HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef *hcan) { (void)hcan; }
+void __attribute__((weak)) HAL_CAN_TxMailbox0AbortCallback(CAN_HandleTypeDef *hcan) { (void)hcan; }
+void __attribute__((weak)) HAL_CAN_TxMailbox1AbortCallback(CAN_HandleTypeDef *hcan) { (void)hcan; }
+void __attribute__((weak)) HAL_CAN_TxMailbox2AbortCallback(CAN_HandleTypeDef *hcan) { (void)hcan; }
+void __attribute__((weak)) HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan) { (void)hcan; }
+void __attribute__((weak)) HAL_CAN_RxFifo0FullCallback(CAN_HandleTypeDef *hcan) { (void)hcan; }
+void __attribute__((weak)) HAL_CAN_RxFifo1MsgPendingCallback(CAN_HandleTypeDef *hcan) { (void)hcan; }
+void __attribute__((weak)) HAL_CAN_RxFifo1FullCallback(CAN_HandleTypeDef *hcan) { (void)hcan; }
+void __attribute__((weak)) HAL_CAN_ErrorCallback(CAN_HandleTypeDef *hcan) { (void)hcan; }
+
+static void can_service_fifo(CAN_HandleTypeDef *hcan, uint32_t fifo, uint32_t *errorcode) {
+    static void (*const pending_cb[2])(CAN_HandleTypeDef *) = {
+        HAL_CAN_RxFifo0MsgPendingCallback, HAL_CAN_RxFifo1MsgPendingCallback };
+    static void (*const full_cb[2])(CAN_HandleTypeDef *) = {
+        HAL_CAN_RxFifo0FullCallback, HAL_CAN_RxFifo1FullCallback };
+    uint32_t it_shift = fifo * 3U;
+    ShimRxFifo *f = &can.fifo[fifo];
+
+    if ((can.it & (CAN_IT_RX_FIFO0_OVERRUN << it_shift)) && f->overrun) {
+        f->overrun = false;
+        *errorcode |= fifo == 0 ? HAL_CAN_ERROR_RX_FOV0 : HAL_CAN_ERROR_RX_FOV1;
+        can_sync_rfr(fifo);
+    }
+    if ((can.it & (CAN_IT_RX_FIFO0_FULL << it_shift)) && f->full_event) {
+        f->full_event = false;
+        full_cb[fifo](hcan);
+    }
+    if (can.it & (CAN_IT_RX_FIFO0_MSG_PENDING << it_shift)) {
+        // The line stays asserted while FMP is non-zero; stop if the
+        // callback leaves the message in place to avoid spinning.
+        while (f->count) {
+            uint8_t before = f->count;
+            pending_cb[fifo](hcan);
+            if (f->count == before) {
+                break;
+            }
+        }
+    }
+}
+
+void HAL_CAN_IRQHandler(CAN_HandleTypeDef *hcan) {
+    static void (*const complete_cb[SHIM_CAN_MAILBOXES])(CAN_HandleTypeDef *) = {
+        HAL_CAN_TxMailbox0CompleteCallback, HAL_CAN_TxMailbox1CompleteCallback, HAL_CAN_TxMailbox2CompleteCallback };
+    static void (*const abort_cb[SHIM_CAN_MAILBOXES])(CAN_HandleTypeDef *) = {
+        HAL_CAN_TxMailbox0AbortCallback, HAL_CAN_TxMailbox1AbortCallback, HAL_CAN_TxMailbox2AbortCallback };
+    uint32_t errorcode = HAL_CAN_ERROR_NONE;
+
+    if (can.it & CAN_IT_TX_MAILBOX_EMPTY) {
+        for (uint32_t i = 0; i < SHIM_CAN_MAILBOXES; i++) {
+            ShimMailbox *mb = &can.mb[i];
+            if (mb->state != MB_DONE) {
+                continue;
+            }
+            mb->state = MB_FREE;
+            if (mb->aborted) {
+                abort_cb[i](hcan);
+            } else {
+                complete_cb[i](hcan);
+            }
+        }
+    }
+    can_service_fifo(hcan, 0, &errorcode);
+    can_service_fifo(hcan, 1, &errorcode);
+
+    if (can.it & CAN_IT_ERROR) {
+        errorcode |= can.error_pending;
+        can.error_pending = 0;
+        HalShim_Can1.ESR &= ~CAN_ESR_LEC; // The HAL clears LEC once read
+    }
+
+    if (errorcode != HAL_CAN_ERROR_NONE) {
+        hcan->ErrorCode |= errorcode;
+        HAL_CAN_ErrorCallback(hcan);
+    }
+}
+
+void HalShim_CanSetErrors(uint16_t tec, uint8_t rec, uint8_t lec) {
+    static const uint32_t lec_error[8] = {
+        0, HAL_CAN_ERROR_STF, HAL_CAN_ERROR_FOR, HAL_CAN_ERROR_ACK,
+        HAL_CAN_ERROR_BR, HAL_CAN_ERROR_BD, HAL_CAN_ERROR_CRC, 0 };
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint32_t old = HalShim_Can1.ESR;
+    uint32_t esr = ((uint32_t)(tec > 255U ? 255U : tec) << CAN_ESR_TEC_Pos) |
+                   ((uint32_t)rec << CAN_ESR_REC_Pos) | ((uint32_t)(lec & 7U) << CAN_ESR_LEC_Pos);
+    if (tec >= 96U || rec >= 96U) {
+        esr |= CAN_ESR_EWGF;
+    }
+    if (tec >= 128U || rec >= 128U) {
+        esr |= CAN_ESR_EPVF;
+    }
+    if (tec > 255U) {
+        esr |= CAN_ESR_BOFF; // TEC stays at 255 in the register
+        can.bus_off = true;
+    }
+    HalShim_Can1.ESR = esr;
+
+    // Flags raise the interrupt when they become set, LEC on every error
+    uint32_t rising = esr & ~old;
+    uint32_t errors = 0;
+    if ((rising & CAN_ESR_EWGF) && (can.it & CAN_IT_ERROR_WARNING)) {
+        errors |= HAL_CAN_ERROR_EWG;
+    }
+    if ((rising & CAN_ESR_EPVF) && (can.it & CAN_IT_ERROR_PASSIVE)) {
+        errors |= HAL_CAN_ERROR_EPV;
+    }
+    if ((rising & CAN_ESR_BOFF) && (can.it & CAN_IT_BUSOFF)) {
+        errors |= HAL_CAN_ERROR_BOF;
+    }
+    if (can.it & CAN_IT_LAST_ERROR_CODE) {
+        errors |= lec_error[lec & 7U];
+    }
+    if (errors && (can.it & CAN_IT_ERROR)) {
+        can.error_pending |= errors;
+        HalShim_SetPending(CAN1_SCE_IRQn);
+    }
+    __set_PRIMASK(primask);
+}
@@ -0,0 +1,540 @@
+#define _GNU_SOURCE
+#include "hal_shim_internal.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// --- Peripheral register images ---
+RCC_TypeDef HalShim_Rcc;
+PWR_TypeDef HalShim_Pwr;
+BKP_TypeDef HalShim_Bkp;
+GPIO_TypeDef HalShim_GpioA, HalShim_GpioB, HalShim_GpioC;
+CoreDebug_Type HalShim_CoreDebug;
+uint32_t SystemCoreClock = 8000000U; // HSI until SystemClock_Config runs
+
+// --- Interrupt emulation ---
+// One lock stands in for PRIMASK: the interrupt thread holds it while a
+// handler runs and __disable_irq() takes it, so the two never interleave.
+// irq_masked is per thread, which makes nested masking a no-op like on the
+// core and lets handlers call __disable_irq() themselves.
+static pthread_mutex_t irq_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t irq_done = PTHREAD_COND_INITIALIZER; // Wakes __WFI()
+static __thread uint32_t irq_masked;
+
+static bool manual_mode;
+static uint64_t manual_us;
+static struct timespec start_time;
+static volatile uint32_t uwTick;
+
+#define WEAK_HANDLER(name) void __attribute__((weak)) name(void) {}
+WEAK_HANDLER(DMA1_Channel4_IRQHandler)
+WEAK_HANDLER(DMA1_Channel5_IRQHandler)
+WEAK_HANDLER(USB_HP_CAN1_TX_IRQHandler)
+WEAK_HANDLER(USB_LP_CAN1_RX0_IRQHandler)
+WEAK_HANDLER(CAN1_RX1_IRQHandler)
+WEAK_HANDLER(CAN1_SCE_IRQHandler)
+WEAK_HANDLER(TIM3_IRQHandler)
+WEAK_HANDLER(USART1_IRQHandler)
+void __attribute__((weak)) SysTick_Handler(void) { HAL_IncTick(); }
+
+typedef struct {
+    IRQn_Type irqn;
+    void (*handler)(void);
+    uint8_t priority; // (preempt << 4) | sub, lower runs first
+    bool enabled;
+    bool pending;
+} ShimVector;
+
+static ShimVector vectors[] = {
+    { SysTick_IRQn,         SysTick_Handler,            0, false, false },
+    { DMA1_Channel4_IRQn,   DMA1_Channel4_IRQHandler,   0, false, false },
+    { DMA1_Channel5_IRQn,   DMA1_Channel5_IRQHandler,   0, false, false },
+    { USB_HP_CAN1_TX_IRQn,  USB_HP_CAN1_TX_IRQHandler,  0, false, false },
+    { USB_LP_CAN1_RX0_IRQn, USB_LP_CAN1_RX0_IRQHandler, 0, false, false },
+    { CAN1_RX1_IRQn,        CAN1_RX1_IRQHandler,        0, false, false },
+    { CAN1_SCE_IRQn,        CAN1_SCE_IRQHandler,        0, false, false },
+    { TIM3_IRQn,            TIM3_IRQHandler,            0, false, false },
+    { USART1_IRQn,          USART1_IRQHandler,          0, false, false },
+};
+#define VECTOR_COUNT (sizeof(vectors) / sizeof(vectors[0]))
+
+static ShimVector *find_vector(IRQn_Type irqn) {
+    for (size_t i = 0; i < VECTOR_COUNT; i++) {
+        if (vectors[i].irqn == irqn) {
+            return &vectors[i];
+        }
+    }
+    return NULL;
+}
+
+void __disable_irq(void) {
+    if (!irq_masked) {
+        pthread_mutex_lock(&irq_lock);
+        irq_masked = 1;
+    }
+}
+
+void __enable_irq(void) {
+    if (irq_masked) {
+        irq_masked = 0;
+        pthread_mutex_unlock(&irq_lock);
+    }
+}
+
+uint32_t __get_PRIMASK(void) {
+    return irq_masked;
+}
+
+void __set_PRIMASK(uint32_t primask) {
+    if (primask) {
+        __disable_irq();
+    } else {
+        __enable_irq();
+    }
+}
+
+void __WFI(void) {
+    if (manual_mode) {
+        return; // Nothing can arrive until the caller advances time
+    }
+    // Like the core, a masked WFI still wakes on a pending interrupt. The
+    // handler runs while we sleep rather than after __enable_irq(), which
+    // the firmware cannot tell apart.
+    uint32_t masked = irq_masked;
+    if (!masked) {
+        pthread_mutex_lock(&irq_lock);
+    }
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += 2000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(&irq_done, &irq_lock, &deadline);
+    if (!masked) {
+        pthread_mutex_unlock(&irq_lock);
+    }
+}
+
+void HalShim_SetPending(IRQn_Type irqn) {
+    ShimVector *v = find_vector(irqn);
+    if (v) {
+        v->pending = true;
+    }
+}
+
+// Runs pending, enabled handlers in NVIC priority order until none are left.
+// Handlers run to completion; preemption between priorities is not modelled.
+void HalShim_ServiceIrqs(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint64_t now = HalShim_NowUs();
+    HalShim_CanTick(now);
+    HalShim_UartTick(now);
+    HalShim_TimTick(now);
+    for (;;) {
+        ShimVector *next = NULL;
+        for (size_t i = 0; i < VECTOR_COUNT; i++) {
+            ShimVector *v = &vectors[i];
+            if (v->pending && v->enabled && (!next || v->priority < next->priority)) {
+                next = v;
+            }
+        }
+        if (!next) {
+            break;
+        }
+        next->pending = false;
+        next->handler();
+    }
+    __set_PRIMASK(primask);
+}
+
+// --- Time ---
+bool HalShim_IsManual(void) {
+    return manual_mode;
+}
+
+void HalShim_SetManual(bool manual) {
+    manual_mode = manual;
+}
+
+uint64_t HalShim_NowUs(void) {
+    if (manual_mode) {
+        return manual_us;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)(now.tv_sec - start_time.tv_sec) * 1000000U +
+           (uint64_t)((now.tv_nsec - start_time.tv_nsec) / 1000);
+}
+
+void HalShim_AdvanceTime(uint32_t ms) {
+    while (ms--) {
+        manual_us += 1000U;
+        HalShim_SetPending(SysTick_IRQn);
+        HalShim_ServiceIrqs();
+    }
+}
+
+void HAL_IncTick(void) {
+    uwTick++;
+}
+
+uint32_t HAL_GetTick(void) {
+    return uwTick;
+}
+
+void HAL_Delay(uint32_t Delay) {
+    if (manual_mode) {
+        HalShim_AdvanceTime(Delay);
+        return;
+    }
+    if (irq_masked) {
+        usleep(Delay * 1000U); // SysTick cannot run, sleep instead of hanging
+        return;
+    }
+    uint32_t start = HAL_GetTick();
+    while (HAL_GetTick() - start < Delay) {
+        usleep(500);
+    }
+}
+
+static void *irq_thread(void *arg) {
+    (void)arg;
+    uint64_t next_tick = 1000U;
+    struct pollfd fds[2];
+
+    for (;;) {
+        __disable_irq();
+        fds[0] = (struct pollfd){ .fd = HalShim_CanFd(), .events = POLLIN };
+        fds[1] = (struct pollfd){ .fd = HalShim_UartFd(), .events = POLLIN };
+        __enable_irq();
+
+        uint64_t now = HalShim_NowUs();
+        uint64_t wait_us = next_tick > now ? next_tick - now : 0;
+        struct timespec timeout = { 0, (long)wait_us * 1000L };
+        if (ppoll(fds, 2, &timeout, NULL) < 0 && errno != EINTR) {
+            perror("hal_shim: ppoll");
+            abort();
+        }
+
+        __disable_irq();
+        if (fds[0].revents & POLLIN) {
+            HalShim_CanReadable();
+        }
+        if (fds[1].revents & POLLIN) {
+            HalShim_UartReadable();
+        }
+        now = HalShim_NowUs();
+        while (next_tick <= now) {
+            next_tick += 1000U;
+            HalShim_SetPending(SysTick_IRQn);
+            HalShim_ServiceIrqs();
+        }
+        HalShim_ServiceIrqs();
+        pthread_cond_broadcast(&irq_done);
+        __enable_irq();
+    }
+    return NULL;
+}
+
+// --- Flash ---
+// The whole 64 KB part is a file mapped at its real address, so the
+// firmware's (ConfigData *)0x0800F000 style pointers work unchanged and
+// writes survive restarts.
+#define SHIM_FLASH_SIZE (64U * 1024U)
+static bool flash_locked = true;
+
+static void flash_init(void) {
+    const char *path = getenv("CANBOX_FLASH");
+    if (!path) {
+        path = "canbox_flash.bin";
+    }
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        perror("hal_shim: flash image");
+        exit(1);
+    }
+    if ((uint64_t)st.st_size < SHIM_FLASH_SIZE) {
+        // New (or short) image: pad with the erased value
+        uint8_t erased[FLASH_PAGE_SIZE];
+        memset(erased, 0xFF, sizeof(erased));
+        for (off_t pos = st.st_size; pos < (off_t)SHIM_FLASH_SIZE; pos += (off_t)sizeof(erased)) {
+            size_t chunk = SHIM_FLASH_SIZE - (size_t)pos;
+            if (chunk > sizeof(erased)) {
+                chunk = sizeof(erased);
+            }
+            if (pwrite(fd, erased, chunk, pos) != (ssize_t)chunk) {
+                perror("hal_shim: flash image");
+                exit(1);
+            }
+        }
+    }
+    void *map = mmap((void *)FLASH_BASE, SHIM_FLASH_SIZE, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_FIXED_NOREPLACE, fd, 0);
+    if (map != (void *)FLASH_BASE) {
+        perror("hal_shim: cannot map flash at 0x08000000");
+        exit(1);
+    }
+    close(fd);
+}
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void) {
+    flash_locked = false;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Lock(void) {
+    flash_locked = true;
+    return HAL_OK;
+}
+
+static bool flash_in_range(uint32_t address, uint32_t len) {
+    return address >= FLASH_BASE && address + len <= FLASH_BASE + SHIM_FLASH_SIZE;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data) {
+    uint32_t halfwords = TypeProgram == FLASH_TYPEPROGRAM_HALFWORD ? 1U :
+                         TypeProgram == FLASH_TYPEPROGRAM_WORD ? 2U : 4U;
+    if (flash_locked || (Address & 1U) || !flash_in_range(Address, halfwords * 2U)) {
+        return HAL_ERROR;
+    }
+    // Programmed one half-word at a time like the F1 HAL. A half-word that
+    // is not erased can only be overwritten with zero (PGERR otherwise).
+    volatile uint16_t *dst = (volatile uint16_t *)(uintptr_t)Address;
+    for (uint32_t i = 0; i < halfwords; i++) {
+        uint16_t value = (uint16_t)(Data >> (16U * i));
+        if (dst[i] != 0xFFFFU && value != 0U) {
+            return HAL_ERROR;
+        }
+        dst[i] = value;
+    }
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *PageError) {
+    *PageError = 0xFFFFFFFFU;
+    uint32_t len = pEraseInit->NbPages * FLASH_PAGE_SIZE;
+    if (flash_locked || (pEraseInit->PageAddress % FLASH_PAGE_SIZE) ||
+        !flash_in_range(pEraseInit->PageAddress, len)) {
+        *PageError = pEraseInit->PageAddress;
+        return HAL_ERROR;
+    }
+    memset((void *)(uintptr_t)pEraseInit->PageAddress, 0xFF, len);
+    return HAL_OK;
+}
+
+// --- Core ---
+static char **saved_argv;
+
+// The reset flags and backup registers a reset carries over, as
+// "<csr>,<dr1>,...,<dr10>" in hex
+#define BACKUP_ENV "HALSHIM_BACKUP"
+
+static void __attribute__((constructor)) save_args(int argc, char **argv) {
+    (void)argc;
+    saved_argv = argv;
+
+    // Runs before main(), like the reset itself
+    HalShim_Rcc.CSR = RCC_FLAG_PORRST | RCC_FLAG_PINRST;
+    const char *backup = getenv(BACKUP_ENV);
+    if (backup) {
+        volatile uint32_t *dr = &HalShim_Bkp.DR1;
+        char *end;
+        HalShim_Rcc.CSR = (uint32_t)strtoul(backup, &end, 16);
+        for (int i = 0; i < 10 && *end == ','; i++) {
+            dr[i] = (uint32_t)strtoul(end + 1, &end, 16);
+        }
+        unsetenv(BACKUP_ENV);
+    }
+}
+
+HAL_StatusTypeDef HAL_Init(void) {
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    flash_init();
+    HAL_NVIC_SetPriority(SysTick_IRQn, TICK_INT_PRIORITY, 0);
+    find_vector(SysTick_IRQn)->enabled = true;
+
+    if (!manual_mode) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, irq_thread, NULL) != 0) {
+            perror("hal_shim: interrupt thread");
+            exit(1);
+        }
+        pthread_detach(thread);
+    }
+    return HAL_OK;
+}
+
+void HAL_NVIC_SetPriorityGrouping(uint32_t PriorityGroup) {
+    (void)PriorityGroup;
+}
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority) {
+    ShimVector *v = find_vector(IRQn);
+    if (v) {
+        v->priority = (uint8_t)((PreemptPriority << 4) | (SubPriority & 0x0FU));
+    }
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn) {
+    ShimVector *v = find_vector(IRQn);
+    if (v) {
+        v->enabled = true;
+    }
+}
+
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn) {
+    ShimVector *v = find_vector(IRQn);
+    if (v) {
+        v->enabled = false;
+    }
+}
+
+void HAL_NVIC_SystemReset(void) {
+    // Restart the process; the flash image carries over like on the target
+    fprintf(stderr, "hal_shim: system reset\n");
+    fflush(NULL);
+    if (saved_argv) {
+        const volatile uint32_t *dr = &HalShim_Bkp.DR1;
+        char backup[128];
+        int pos = snprintf(backup, sizeof(backup), "%lx", (unsigned long)(HalShim_Rcc.CSR | RCC_FLAG_SFTRST));
+        for (int i = 0; i < 10; i++) {
+            pos += snprintf(&backup[pos], sizeof(backup) - (size_t)pos, ",%lx", (unsigned long)dr[i]);
+        }
+        setenv(BACKUP_ENV, backup, 1);
+        execv("/proc/self/exe", saved_argv);
+    }
+    exit(0);
+}
+
+// --- PWR ---
+void HAL_PWR_EnableBkUpAccess(void) {
+    HalShim_Pwr.CR |= PWR_CR_DBP;
+}
+
+void HAL_PWR_DisableBkUpAccess(void) {
+    HalShim_Pwr.CR &= ~PWR_CR_DBP;
+}
+
+// --- RCC ---
+HAL_StatusTypeDef HAL_RCC_OscConfig(RCC_OscInitTypeDef *RCC_OscInitStruct) {
+    (void)RCC_OscInitStruct;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RCC_ClockConfig(RCC_ClkInitTypeDef *RCC_ClkInitStruct, uint32_t FLatency) {
+    (void)RCC_ClkInitStruct;
+    (void)FLatency;
+    SystemCoreClock = 72000000U;
+    return HAL_OK;
+}
+
+// --- DWT ---
+// CYCCNT counts at the core clock derived from the host's monotonic clock.
+// A value written by the firmware (usually 0) becomes the new origin, and
+// the count holds while it is disabled.
+static DWT_Type dwt;
+static uint32_t dwt_last;
+static bool dwt_running;
+static uint32_t dwt_offset;
+static pthread_mutex_t dwt_lock = PTHREAD_MUTEX_INITIALIZER;
+
+DWT_Type *HalShim_Dwt(void) {
+    pthread_mutex_lock(&dwt_lock);
+    if ((HalShim_CoreDebug.DEMCR & CoreDebug_DEMCR_TRCENA_Msk) && (dwt.CTRL & DWT_CTRL_CYCCNTENA_Msk)) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        uint64_t ns = (uint64_t)now.tv_sec * 1000000000U + (uint64_t)now.tv_nsec;
+        uint32_t cycles = (uint32_t)(ns * (SystemCoreClock / 1000000U) / 1000U);
+        if (!dwt_running || dwt.CYCCNT != dwt_last) {
+            dwt_offset = dwt.CYCCNT - cycles;
+        }
+        dwt.CYCCNT = dwt_last = cycles + dwt_offset;
+        dwt_running = true;
+    } else {
+        dwt_running = false;
+    }
+    pthread_mutex_unlock(&dwt_lock);
+    return &dwt;
+}
+
+// --- SysTick ---
+static SysTick_Type systick;
+static SCB_Type scb;
+
+SysTick_Type *HalShim_SysTick(void) {
+    uint64_t us = HalShim_NowUs();
+    systick.LOAD = SystemCoreClock / 1000U - 1U;
+    systick.VAL = systick.LOAD - (uint32_t)((us % 1000U) * (systick.LOAD + 1U) / 1000U);
+    return &systick;
+}
+
+SCB_Type *HalShim_Scb(void) {
+    bool due = find_vector(SysTick_IRQn)->pending || HalShim_NowUs() / 1000U > uwTick;
+    scb.ICSR = due ? SCB_ICSR_PENDSTSET_Msk : 0U;
+    return &scb;
+}
+
+// --- GPIO ---
+// Pins are not modelled individually: ODR is the output state and IDR
+// mirrors it, which is what a loopback probe on the pins would read.
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init) {
+    (void)GPIOx;
+    (void)GPIO_Init;
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState) {
+    if (PinState != GPIO_PIN_RESET) {
+        WRITE_REG(GPIOx->BSRR, GPIO_Pin);
+    } else {
+        WRITE_REG(GPIOx->BSRR, (uint32_t)GPIO_Pin << 16U);
+    }
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin) {
+    return (GPIOx->IDR & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin) {
+    WRITE_REG(GPIOx->ODR, GPIOx->ODR ^ GPIO_Pin);
+}
+
+uint32_t HalShim_GpioOdr(const GPIO_TypeDef *port) {
+    return port->ODR;
+}
+
+// Applies the side effects of write-only set/reset registers. Set wins over
+// reset for the same pin, as in the reference manual.
+void HalShim_WriteReg(volatile uint32_t *reg, uint32_t val) {
+    GPIO_TypeDef *ports[] = { GPIOA, GPIOB, GPIOC };
+    for (size_t i = 0; i < sizeof(ports) / sizeof(ports[0]); i++) {
+        GPIO_TypeDef *port = ports[i];
+        if (reg == &port->BSRR) {
+            port->ODR = (port->ODR & ~(val >> 16U)) | (val & 0xFFFFU);
+            port->IDR = port->ODR;
+            return;
+        }
+        if (reg == &port->BRR) {
+            port->ODR &= ~(val & 0xFFFFU);
+            port->IDR = port->ODR;
+            return;
+        }
+        if (reg == &port->ODR) {
+            port->ODR = val & 0xFFFFU;
+            port->IDR = port->ODR;
+            return;
+        }
+    }
+    *reg = val;
+}
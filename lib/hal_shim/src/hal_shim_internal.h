@@ -0,0 +1,24 @@
+#ifndef HAL_SHIM_INTERNAL_H
+#define HAL_SHIM_INTERNAL_H
+
+// Glue between the shim's core (time, IRQs) and its peripheral models.
+
+#include "hal_shim.h"
+
+bool HalShim_IsManual(void);
+
+// Each peripheral model exposes an optional file descriptor for the
+// interrupt thread to poll, a handler for when it becomes readable and a
+// tick that completes in-flight transfers whose wire time has elapsed.
+// All three run with the IRQ lock held.
+int HalShim_CanFd(void);
+void HalShim_CanReadable(void);
+void HalShim_CanTick(uint64_t now_us);
+
+int HalShim_UartFd(void);
+void HalShim_UartReadable(void);
+void HalShim_UartTick(uint64_t now_us);
+
+void HalShim_TimTick(uint64_t now_us); // No descriptor: time driven only
+
+#endif // HAL_SHIM_INTERNAL_H
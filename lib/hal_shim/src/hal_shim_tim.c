@@ -0,0 +1,74 @@
+#include "hal_shim_internal.h"
+
+// TIM3 time base: only the update event is modelled. Its period follows
+// PSC and ARR at the shim clock, and an update that falls due sets UIF and
+// pends TIM3_IRQn. Updates missed while interrupts were held off collapse
+// into one, as UIF does on the target.
+
+TIM_TypeDef HalShim_Tim3;
+
+static uint64_t tim3_next_us; // Shim time of the next update event
+
+static uint64_t tim_period_us(const TIM_TypeDef *tim) {
+    uint64_t ticks = (uint64_t)(tim->PSC + 1U) * (tim->ARR + 1U);
+    uint64_t clock_mhz = SystemCoreClock / 1000000U;
+    uint64_t us = ticks / (clock_mhz ? clock_mhz : 1U);
+    return us ? us : 1U;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef *htim) {
+    if (htim->Instance != TIM3) {
+        return HAL_ERROR;
+    }
+    htim->Instance->PSC = htim->Init.Prescaler;
+    htim->Instance->ARR = htim->Init.Period;
+    htim->Instance->CNT = 0;
+    htim->State = HAL_TIM_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef *htim) {
+    if (htim->State != HAL_TIM_STATE_READY) {
+        return HAL_ERROR;
+    }
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    htim->Instance->DIER |= TIM_DIER_UIE;
+    htim->Instance->CR1 |= TIM_CR1_CEN;
+    tim3_next_us = HalShim_NowUs() + tim_period_us(htim->Instance);
+    htim->State = HAL_TIM_STATE_BUSY;
+    __set_PRIMASK(primask);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Stop_IT(TIM_HandleTypeDef *htim) {
+    htim->Instance->DIER &= ~TIM_DIER_UIE;
+    htim->Instance->CR1 &= ~TIM_CR1_CEN;
+    htim->State = HAL_TIM_STATE_READY;
+    return HAL_OK;
+}
+
+void HalShim_TimTick(uint64_t now_us) {
+    TIM_TypeDef *tim = &HalShim_Tim3;
+    if (!(tim->CR1 & TIM_CR1_CEN) || now_us < tim3_next_us) {
+        return;
+    }
+    uint64_t period = tim_period_us(tim);
+    while (tim3_next_us <= now_us) {
+        tim3_next_us += period;
+    }
+    tim->SR |= TIM_SR_UIF;
+    if (tim->DIER & TIM_DIER_UIE) {
+        HalShim_SetPending(TIM3_IRQn);
+    }
+}
+
+void HAL_TIM_IRQHandler(TIM_HandleTypeDef *htim) {
+    TIM_TypeDef *tim = htim->Instance;
+    if ((tim->SR & TIM_SR_UIF) && (tim->DIER & TIM_DIER_UIE)) {
+        tim->SR &= ~TIM_SR_UIF;
+        HAL_TIM_PeriodElapsedCallback(htim);
+    }
+}
+
+void __attribute__((weak)) HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim) { (void)htim; }
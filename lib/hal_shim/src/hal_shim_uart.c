@@ -0,0 +1,249 @@
+#define _GNU_SOURCE
+#include "hal_shim_internal.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+// termios.h output-delay flags clash with the USART register names
+#undef CR1
+#undef CR2
+#undef CR3
+
+// USART1 + DMA1 channel 4/5 model. The host end of USART1 is a
+// pseudo-terminal: point the head-unit simulator (or picocom) at the slave
+// path printed on start-up. TX completes after the bytes' wire time at the
+// configured baud rate, RX bytes land in the DMA buffer and raise IDLE at
+// the end of each burst.
+
+USART_TypeDef HalShim_Usart1;
+DMA_Channel_TypeDef HalShim_Dma1Channel4, HalShim_Dma1Channel5;
+
+static struct {
+    UART_HandleTypeDef *huart;
+    int pty;
+    HalShim_UartTxHook tx_hook;
+    // TX
+    bool tx_busy;
+    uint64_t tx_due_us;
+    bool tx_dma_done;
+    bool tx_complete;
+    // RX
+    bool rx_dma;
+    uint16_t rx_pos;
+    bool rx_half;
+    bool rx_full;
+} uart = { .pty = -1 };
+
+static void uart_open_pty(void) {
+    int fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0 || grantpt(fd) < 0 || unlockpt(fd) < 0) {
+        perror("hal_shim: pseudo-terminal");
+        exit(1);
+    }
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    const char *slave = ptsname(fd);
+    fprintf(stderr, "hal_shim: USART1 on %s\n", slave);
+    const char *link = getenv("CANBOX_PTY_LINK");
+    if (link) {
+        unlink(link);
+        if (symlink(slave, link) < 0) {
+            perror("hal_shim: CANBOX_PTY_LINK");
+        }
+    }
+    uart.pty = fd;
+}
+
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *hdma) {
+    hdma->Instance->CCR = hdma->Init.Direction | hdma->Init.MemInc | hdma->Init.Mode | hdma->Init.Priority;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart) {
+    if (huart->Init.BaudRate == 0U) {
+        return HAL_ERROR;
+    }
+    uart.huart = huart;
+    huart->gState = 0x20U;  // HAL_UART_STATE_READY
+    huart->RxState = 0x20U;
+    huart->ErrorCode = 0U;
+    huart->Instance->SR = UART_FLAG_TXE | UART_FLAG_TC;
+    if (uart.pty < 0 && !HalShim_IsManual()) {
+        uart_open_pty();
+    }
+    return HAL_OK;
+}
+
+static void uart_emit(const uint8_t *data, size_t len) {
+    if (uart.pty >= 0 && write(uart.pty, data, len) < 0) {
+        // Nobody reading and the pty buffer is full: bytes are lost on the wire
+    }
+    if (uart.tx_hook) {
+        uart.tx_hook(data, len);
+    }
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size, uint32_t Timeout) {
+    (void)huart;
+    (void)Timeout;
+    uart_emit(pData, Size);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size) {
+    if (huart->gState != 0x20U || Size == 0U) {
+        return HAL_BUSY;
+    }
+    huart->gState = 0x21U; // HAL_UART_STATE_BUSY_TX
+    huart->Instance->SR &= ~UART_FLAG_TC;
+    // The bytes are handed to the host immediately; completion is reported
+    // once they would have left the shifter (10 bits per byte).
+    uart_emit(pData, Size);
+    uart.tx_busy = true;
+    uart.tx_due_us = HalShim_NowUs() + (uint64_t)Size * 10U * 1000000U / huart->Init.BaudRate;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Receive_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size) {
+    if (huart->RxState != 0x20U || !huart->hdmarx || Size == 0U) {
+        return HAL_BUSY;
+    }
+    huart->RxState = 0x22U; // HAL_UART_STATE_BUSY_RX
+    huart->pRxBuffPtr = pData;
+    huart->RxXferSize = Size;
+    huart->hdmarx->Instance->CNDTR = Size;
+    uart.rx_dma = true;
+    uart.rx_pos = 0;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_AbortReceive(UART_HandleTypeDef *huart) {
+    uart.rx_dma = false;
+    uart.rx_half = uart.rx_full = false;
+    huart->RxState = 0x20U;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_DMAStop(UART_HandleTypeDef *huart) {
+    uart.tx_busy = uart.tx_dma_done = uart.tx_complete = false;
+    huart->gState = 0x20U;
+    return HAL_UART_AbortReceive(huart);
+}
+
+void HalShim_UartInject(const uint8_t *data, size_t len) {
+    UART_HandleTypeDef *huart = uart.huart;
+    if (!huart || len == 0) {
+        return;
+    }
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    for (size_t i = 0; i < len; i++) {
+        if (!uart.rx_dma) {
+            // No receiver armed: the byte sits in DR until the next one overruns it
+            if (huart->Instance->SR & UART_FLAG_RXNE) {
+                huart->Instance->SR |= UART_FLAG_ORE;
+            }
+            huart->Instance->DR = data[i];
+            huart->Instance->SR |= UART_FLAG_RXNE;
+            continue;
+        }
+        uint16_t size = huart->RxXferSize;
+        huart->pRxBuffPtr[uart.rx_pos++] = data[i];
+        if (uart.rx_pos == size / 2U) {
+            uart.rx_half = true;
+            HalShim_SetPending(DMA1_Channel5_IRQn);
+        }
+        if (uart.rx_pos == size) {
+            uart.rx_full = true;
+            uart.rx_pos = 0;
+            HalShim_SetPending(DMA1_Channel5_IRQn);
+            if (huart->hdmarx->Init.Mode != DMA_CIRCULAR) {
+                uart.rx_dma = false;
+                huart->RxState = 0x20U;
+            }
+        }
+        huart->hdmarx->Instance->CNDTR = (uint32_t)(size - uart.rx_pos);
+    }
+    // The line goes idle after the burst
+    huart->Instance->SR |= UART_FLAG_IDLE;
+    if (huart->Instance->CR1 & (UART_IT_IDLE | UART_IT_RXNE)) {
+        HalShim_SetPending(USART1_IRQn);
+    }
+    __set_PRIMASK(primask);
+}
+
+void HalShim_UartSetTxHook(HalShim_UartTxHook hook) {
+    uart.tx_hook = hook;
+}
+
+int HalShim_UartFd(void) {
+    return uart.pty;
+}
+
+void HalShim_UartReadable(void) {
+    uint8_t buf[256];
+    ssize_t n;
+    while ((n = read(uart.pty, buf, sizeof(buf))) > 0) {
+        HalShim_UartInject(buf, (size_t)n);
+    }
+}
+
+void HalShim_UartTick(uint64_t now_us) {
+    if (uart.tx_busy && now_us >= uart.tx_due_us) {
+        uart.tx_busy = false;
+        uart.tx_dma_done = true;
+        HalShim_SetPending(DMA1_Channel4_IRQn);
+    }
+}
+
+// --- IRQ ---
+void __attribute__((weak)) HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart) { (void)huart; }
+void __attribute__((weak)) HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef *huart) { (void)huart; }
+void __attribute__((weak)) HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart) { (void)huart; }
+void __attribute__((weak)) HAL_UART_ErrorCallback(UART_HandleTypeDef *huart) { (void)huart; }
+
+void HAL_DMA_IRQHandler(DMA_HandleTypeDef *hdma) {
+    UART_HandleTypeDef *huart = hdma->Parent;
+    if (!huart) {
+        return;
+    }
+    if (hdma == huart->hdmatx && uart.tx_dma_done) {
+        // As in the HAL: DMA TC only enables USART TC, the callback comes from there
+        uart.tx_dma_done = false;
+        uart.tx_complete = true;
+        huart->Instance->SR |= UART_FLAG_TC;
+        huart->Instance->CR1 |= UART_IT_TC;
+        HalShim_SetPending(USART1_IRQn);
+    }
+    if (hdma == huart->hdmarx) {
+        if (uart.rx_half) {
+            uart.rx_half = false;
+            HAL_UART_RxHalfCpltCallback(huart);
+        }
+        if (uart.rx_full) {
+            uart.rx_full = false;
+            HAL_UART_RxCpltCallback(huart);
+        }
+    }
+}
+
+void HAL_UART_IRQHandler(UART_HandleTypeDef *huart) {
+    if (huart->Instance->SR & UART_FLAG_ORE) {
+        // Overrun: the HAL aborts reception and reports it
+        huart->Instance->SR &= ~(UART_FLAG_ORE | UART_FLAG_RXNE);
+        huart->ErrorCode |= 0x08U; // HAL_UART_ERROR_ORE
+        HAL_UART_AbortReceive(huart);
+        HAL_UART_ErrorCallback(huart);
+    }
+    if (uart.tx_complete && (huart->Instance->CR1 & UART_IT_TC)) {
+        uart.tx_complete = false;
+        huart->Instance->CR1 &= ~UART_IT_TC;
+        huart->gState = 0x20U;
+        HAL_UART_TxCpltCallback(huart);
+    }
+}
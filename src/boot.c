@@ -0,0 +1,112 @@
+#include "boot.h"
+#include "scheduler.h" // For Sched_Micros
+#include "uart.h" // For SendToAndroid
+#include <stdio.h>
+#include <string.h>
+
+#ifndef USE_QEMU
+static const char *boot_cause = "POR";
+static uint32_t boot_outputs_us;
+static uint16_t boot_outputs_pins;
+static uint32_t boot_clock_us;      // main() to the PLL switch
+static uint32_t boot_clock_sched;   // Sched_Micros() at that moment
+static uint32_t boot_can_us;
+static bool boot_can_seen;
+
+void Boot_Start(void) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    // POR also sets PINRST, and a watchdog reset drives NRST as well, so the
+    // specific causes are tested first
+    if (__HAL_RCC_GET_FLAG(RCC_FLAG_LPWRRST)) {
+        boot_cause = "LPWR";
+    } else if (__HAL_RCC_GET_FLAG(RCC_FLAG_WWDGRST)) {
+        boot_cause = "WWDG";
+    } else if (__HAL_RCC_GET_FLAG(RCC_FLAG_IWDGRST)) {
+        boot_cause = "IWDG";
+    } else if (__HAL_RCC_GET_FLAG(RCC_FLAG_SFTRST)) {
+        boot_cause = "SFT";
+    } else if (__HAL_RCC_GET_FLAG(RCC_FLAG_PORRST)) {
+        boot_cause = "POR";
+    } else {
+        boot_cause = "PIN";
+    }
+    __HAL_RCC_CLEAR_RESET_FLAGS(); // The next reset reports only its own cause
+}
+
+void Boot_OutputsValid(uint16_t pins) {
+    boot_outputs_us = DWT->CYCCNT / BOOT_HSI_MHZ;
+    boot_outputs_pins = pins;
+}
+
+// The few hundred cycles between the PLL switch and here are counted at the
+// HSI rate, a few us too many
+void Boot_ClockReady(void) {
+    boot_clock_us = DWT->CYCCNT / BOOT_HSI_MHZ;
+    boot_clock_sched = Sched_Micros();
+}
+
+static void Boot_SendCan(void) {
+    char line[24];
+
+    if (boot_can_seen) {
+        snprintf(line, sizeof(line), "CAN,%lu", (unsigned long)boot_can_us);
+        SendToAndroid(RESP_BOOT, line);
+    } else {
+        SendToAndroid(RESP_BOOT, "CAN,-");
+    }
+}
+
+void Boot_FirstFrame(uint32_t stamp_us) {
+    if (boot_can_seen) {
+        return;
+    }
+    boot_can_seen = true;
+    boot_can_us = boot_clock_us + (stamp_us - boot_clock_sched);
+    Boot_SendCan();
+}
+
+void Boot_Report(void) {
+    char line[32];
+
+    snprintf(line, sizeof(line), "RST,%s", boot_cause);
+    SendToAndroid(RESP_BOOT, line);
+    snprintf(line, sizeof(line), "OUT,%lu,%X", (unsigned long)boot_outputs_us, boot_outputs_pins);
+    SendToAndroid(RESP_BOOT, line);
+}
+
+void Boot_Command(const char *value) {
+    if (value[0] != '\0' && strcmp(value, "GET") != 0) {
+        SendToAndroid(RESP_ERR, ERR_INVALID_COMMAND);
+        return;
+    }
+    Boot_Report();
+    Boot_SendCan();
+    SendToAndroid(RESP_BOOT, "END");
+}
+#else
+// No reset flags or backup domain in the QEMU build
+void Boot_Start(void) {
+}
+
+void Boot_OutputsValid(uint16_t pins) {
+    (void)pins;
+}
+
+void Boot_ClockReady(void) {
+}
+
+void Boot_Report(void) {
+}
+
+void Boot_FirstFrame(uint32_t stamp_us) {
+    (void)stamp_us;
+}
+
+void Boot_Command(const char *value) {
+    (void)value;
+    SendToAndroid(RESP_ERR, ERR_INVALID_COMMAND);
+}
+#endif // USE_QEMU
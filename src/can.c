@@ -1,7 +1,18 @@
 #include "can.h"
+#include "can_rx.h"
+#include "can_tx.h"
+#include "can_filter.h"
+#include "can_health.h"
+#include "boot.h"
+#include "signal_db.h"
+#include "perf.h"
+#include "scheduler.h"
+#include "sniffer.h"
+#include "isotp.h"
 #include "config.h" // For configuration parameters
-#include "commands.h" // For SendToAndroid
+#include "uart.h" // For SendToAndroid
 #include "signals.h" //For defines
+#include <string.h>
 #ifndef USE_QEMU
 CAN_HandleTypeDef hcan; // Define hcan here
 #endif
@@ -29,7 +40,7 @@ void CAN_Init(void) {
     hcan.Init.Mode = CAN_MODE_NORMAL;
     hcan.Init.AutoBusOff = DISABLE;
     hcan.Init.AutoWakeUp = DISABLE;
-    hcan.Init.AutoRetransmission = ENABLE;
+    hcan.Init.AutoRetransmission = DISABLE; // Retries are handled by the TX queue
     hcan.Init.ReceiveFifoLocked = DISABLE;
     hcan.Init.TransmitFifoPriority = DISABLE;
     hcan.Init.SyncJumpWidth = CAN_SJW_1TQ;
@@ -45,108 +56,160 @@ void CAN_Init(void) {
     }
 
     // --- CAN Filter Configuration ---
-    // Steering Wheel Controls
-    CAN_FilterTypeDef canfilterconfig;
-    canfilterconfig.FilterActivation = CAN_FILTER_ENABLE;
-    canfilterconfig.FilterBank = 0;
-    canfilterconfig.FilterFIFOAssignment = CAN_FILTER_FIFO0;
-    canfilterconfig.FilterIdHigh = STEERING_WHEEL_CONTROLS_ID << 5;
-    canfilterconfig.FilterIdLow = 0x0000;
-    canfilterconfig.FilterMaskIdHigh = 0x7ff << 5;
-    canfilterconfig.FilterMaskIdLow = 0x0000;
-    canfilterconfig.FilterMode = CAN_FILTERMODE_IDMASK;
-    canfilterconfig.FilterScale = CAN_FILTERSCALE_32BIT;
-    canfilterconfig.SlaveStartFilterBank = 14;
-    if (HAL_CAN_ConfigFilter(&hcan, &canfilterconfig) != HAL_OK) {
+    // Generated from the active configuration, see can_filter.c
+    if (!CAN_Filter_Apply()) {
         Error_Handler();
     }
 
-    // Ignition Status
-    CAN_FilterTypeDef canfilterconfig_ign;
-    canfilterconfig_ign.FilterActivation = CAN_FILTER_ENABLE;
-    canfilterconfig_ign.FilterBank = 1;
-    canfilterconfig_ign.FilterFIFOAssignment = CAN_FILTER_FIFO0;
-    canfilterconfig_ign.FilterIdHigh = IGNITION_STATUS_ID << 5;
-    canfilterconfig_ign.FilterIdLow = 0x0000;
-    canfilterconfig_ign.FilterMaskIdHigh = 0x7ff << 5;
-    canfilterconfig_ign.FilterMaskIdLow = 0x0000;
-    canfilterconfig_ign.FilterMode = CAN_FILTERMODE_IDMASK;
-    canfilterconfig_ign.FilterScale = CAN_FILTERSCALE_32BIT;
-    canfilterconfig_ign.SlaveStartFilterBank = 14;
-    if (HAL_CAN_ConfigFilter(&hcan, &canfilterconfig_ign) != HAL_OK) {
+    // --- Start CAN ---
+    // Interrupts are enabled first, while the handle is READY: a start that
+    // times out leaves it in the error state, where the HAL refuses them.
+    // IER survives the restarts. FIFO1 full and overrun are polled by its
+    // own handler, see below.
+    if (HAL_CAN_ActivateNotification(&hcan, CAN_IT_RX_FIFO0_MSG_PENDING | CAN_IT_RX_FIFO0_FULL |
+                                            CAN_IT_RX_FIFO0_OVERRUN | CAN_IT_RX_FIFO1_MSG_PENDING |
+                                            CAN_IT_TX_MAILBOX_EMPTY | CAN_IT_ERROR_WARNING |
+                                            CAN_IT_ERROR_PASSIVE | CAN_IT_BUSOFF |
+                                            CAN_IT_LAST_ERROR_CODE | CAN_IT_ERROR) != HAL_OK) {
         Error_Handler();
     }
+    // A bus that holds the controller in initialization (shorted, no
+    // transceiver power) is not fatal: the bus health monitor retries.
+    CAN_Health_Started(HAL_CAN_Start(&hcan) == HAL_OK);
 
-    // Illumination and Park
-    CAN_FilterTypeDef canfilterconfig_illum;
-    canfilterconfig_illum.FilterActivation = CAN_FILTER_ENABLE;
-    canfilterconfig_illum.FilterBank = 2;
-    canfilterconfig_illum.FilterFIFOAssignment = CAN_FILTER_FIFO0;
-    canfilterconfig_illum.FilterIdHigh = DASHBOARD_LIGHTS_ID << 5;
-    canfilterconfig_illum.FilterIdLow = 0x0000;
-    canfilterconfig_illum.FilterMaskIdHigh = 0x7ff << 5;
-    canfilterconfig_illum.FilterMaskIdLow = 0x0000;
-    canfilterconfig_illum.FilterMode = CAN_FILTERMODE_IDMASK;
-    canfilterconfig_illum.FilterScale = CAN_FILTERSCALE_32BIT;
-    canfilterconfig_illum.SlaveStartFilterBank = 14;
-    if (HAL_CAN_ConfigFilter(&hcan, &canfilterconfig_illum) != HAL_OK) {
-        Error_Handler();
-    }
+    // Enable CAN RX0, RX1 and TX interrupts
+    HAL_NVIC_SetPriority(CAN1_RX1_IRQn, IRQ_PRIO_CAN_FAST, 0); // Fast path
+    HAL_NVIC_EnableIRQ(CAN1_RX1_IRQn);
+    HAL_NVIC_SetPriority(USB_LP_CAN1_RX0_IRQn, IRQ_PRIO_CAN, 0);
+    HAL_NVIC_EnableIRQ(USB_LP_CAN1_RX0_IRQn);
+    HAL_NVIC_SetPriority(USB_HP_CAN1_TX_IRQn, IRQ_PRIO_CAN, 0);
+    HAL_NVIC_EnableIRQ(USB_HP_CAN1_TX_IRQn);
+    HAL_NVIC_SetPriority(CAN1_SCE_IRQn, IRQ_PRIO_CAN, 0); // Error and status changes
+    HAL_NVIC_EnableIRQ(CAN1_SCE_IRQn);
+}
 
-    // Reverse Gear
-    CAN_FilterTypeDef canfilterconfig_rear;
-    canfilterconfig_rear.FilterActivation = CAN_FILTER_ENABLE;
-    canfilterconfig_rear.FilterBank = 3;
-    canfilterconfig_rear.FilterFIFOAssignment = CAN_FILTER_FIFO0;
-    canfilterconfig_rear.FilterIdHigh = REVERSE_GEAR_ID << 5;
-    canfilterconfig_rear.FilterIdLow = 0x0000;
-    canfilterconfig_rear.FilterMaskIdHigh = 0x7ff << 5;
-    canfilterconfig_rear.FilterMaskIdLow = 0x0000;
-    canfilterconfig_rear.FilterMode = CAN_FILTERMODE_IDMASK;
-    canfilterconfig_rear.FilterScale = CAN_FILTERSCALE_32BIT;
-    canfilterconfig_rear.SlaveStartFilterBank = 14;
-    if (HAL_CAN_ConfigFilter(&hcan, &canfilterconfig_rear) != HAL_OK) {
-        Error_Handler();
-    }
+void USB_LP_CAN1_RX0_IRQHandler(void) {
+    HAL_CAN_IRQHandler(&hcan);
+}
 
-    // Door Status
-    CAN_FilterTypeDef canfilterconfig_door;
-    canfilterconfig_door.FilterActivation = CAN_FILTER_ENABLE;
-    canfilterconfig_door.FilterBank = 4;
-    canfilterconfig_door.FilterFIFOAssignment = CAN_FILTER_FIFO0;
-    canfilterconfig_door.FilterIdHigh = DOOR_STATUS_ID << 5;
-    canfilterconfig_door.FilterIdLow = 0x0000;
-    canfilterconfig_door.FilterMaskIdHigh = 0x7ff << 5;
-    canfilterconfig_door.FilterMaskIdLow = 0x0000;
-    canfilterconfig_door.FilterMode = CAN_FILTERMODE_IDMASK;
-    canfilterconfig_door.FilterScale = CAN_FILTERSCALE_32BIT;
-    canfilterconfig_door.SlaveStartFilterBank = 14;
-    if (HAL_CAN_ConfigFilter(&hcan, &canfilterconfig_door) != HAL_OK) {
-        Error_Handler();
+static void CAN_ReceiveFifo1(void);
+
+// Not HAL_CAN_IRQHandler(): that would also serve the TX mailboxes and
+// the error flags at this priority, preempting the other CAN interrupts.
+// The FIFO1 full and overrun flags are checked here instead of raising
+// interrupts of their own.
+void CAN1_RX1_IRQHandler(void) {
+    if (__HAL_CAN_GET_FLAG(&hcan, CAN_FLAG_FOV1)) {
+        __HAL_CAN_CLEAR_FLAG(&hcan, CAN_FLAG_FOV1);
+        CAN_Health_OnError(HAL_CAN_ERROR_RX_FOV1);
+    }
+    if (__HAL_CAN_GET_FLAG(&hcan, CAN_FLAG_FF1)) {
+        __HAL_CAN_CLEAR_FLAG(&hcan, CAN_FLAG_FF1);
+        HAL_CAN_RxFifo1FullCallback(&hcan);
     }
+    while (HAL_CAN_GetRxFifoFillLevel(&hcan, CAN_RX_FIFO1) != 0) {
+        CAN_ReceiveFifo1();
+    }
+}
 
-    // --- Start CAN ---
-    if (HAL_CAN_Start(&hcan) != HAL_OK) {
-        Error_Handler();
+void USB_HP_CAN1_TX_IRQHandler(void) {
+    HAL_CAN_IRQHandler(&hcan);
+}
+
+void CAN1_SCE_IRQHandler(void) {
+    HAL_CAN_IRQHandler(&hcan);
+}
+
+void HAL_CAN_ErrorCallback(CAN_HandleTypeDef *hcan) {
+    uint32_t error_code = HAL_CAN_GetError(hcan);
+
+    HAL_CAN_ResetError(hcan);
+    if (error_code & HAL_CAN_ERROR_RX_FOV0) {
+        PERF_COUNT(FIFO_OVERRUNS, 1); // A frame was lost in FIFO0
     }
-    if (HAL_CAN_ActivateNotification(&hcan, CAN_IT_RX_FIFO0_MSG_PENDING) != HAL_OK) {
-        Error_Handler();
+    CAN_Health_OnError(error_code);
+    CAN_TxQueue_OnError(error_code);
+}
+
+// Hand a received frame to the main loop. Each FIFO has its own ring and
+// counters, written by its interrupt only, so nothing is masked here.
+static void CAN_Receive(uint32_t fifo, const CanRxFrame *frame) {
+    CAN_Health_OnFrame(fifo, frame->dlc);
+    CAN_RxRing_Push(fifo == CAN_RX_FIFO0 ? CAN_RX_RING_FIFO0 : CAN_RX_RING_FIFO1,
+                    frame); // A full ring is counted in the ring stats
+    if (fifo == CAN_RX_FIFO0) {
+        PERF_COUNT(FRAMES_RX, 1);
+    } else {
+        PERF_COUNT(FRAMES_RX1, 1);
     }
+    Sched_Post(EVT_CAN_RX);
+}
+
+// All three mailboxes taken: the next frame for this FIFO overruns it
+void HAL_CAN_RxFifo0FullCallback(CAN_HandleTypeDef *hcan) {
+    (void)hcan;
+    CAN_Health_OnFifoFull(CAN_RX_FIFO0);
+}
+
+void HAL_CAN_RxFifo1FullCallback(CAN_HandleTypeDef *hcan) {
+    (void)hcan;
+    CAN_Health_OnFifoFull(CAN_RX_FIFO1);
 }
 
 void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan) {
-   CAN_RxHeaderTypeDef RxHeader;
-    uint8_t RxData[8];
+    // Copy the frame out of the hardware FIFO and nothing else. Decoding (and
+    // the UART traffic it causes) runs later from CAN_ProcessPending().
+    CAN_RxHeaderTypeDef RxHeader;
+    CanRxFrame frame;
+    PERF_START(CAN_RX_ISR);
+
+    if (HAL_CAN_GetRxMessage(hcan, CAN_RX_FIFO0, &RxHeader, frame.data) != HAL_OK) {
+        Error_Handler(); //  CAN RX error
+    }
+
+    frame.id = (RxHeader.IDE == CAN_ID_EXT) ? (RxHeader.ExtId | CAN_RX_ID_EXT) : RxHeader.StdId;
+    frame.dlc = (uint8_t)(RxHeader.DLC > CAN_RX_MAX_DLC ? CAN_RX_MAX_DLC : RxHeader.DLC);
+    frame.fmi = (uint8_t)RxHeader.FilterMatchIndex;
+    frame.stamp_us = Sched_Micros();
+    CAN_Receive(CAN_RX_FIFO0, &frame);
+    PERF_STOP(CAN_RX_ISR);
+}
 
-    if (HAL_CAN_GetRxMessage(hcan, CAN_RX_FIFO0, &RxHeader, RxData) != HAL_OK) {
+// FIFO1 carries the low-rate, latency-critical IDs (CAN_FILTER_FIFO1_SIGNALS).
+// The outputs that follow CAN_FILTER_FAST_SIGNALS are driven from here, then
+// every frame takes the normal route (decoded in the main loop, which sends
+// !REV:ON and confirms the pin). PERF_CAN_FAST times interrupt entry to the
+// GPIO write. Runs from CAN1_RX1_IRQHandler() only.
+static void CAN_ReceiveFifo1(void) {
+    CAN_RxHeaderTypeDef RxHeader;
+    CanRxFrame frame;
+    PERF_START(CAN_FAST);
+
+    if (HAL_CAN_GetRxMessage(&hcan, CAN_RX_FIFO1, &RxHeader, frame.data) != HAL_OK) {
         Error_Handler(); //  CAN RX error
     }
 
-    ProcessCanMessage(RxHeader.StdId, RxData, RxHeader.DLC);
+    frame.id = RxHeader.StdId; // Bank 12 lists standard IDs only
+    frame.dlc = (uint8_t)(RxHeader.DLC > CAN_RX_MAX_DLC ? CAN_RX_MAX_DLC : RxHeader.DLC);
+    frame.fmi = (uint8_t)(CAN_FILTER_FIFO1_FMI + RxHeader.FilterMatchIndex);
+    SignalMask fast = CAN_Filter_Fifo1SignalsFor(frame.fmi, frame.id) & CAN_FILTER_FAST_SIGNALS;
+    if (fast != 0 && GPIO_Status_FastPath(fast, SignalDb_Peek(fast, frame.data, frame.dlc)) != 0) {
+        PERF_STOP(CAN_FAST); // Only edges count: the pin usually stays as it is
+    }
+    frame.stamp_us = Sched_Micros();
+    CAN_Receive(CAN_RX_FIFO1, &frame);
+}
+
+// HAL_CAN_IRQHandler() on the RX0, TX and status vectors also serves FIFO1
+// while its interrupt is enabled. The frame is left to the RX1 interrupt,
+// which is pending for it at a higher priority, so the FIFO1 ring keeps a
+// single producer.
+void HAL_CAN_RxFifo1MsgPendingCallback(CAN_HandleTypeDef *hcan) {
+    (void)hcan;
 }
 #else
-// QEMU CAN Transmit (using SocketCAN) - No Changes
-int CAN_Transmit(uint32_t id, uint8_t *data, uint8_t len) {
+// QEMU CAN Transmit (using SocketCAN)
+static int CAN_TransmitSocket(uint32_t id, const uint8_t *data, uint8_t len) {
     int s;
     struct sockaddr_can addr;
     struct ifreq ifr;
@@ -184,116 +247,50 @@ int CAN_Transmit(uint32_t id, uint8_t *data, uint8_t len) {
 }
 #endif
 
-void CAN_Transmit(uint32_t id, uint8_t *data, uint8_t len) {
-    // ... (CAN Transmit code - Remains unchanged) ...
+bool CAN_Transmit(uint32_t id, const uint8_t *data, uint8_t len) {
 #ifndef USE_QEMU
-     CAN_TxHeaderTypeDef TxHeader;
-    uint8_t TxData[8];
-    uint32_t TxMailbox;
-
-    TxHeader.StdId = id;
-    TxHeader.ExtId = 0;
-    TxHeader.RTR = CAN_RTR_DATA;
-    TxHeader.IDE = CAN_ID_STD;
-    TxHeader.DLC = len;
-    TxHeader.TransmitGlobalTime = DISABLE;
-
-    if (len > 8) len = 8;
-    memcpy(TxData, data, len);
-
-    if (HAL_CAN_AddTxMessage(&hcan, &TxHeader, TxData, &TxMailbox) != HAL_OK) {
-        Error_Handler();
-    }
-    while (HAL_CAN_GetTxMailboxesFreeLevel(&hcan) != 3);
+    // Queued by priority and sent from the TX interrupt; never waits for the bus.
+    // Returns false if the queue is full.
+    return CAN_TxQueue_Push(id, data, len);
 #else
-    CAN_Transmit(id, data, len);
+    return CAN_TransmitSocket(id, data, len) == 0;
 #endif
 }
 
-void ProcessCanMessage(uint32_t can_id, uint8_t *data, uint8_t data_len) {
-     static bool ign_state = false;
-    static bool illum_state = false;
-    static bool park_state = false;
-    static bool rear_state = false;
-    static bool door_state = false;
+void CAN_ProcessPending(void) {
+    CanRxFrame frame;
 
-    if (can_id == STEERING_WHEEL_CONTROLS_ID) {
-        if (data_len > 0) {
-            // Use fazerxlo key codes directly
-            switch (data[0]) {
-                case 0x01: SendToAndroid(RESP_KEY, "SRC"); break;
-                case 0x02: SendToAndroid(RESP_KEY, "VOL+"); break;
-                case 0x04: SendToAndroid(RESP_KEY, "VOL-"); break;
-                case 0x08: SendToAndroid(RESP_KEY, "SEEK+"); break;
-                case 0x10: SendToAndroid(RESP_KEY, "SEEK-"); break;
-                case 0x40: SendToAndroid(RESP_KEY, "OK"); break;
-                case 0x80: SendToAndroid(RESP_KEY, "END"); break;
-                // Add other key codes as needed, matching fazerxlo/canbox
-                default: break;
-            }
-        }
-    } else if (can_id == config_ign_src) {
-        if (data_len >= 1) {
-            uint8_t ign_mode = data[0] & 0x07;
-            switch (ign_mode) {
-                case IGN_MODE_OFF:
-                    if (ign_state != false) {
-                        ign_state = false;
-                        SendToAndroid(RESP_IGN, "OFF");
-                    }
-                    break;
-                case IGN_MODE_ACCESSORY:
-                case IGN_MODE_ON:
-                case IGN_MODE_START:
-                    if (ign_state != true) {
-                        ign_state = true;
-                        SendToAndroid(RESP_IGN, "ON");
-                    }
-                    break;
-                default:
-                    if (ign_state != false){
-                        ign_state = false;
-                        SendToAndroid(RESP_IGN, "OFF");
-                    }
-                    break;
-            }
+    while (CAN_RxRing_Pop(&frame)) {
+        Boot_FirstFrame(frame.stamp_us); // Reset-to-first-frame time, once
+        PERF_START(CAN_DECODE);
+        PERF_LATENCY_BEGIN(frame.stamp_us); // Messages from this frame carry its RX stamp
+        uint8_t entry;
+        SignalMask signals = CAN_Filter_SignalsFor(frame.fmi, frame.id, &entry);
+        if (signals != 0 && !CAN_Filter_IsRepeat(entry, frame.data, frame.dlc)) {
+            SignalDb_Decode(signals, frame.data, frame.dlc);
+        } else if (signals == 0) {
+            IsoTp_Receive(frame.id, frame.data, frame.dlc); // Segmented messages, see isotp.h
         }
-    } else if (can_id == config_illum_src) {
-        if (data_len >= 1) {
-            bool low_beam_on = (data[0] & 0x10) != 0; // Only low beam
-            if (low_beam_on != illum_state) {
-                illum_state = low_beam_on;
-                SendToAndroid(RESP_ILLUM, illum_state ? "ON" : "OFF");
-            }
+        PERF_LATENCY_END();
+        PERF_COUNT(FRAMES_DECODED, 1);
+        PERF_STOP(CAN_DECODE);
+        if (Sniffer_IsActive()) {
+            Sniffer_Forward(&frame);
         }
-    } else if (can_id == config_park_src) {
-        if (data_len >= 1) {
-            bool new_park_state = (data[0] & 0x80) != 0;
-            if (new_park_state != park_state) {
-                park_state = new_park_state;
-                SendToAndroid(RESP_PARK, park_state ? "ON" : "OFF");
-            }
-        }
-    } else if (can_id == config_rev_src) {
-        if (data_len >= 1) {
-            bool new_rear_state = (data[0] & 0x04) != 0;
-            if (new_rear_state != rear_state) {
-                rear_state = new_rear_state;
-                SendToAndroid(RESP_REV, rear_state ? "ON" : "OFF"); // Changed to REV
-            }
-        }
-    }  else if (can_id == config_door_src) { // Door Status
-        if (data_len >= 1) {
-            //This is just an example how to handle door status
-            //Check PSACAN.md for details, here showed only for one door
-            bool front_left_door = (data[0] & 0x80) != 0; //Bit 7 for example
+    }
+}
 
-            //You can implement your logic here, for example if any door opened
-            //send information to Android.
-            if(front_left_door != door_state){
-                door_state = front_left_door;
-                SendToAndroid(RESP_DOOR, door_state ? "OPEN" : "CLOSE");
-            }
-        }
+void ProcessCanMessage(uint32_t can_id, uint8_t *data, uint8_t data_len) {
+    // Table-driven decode, see signal_db.h. Without a filter match index the
+    // signals are looked up by ID.
+    PERF_START(CAN_DECODE);
+    uint8_t entry;
+    SignalMask signals = CAN_Filter_SignalsFor(CAN_FILTER_NO_FMI, can_id, &entry);
+    if (signals != 0 && !CAN_Filter_IsRepeat(entry, data, data_len)) {
+        SignalDb_Decode(signals, data, data_len);
+    } else if (signals == 0) {
+        IsoTp_Receive(can_id, data, data_len);
     }
+    PERF_COUNT(FRAMES_DECODED, 1);
+    PERF_STOP(CAN_DECODE);
 }
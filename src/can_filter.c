@@ -0,0 +1,311 @@
+#include "can_filter.h"
+#include "can.h"
+#include "config.h"
+#include "perf.h"
+#include "isotp.h"
+#include <string.h>
+
+#ifndef USE_QEMU
+// Per bank set: programmed IDs (sorted) and the signals each one carries
+static uint16_t set_ids[2][CAN_FILTER_MAX_IDS];
+static SignalMask set_signals[2][CAN_FILTER_MAX_IDS];
+static uint64_t set_fields[2][CAN_FILTER_MAX_IDS]; // SignalDb_FieldMask() of set_signals
+static uint8_t set_count[2];
+static uint8_t active_set = 1; // Set B, so the first Apply() programs set A
+static bool programmed = false;
+
+// Bank 12 (FIFO1): same layout, also read by the FIFO1 interrupt
+static uint16_t fifo1_ids[CAN_FILTER_IDS_PER_BANK];
+static SignalMask fifo1_signals[CAN_FILTER_IDS_PER_BANK];
+static uint64_t fifo1_fields[CAN_FILTER_IDS_PER_BANK];
+static uint8_t fifo1_count;
+
+// Last payload per entry (entry = set * CAN_FILTER_MAX_IDS + index, or
+// CAN_FILTER_FIFO1_FMI + index), only the bits its signals read. cache_dlc
+// holds DLC + 1, 0 = nothing cached yet.
+#define CAN_FILTER_ENTRIES (CAN_FILTER_FIFO1_FMI + CAN_FILTER_IDS_PER_BANK)
+static uint64_t cache_data[CAN_FILTER_ENTRIES];
+static uint8_t cache_dlc[CAN_FILTER_ENTRIES];
+
+// FMI -> index into set_ids/set_signals. Both sets sit in FIFO0 in 16-bit
+// list mode, so filter numbers are fixed: set A owns FMI 0..23, set B 24..47.
+#define CAN_FILTER_NO_INDEX 0xFF
+static uint8_t fmi_index[2 * CAN_FILTER_MAX_IDS];
+
+// Add an ID to the sorted list (once), or more signals to an ID already in it
+static uint8_t CAN_Filter_Insert(uint16_t *ids, SignalMask *signals, uint8_t count,
+                                 uint16_t id, SignalMask mask) {
+    uint8_t pos = 0;
+
+    while (pos < count && ids[pos] < id) {
+        pos++;
+    }
+    if (pos == count || ids[pos] != id) {
+        if (count >= CAN_FILTER_MAX_IDS) {
+            return count; // Out of filter slots
+        }
+        for (uint8_t j = count; j > pos; j--) {
+            ids[j] = ids[j - 1];
+            signals[j] = signals[j - 1];
+        }
+        ids[pos] = id;
+        signals[pos] = 0;
+        count++;
+    }
+    signals[pos] |= mask;
+    return count;
+}
+
+// Collect the IDs the signal table needs, sorted and without duplicates
+// (illumination and park both come from the dashboard frame by default),
+// together with the mask of signals decoded from each. ISO-TP IDs are
+// added with an empty mask; their frames go to the reassembly instead.
+static uint8_t CAN_Filter_Collect(uint16_t *ids, SignalMask *signals) {
+    uint16_t isotp_ids[CAN_FILTER_MAX_IDS];
+    uint8_t isotp_count = IsoTp_GetIds(isotp_ids, CAN_FILTER_MAX_IDS);
+    uint8_t count = 0;
+
+    for (uint8_t sig = 0; sig < SIG_COUNT; sig++) {
+        uint16_t id = (uint16_t)(SignalDb_GetId((SignalId)sig) & 0x7FF);
+        count = CAN_Filter_Insert(ids, signals, count, id, (SignalMask)1 << sig);
+    }
+    for (uint8_t i = 0; i < isotp_count; i++) {
+        count = CAN_Filter_Insert(ids, signals, count, isotp_ids[i] & 0x7FF, 0);
+    }
+    return count;
+}
+
+// Move the IDs that carry FIFO1 signals (with everything else they carry)
+// out of the list, fast-path ones first; returns the new count
+static uint8_t CAN_Filter_SplitFifo1(uint16_t *ids, SignalMask *signals, uint8_t count,
+                                     uint16_t *fids, SignalMask *fsignals, uint8_t *fcount) {
+    static const SignalMask pass_signals[] = { CAN_FILTER_FAST_SIGNALS, CAN_FILTER_FIFO1_SIGNALS };
+
+    *fcount = 0;
+    for (uint8_t pass = 0; pass < 2; pass++) {
+        uint8_t kept = 0;
+        for (uint8_t i = 0; i < count; i++) {
+            if ((signals[i] & pass_signals[pass]) && *fcount < CAN_FILTER_IDS_PER_BANK) {
+                fids[*fcount] = ids[i];
+                fsignals[(*fcount)++] = signals[i];
+            } else {
+                ids[kept] = ids[i];
+                signals[kept++] = signals[i];
+            }
+        }
+        count = kept;
+    }
+    return count;
+}
+
+// Program one bank with up to four IDs; unused slots repeat the last ID so
+// they cannot match anything else. An empty bank is disabled.
+static bool CAN_Filter_ProgramBank(uint32_t bank, uint32_t fifo, const uint16_t *ids, uint8_t count) {
+    CAN_FilterTypeDef canfilterconfig;
+    uint16_t slot[CAN_FILTER_IDS_PER_BANK];
+
+    for (uint8_t i = 0; i < CAN_FILTER_IDS_PER_BANK; i++) {
+        uint16_t id = (count == 0) ? 0 : ids[(i < count) ? i : count - 1];
+        slot[i] = (uint16_t)(id << 5); // STDID[10:0], RTR = 0, IDE = 0
+    }
+
+    canfilterconfig.FilterActivation = (count > 0) ? CAN_FILTER_ENABLE : CAN_FILTER_DISABLE;
+    canfilterconfig.FilterBank = bank;
+    canfilterconfig.FilterFIFOAssignment = fifo;
+    // The HAL packs FR1 = MaskIdLow:IdLow and FR2 = MaskIdHigh:IdHigh, and
+    // list entries are numbered from the low half of FR1 upwards.
+    canfilterconfig.FilterIdLow = slot[0];      // FMI n
+    canfilterconfig.FilterMaskIdLow = slot[1];  // FMI n + 1
+    canfilterconfig.FilterIdHigh = slot[2];     // FMI n + 2
+    canfilterconfig.FilterMaskIdHigh = slot[3]; // FMI n + 3
+    canfilterconfig.FilterMode = CAN_FILTERMODE_IDLIST;
+    canfilterconfig.FilterScale = CAN_FILTERSCALE_16BIT;
+    canfilterconfig.SlaveStartFilterBank = 14;
+    return HAL_CAN_ConfigFilter(&hcan, &canfilterconfig) == HAL_OK;
+}
+
+// Program a whole set; count == 0 disables it but keeps its FMI lookup.
+static bool CAN_Filter_ProgramSet(uint8_t set, const uint16_t *ids, uint8_t count) {
+    uint32_t first_bank = set * CAN_FILTER_SET_BANKS;
+
+    memset(&cache_dlc[set * CAN_FILTER_MAX_IDS], 0, CAN_FILTER_MAX_IDS);
+
+    for (uint8_t b = 0; b < CAN_FILTER_SET_BANKS; b++) {
+        uint8_t offset = b * CAN_FILTER_IDS_PER_BANK;
+        uint8_t n = (count > offset) ? count - offset : 0;
+
+        if (n > CAN_FILTER_IDS_PER_BANK) {
+            n = CAN_FILTER_IDS_PER_BANK;
+        }
+        if (count > 0) {
+            uint8_t *index = &fmi_index[set * CAN_FILTER_MAX_IDS + offset];
+            memset(index, CAN_FILTER_NO_INDEX, CAN_FILTER_IDS_PER_BANK);
+            for (uint8_t i = 0; i < CAN_FILTER_IDS_PER_BANK && n > 0; i++) {
+                index[i] = offset + ((i < n) ? i : n - 1); // Unused slots repeat the last ID
+            }
+        }
+        if (!CAN_Filter_ProgramBank(first_bank + b, CAN_FILTER_FIFO0, &ids[offset], n)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The interrupt reads the tables, so they change with interrupts masked;
+// a frame still tagged with the old FMI fails the ID check.
+static bool CAN_Filter_ProgramFifo1(const uint16_t *ids, const SignalMask *signals, uint8_t count) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    for (uint8_t i = 0; i < count; i++) {
+        fifo1_ids[i] = ids[i];
+        fifo1_signals[i] = signals[i];
+        fifo1_fields[i] = SignalDb_FieldMask(signals[i]);
+    }
+    fifo1_count = count;
+    memset(&cache_dlc[CAN_FILTER_FIFO1_FMI], 0, CAN_FILTER_IDS_PER_BANK);
+    __set_PRIMASK(primask);
+    return CAN_Filter_ProgramBank(CAN_FILTER_FIFO1_BANK, CAN_FILTER_FIFO1, ids, count);
+}
+
+bool CAN_Filter_Apply(void) {
+    uint8_t next_set = active_set ^ 1;
+    uint16_t *ids = set_ids[next_set];
+    SignalMask *signals = set_signals[next_set];
+    uint16_t fids[CAN_FILTER_IDS_PER_BANK];
+    SignalMask fsignals[CAN_FILTER_IDS_PER_BANK];
+    uint8_t fcount;
+    uint8_t count = CAN_Filter_SplitFifo1(ids, signals, CAN_Filter_Collect(ids, signals), fids, fsignals, &fcount);
+
+    bool set_changed = !programmed || count != set_count[active_set] ||
+                       memcmp(ids, set_ids[active_set], count * sizeof(uint16_t)) != 0 ||
+                       memcmp(signals, set_signals[active_set], count * sizeof(SignalMask)) != 0;
+    bool fifo1_changed = !programmed || fcount != fifo1_count ||
+                        memcmp(fids, fifo1_ids, fcount * sizeof(uint16_t)) != 0 ||
+                        memcmp(fsignals, fifo1_signals, fcount * sizeof(SignalMask)) != 0;
+    if (!set_changed && !fifo1_changed) {
+        return true; // Nothing changed
+    }
+
+    // Enable the new set first, then retire the old one: in between both
+    // are active, so no wanted ID is ever unfiltered. The old set's lookup
+    // data stays valid for frames it already accepted. Bank 12 moves in
+    // between, while the old set still covers what it used to list.
+    if (!programmed) {
+        memset(fmi_index, CAN_FILTER_NO_INDEX, sizeof(fmi_index)); // Not entry 0 of a set never programmed
+    }
+    if (set_changed) {
+        set_count[next_set] = count;
+        for (uint8_t i = 0; i < count; i++) {
+            set_fields[next_set][i] = SignalDb_FieldMask(signals[i]);
+        }
+        if (!CAN_Filter_ProgramSet(next_set, ids, count)) {
+            return false;
+        }
+    }
+    if (fifo1_changed && !CAN_Filter_ProgramFifo1(fids, fsignals, fcount)) {
+        return false;
+    }
+    if (set_changed) {
+        if (programmed && !CAN_Filter_ProgramSet(active_set, set_ids[active_set], 0)) {
+            return false;
+        }
+        active_set = next_set;
+    }
+    programmed = true;
+    return true;
+}
+
+SignalMask CAN_Filter_Fifo1SignalsFor(uint32_t fmi, uint32_t id) {
+    uint32_t i = fmi - CAN_FILTER_FIFO1_FMI;
+    if (i < fifo1_count && fifo1_ids[i] == id) {
+        return fifo1_signals[i];
+    }
+    return 0;
+}
+
+SignalMask CAN_Filter_SignalsFor(uint32_t fmi, uint32_t id, uint8_t *entry) {
+    // Constant time: the filter match index points straight at the entry
+    SignalMask fifo1 = CAN_Filter_Fifo1SignalsFor(fmi, id);
+    if (fifo1 != 0) {
+        *entry = (uint8_t)fmi;
+        return fifo1;
+    }
+    if (fmi < sizeof(fmi_index)) {
+        uint8_t set = (uint8_t)(fmi / CAN_FILTER_MAX_IDS);
+        uint8_t index = fmi_index[fmi];
+        if (index != CAN_FILTER_NO_INDEX && set_ids[set][index] == id) {
+            *entry = (uint8_t)(set * CAN_FILTER_MAX_IDS + index);
+            return set_signals[set][index];
+        }
+    }
+
+    // No (or stale) FMI: search the active set
+    for (uint8_t i = 0; i < set_count[active_set]; i++) {
+        if (set_ids[active_set][i] == id) {
+            *entry = (uint8_t)(active_set * CAN_FILTER_MAX_IDS + i);
+            return set_signals[active_set][i];
+        }
+    }
+    for (uint8_t i = 0; i < fifo1_count; i++) {
+        if (fifo1_ids[i] == id) {
+            *entry = (uint8_t)(CAN_FILTER_FIFO1_FMI + i);
+            return fifo1_signals[i];
+        }
+    }
+    *entry = CAN_FILTER_NO_ENTRY;
+    return 0;
+}
+
+bool CAN_Filter_IsRepeat(uint8_t entry, const uint8_t *data, uint8_t dlc) {
+    if (entry >= CAN_FILTER_ENTRIES || dlc > 8) {
+        return false;
+    }
+    bool fifo1 = entry >= CAN_FILTER_FIFO1_FMI;
+    uint8_t set = entry / CAN_FILTER_MAX_IDS;
+    uint8_t index = entry % CAN_FILTER_MAX_IDS;
+    SignalMask signals = fifo1 ? fifo1_signals[index] : set_signals[set][index];
+    if (signals & SIGNAL_EVERY_FRAME_MASK) {
+        return false;
+    }
+
+    // Bytes past the DLC are not part of the frame; the DLC compare below
+    // covers them (a field that no longer fits is not decoded at all)
+    uint64_t payload;
+    memcpy(&payload, data, sizeof(payload));
+    if (dlc < 8) {
+        payload &= ((uint64_t)1 << (dlc * 8U)) - 1U; // Little-endian: keep the first dlc bytes
+    }
+    payload &= fifo1 ? fifo1_fields[index] : set_fields[set][index];
+    if (cache_dlc[entry] == dlc + 1U && cache_data[entry] == payload) {
+        PERF_COUNT(CACHE_HITS, 1);
+        return true;
+    }
+    cache_dlc[entry] = (uint8_t)(dlc + 1U);
+    cache_data[entry] = payload;
+    PERF_COUNT(CACHE_MISSES, 1);
+    return false;
+}
+
+uint8_t CAN_Filter_GetIds(const uint16_t **ids) {
+    *ids = set_ids[active_set];
+    return set_count[active_set];
+}
+
+bool CAN_Filter_SetSniffer(bool open) {
+    CAN_FilterTypeDef canfilterconfig;
+
+    // Two 16-bit mask filters with all-zero masks: any ID, standard or
+    // extended, data or remote
+    canfilterconfig.FilterActivation = open ? CAN_FILTER_ENABLE : CAN_FILTER_DISABLE;
+    canfilterconfig.FilterBank = CAN_FILTER_SNIFFER_BANK;
+    canfilterconfig.FilterFIFOAssignment = CAN_FILTER_FIFO0;
+    canfilterconfig.FilterIdLow = 0;
+    canfilterconfig.FilterMaskIdLow = 0;
+    canfilterconfig.FilterIdHigh = 0;
+    canfilterconfig.FilterMaskIdHigh = 0;
+    canfilterconfig.FilterMode = CAN_FILTERMODE_IDMASK;
+    canfilterconfig.FilterScale = CAN_FILTERSCALE_16BIT;
+    canfilterconfig.SlaveStartFilterBank = 14;
+    return HAL_CAN_ConfigFilter(&hcan, &canfilterconfig) == HAL_OK;
+}
+#endif // USE_QEMU
@@ -0,0 +1,252 @@
+#include "can_health.h"
+#include "can.h" // For hcan
+#include "scheduler.h" // For Sched_Post
+#include "uart.h" // For SendToAndroid
+#include <stdio.h>
+#include <string.h>
+
+#ifndef USE_QEMU
+static const char *const health_counter_tags[] = {
+#define CAN_HEALTH_COUNTER_TAG(name, tag) tag,
+    CAN_HEALTH_COUNTERS(CAN_HEALTH_COUNTER_TAG)
+#undef CAN_HEALTH_COUNTER_TAG
+};
+
+static const char *const health_state_names[] = { "ACTIVE", "WARN", "PASSIVE", "OFF" };
+
+static CanHealthStats health_stats;
+static volatile uint32_t health_bits[2];   // Bus bits seen since the last sample (estimate), per RX FIFO
+static volatile bool health_bus_off;       // Set by the interrupt, cleared by a restart
+static CanBusState health_state = CAN_BUS_ACTIVE;
+static bool health_recovering;             // Restarted, bus-off not yet cleared
+static uint32_t health_sample_tick;
+static uint32_t health_off_tick;           // When the bus went off, or the last restart attempt
+static uint32_t health_up_tick;            // When the bus came back
+static uint32_t health_backoff_ms = CAN_HEALTH_BACKOFF_MIN_MS;
+
+void CAN_Health_Started(bool started) {
+    health_sample_tick = HAL_GetTick();
+    if (!started) {
+        health_bus_off = true; // Retried like a bus-off instead of halting at boot
+        health_off_tick = health_sample_tick;
+    }
+}
+
+// Status change interrupt: flags are reported when they become set, the
+// last error code on every error (CAN_IT_LAST_ERROR_CODE).
+void CAN_Health_OnError(uint32_t error_code) {
+    if (error_code & HAL_CAN_ERROR_EWG) {
+        health_stats.warnings++;
+    }
+    if (error_code & HAL_CAN_ERROR_EPV) {
+        health_stats.passives++;
+    }
+    if (error_code & HAL_CAN_ERROR_BOF) {
+        health_stats.bus_offs++;
+        health_bus_off = true;
+        health_off_tick = HAL_GetTick();
+        Sched_Post(EVT_CAN_HEALTH); // Report it now, recover after the back-off
+    }
+    if (error_code & HAL_CAN_ERROR_STF) {
+        health_stats.stuff++;
+    }
+    if (error_code & HAL_CAN_ERROR_FOR) {
+        health_stats.form++;
+    }
+    if (error_code & HAL_CAN_ERROR_ACK) {
+        health_stats.ack++;
+    }
+    if (error_code & HAL_CAN_ERROR_BR) {
+        health_stats.bit_rec++;
+    }
+    if (error_code & HAL_CAN_ERROR_BD) {
+        health_stats.bit_dom++;
+    }
+    if (error_code & HAL_CAN_ERROR_CRC) {
+        health_stats.crc++;
+    }
+    if (error_code & HAL_CAN_ERROR_RX_FOV0) {
+        health_stats.overruns++;
+    }
+    if (error_code & HAL_CAN_ERROR_RX_FOV1) {
+        health_stats.overruns1++;
+    }
+}
+
+void CAN_Health_OnFifoFull(uint32_t fifo) {
+    if (fifo == CAN_RX_FIFO0) {
+        health_stats.fulls++;
+    } else {
+        health_stats.fulls1++;
+    }
+}
+
+// Standard data frame: 47 bits of framing and 8 per data byte, plus about
+// one stuff bit in eight over the 34 + 8 * dlc bits that are stuffed.
+// Each FIFO's interrupt only adds to its own count
+void CAN_Health_OnFrame(uint32_t fifo, uint8_t dlc) {
+    uint32_t stuffed = 34U + 8U * dlc;
+    health_bits[fifo] += 13U + stuffed + stuffed / 8U;
+}
+
+static void CAN_Health_SetState(CanBusState state) {
+    if (state != health_state) {
+        health_state = state;
+        char line[24];
+        snprintf(line, sizeof(line), "STATE,%s", health_state_names[state]);
+        SendToAndroid(RESP_BUS, line);
+    }
+}
+
+// Leaving and re-entering normal mode is the software bus-off recovery when
+// AutoBusOff is disabled. A start that timed out leaves the handle in the
+// error state, which the HAL would refuse to start again.
+static bool CAN_Health_Restart(void) {
+    if (hcan.State == HAL_CAN_STATE_LISTENING) {
+        (void)HAL_CAN_Stop(&hcan);
+    } else if (hcan.State == HAL_CAN_STATE_ERROR) {
+        hcan.State = HAL_CAN_STATE_READY;
+        HAL_CAN_ResetError(&hcan); // The start timeout
+    }
+    return HAL_CAN_Start(&hcan) == HAL_OK;
+}
+
+void CAN_Health_Service(void) {
+    uint32_t now = HAL_GetTick();
+    uint32_t esr = hcan.Instance->ESR;
+    uint32_t tec = (esr & CAN_ESR_TEC) >> CAN_ESR_TEC_Pos;
+    uint32_t rec = (esr & CAN_ESR_REC) >> CAN_ESR_REC_Pos;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t bits = health_bits[CAN_RX_FIFO0] + health_bits[CAN_RX_FIFO1];
+    health_bits[CAN_RX_FIFO0] = 0;
+    health_bits[CAN_RX_FIFO1] = 0;
+    if (tec > health_stats.tec_max) {
+        health_stats.tec_max = tec;
+    }
+    if (rec > health_stats.rec_max) {
+        health_stats.rec_max = rec;
+    }
+    __set_PRIMASK(primask);
+
+    uint32_t elapsed = now - health_sample_tick;
+    if (elapsed != 0) {
+        uint32_t load = bits * 1000U / (CAN_HEALTH_BITRATE / 1000U * elapsed);
+        health_stats.load = load > 1000U ? 1000U : load;
+        health_sample_tick = now;
+    }
+
+    if (health_bus_off) {
+        CAN_Health_SetState(CAN_BUS_OFF);
+        if (now - health_off_tick < health_backoff_ms) {
+            return;
+        }
+        health_off_tick = now;
+        if (health_backoff_ms < CAN_HEALTH_BACKOFF_MAX_MS) {
+            health_backoff_ms *= 2U; // For the next bus-off in a row, or a failed restart
+            if (health_backoff_ms > CAN_HEALTH_BACKOFF_MAX_MS) {
+                health_backoff_ms = CAN_HEALTH_BACKOFF_MAX_MS;
+            }
+        }
+        if (CAN_Health_Restart()) {
+            health_bus_off = false;
+            health_recovering = true;
+        }
+        return;
+    }
+    if (esr & CAN_ESR_BOFF) {
+        return; // Restarted: the cell waits for 128 x 11 recessive bits
+    }
+    if (health_recovering) {
+        health_recovering = false;
+        health_up_tick = now;
+        health_stats.recoveries++;
+    }
+
+    if (esr & CAN_ESR_EPVF) {
+        CAN_Health_SetState(CAN_BUS_PASSIVE);
+    } else if (esr & CAN_ESR_EWGF) {
+        CAN_Health_SetState(CAN_BUS_WARNING);
+    } else {
+        CAN_Health_SetState(CAN_BUS_ACTIVE);
+    }
+    if (health_backoff_ms != CAN_HEALTH_BACKOFF_MIN_MS && now - health_up_tick >= CAN_HEALTH_STABLE_MS) {
+        health_backoff_ms = CAN_HEALTH_BACKOFF_MIN_MS;
+    }
+}
+
+CanBusState CAN_Health_GetState(void) {
+    return health_state;
+}
+
+void CAN_Health_GetStats(CanHealthStats *stats) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *stats = health_stats;
+    __set_PRIMASK(primask);
+}
+
+static void CAN_Health_SendCounters(void) {
+    CanHealthStats stats;
+    const uint32_t *counters = (const uint32_t *)&stats;
+    char line[32];
+
+    CAN_Health_GetStats(&stats);
+    snprintf(line, sizeof(line), "STATE,%s", health_state_names[health_state]);
+    SendToAndroid(RESP_BUS, line);
+    for (uint8_t i = 0; i < sizeof(health_counter_tags) / sizeof(health_counter_tags[0]); i++) {
+        snprintf(line, sizeof(line), "%s,%lu", health_counter_tags[i], (unsigned long)counters[i]);
+        SendToAndroid(RESP_BUS, line);
+    }
+    SendToAndroid(RESP_BUS, "END");
+}
+
+void CAN_Health_Command(const char *value) {
+    if (value[0] == '\0' || strcmp(value, "GET") == 0) {
+        CAN_Health_SendCounters();
+    } else if (strcmp(value, "RST") == 0) {
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        memset(&health_stats, 0, sizeof(health_stats));
+        __set_PRIMASK(primask);
+        SendToAndroid(RESP_OK, CMD_BUS);
+    } else {
+        SendToAndroid(RESP_ERR, ERR_INVALID_COMMAND);
+    }
+}
+#else
+// No bxCAN in the QEMU build: SocketCAN handles the bus errors
+void CAN_Health_Started(bool started) {
+    (void)started;
+}
+
+void CAN_Health_OnError(uint32_t error_code) {
+    (void)error_code;
+}
+
+void CAN_Health_OnFifoFull(uint32_t fifo) {
+    (void)fifo;
+}
+
+void CAN_Health_OnFrame(uint32_t fifo, uint8_t dlc) {
+    (void)fifo;
+    (void)dlc;
+}
+
+void CAN_Health_Service(void) {
+}
+
+void CAN_Health_Command(const char *value) {
+    (void)value;
+    SendToAndroid(RESP_ERR, ERR_INVALID_COMMAND);
+}
+
+CanBusState CAN_Health_GetState(void) {
+    return CAN_BUS_ACTIVE;
+}
+
+void CAN_Health_GetStats(CanHealthStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+}
+#endif // USE_QEMU
@@ -0,0 +1,264 @@
+#include "can_periodic.h"
+#include "can_tx.h" // For CAN_TxQueue_Push, CAN_TxQueue_IsPending
+#include "signal_db.h" // For SignalDb_GetState
+#include "scheduler.h" // For Sched_Micros
+#include "uart.h" // For SendToAndroid
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef USE_QEMU
+typedef struct {
+    bool used;
+    bool cond_off;      // Release while the condition signal is off
+    uint8_t cond;       // SignalId, or CAN_PERIODIC_ALWAYS
+    uint8_t dlc;
+    uint16_t id;
+    uint16_t period_ms;
+    uint16_t phase_ms;  // < period_ms
+    uint8_t data[8];
+} CanPeriodicSlot;
+
+static const char *const periodic_signal_names[SIG_COUNT] = {
+#define PERIODIC_SIGNAL_NAME(name, id, byte, bit, len, kind, scale, min, max, hyst, resp, on, off) #name,
+    SIGNAL_TABLE(PERIODIC_SIGNAL_NAME)
+#undef PERIODIC_SIGNAL_NAME
+};
+
+static const SignalKind periodic_signal_kinds[SIG_COUNT] = {
+#define PERIODIC_SIGNAL_KIND(name, id, byte, bit, len, kind, scale, min, max, hyst, resp, on, off) kind,
+    SIGNAL_TABLE(PERIODIC_SIGNAL_KIND)
+#undef PERIODIC_SIGNAL_KIND
+};
+
+TIM_HandleTypeDef htim3;
+
+static CanPeriodicSlot periodic_slots[CAN_PERIODIC_SLOTS];
+static CanPeriodicStats periodic_stats[CAN_PERIODIC_SLOTS];
+static uint32_t periodic_last_us[CAN_PERIODIC_SLOTS];  // Last release
+static bool periodic_timed[CAN_PERIODIC_SLOTS];        // periodic_last_us starts an interval
+static uint32_t periodic_ms;                            // TIM3 update count
+
+void CAN_Periodic_Init(void) {
+    __HAL_RCC_TIM3_CLK_ENABLE();
+
+    // TIM3 runs from the APB1 timer clock: 36 MHz APB1, doubled to 72 MHz
+    htim3.Instance = TIM3;
+    htim3.Init.Prescaler = 7200 - 1;  // 72 MHz / 7200 = 10 kHz
+    htim3.Init.Period = 10 - 1;       // 10 kHz / 10 = 1 kHz update
+    htim3.Init.CounterMode = TIM_COUNTERMODE_UP;
+    htim3.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    htim3.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+    if (HAL_TIM_Base_Init(&htim3) != HAL_OK) {
+        Error_Handler();
+    }
+    HAL_NVIC_SetPriority(TIM3_IRQn, IRQ_PRIO_TIMER, 0);
+    HAL_NVIC_EnableIRQ(TIM3_IRQn);
+    if (HAL_TIM_Base_Start_IT(&htim3) != HAL_OK) {
+        Error_Handler();
+    }
+}
+
+void TIM3_IRQHandler(void) {
+    HAL_TIM_IRQHandler(&htim3);
+}
+
+static void CAN_Periodic_Release(uint8_t i, uint32_t now_us) {
+    const CanPeriodicSlot *slot = &periodic_slots[i];
+    CanPeriodicStats *stats = &periodic_stats[i];
+
+    if (CAN_TxQueue_IsPending(slot->id) || !CAN_TxQueue_Push(slot->id, slot->data, slot->dlc)) {
+        stats->missed++;
+        periodic_timed[i] = false; // The interval across a miss is not jitter
+        return;
+    }
+    stats->sent++;
+    if (periodic_timed[i]) {
+        int32_t deviation = (int32_t)(now_us - periodic_last_us[i] - slot->period_ms * 1000U);
+        uint32_t jitter = (uint32_t)(deviation < 0 ? -deviation : deviation);
+        stats->jitter_sum += jitter;
+        stats->jitter_count++;
+        if (jitter > stats->jitter_max) {
+            stats->jitter_max = jitter;
+        }
+    }
+    periodic_last_us[i] = now_us;
+    periodic_timed[i] = true;
+}
+
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim) {
+    if (htim->Instance != TIM3) {
+        return;
+    }
+    uint32_t ms = periodic_ms++;
+    uint32_t now_us = Sched_Micros();
+    SignalMask state = SignalDb_GetState();
+
+    for (uint8_t i = 0; i < CAN_PERIODIC_SLOTS; i++) {
+        const CanPeriodicSlot *slot = &periodic_slots[i];
+        if (!slot->used || ms % slot->period_ms != slot->phase_ms) {
+            continue;
+        }
+        if (slot->cond != CAN_PERIODIC_ALWAYS && (((state >> slot->cond) & 1U) != 0) == slot->cond_off) {
+            periodic_timed[i] = false; // Released again once the condition holds
+            continue;
+        }
+        CAN_Periodic_Release(i, now_us);
+    }
+}
+
+void CAN_Periodic_GetStats(uint8_t slot, CanPeriodicStats *stats) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *stats = periodic_stats[slot];
+    __set_PRIMASK(primask);
+}
+
+// "-", "<signal>" or "!<signal>"; only SIGNAL_BOOL signals have an on state
+static bool CAN_Periodic_ParseCondition(const char *s, size_t len, CanPeriodicSlot *slot) {
+    slot->cond = CAN_PERIODIC_ALWAYS;
+    slot->cond_off = false;
+    if (len == 1 && s[0] == '-') {
+        return true;
+    }
+    if (len > 1 && s[0] == '!') {
+        slot->cond_off = true;
+        s++;
+        len--;
+    }
+    for (uint8_t sig = 0; sig < SIG_COUNT; sig++) {
+        if (periodic_signal_kinds[sig] == SIGNAL_BOOL && strlen(periodic_signal_names[sig]) == len &&
+            strncmp(periodic_signal_names[sig], s, len) == 0) {
+            slot->cond = sig;
+            return true;
+        }
+    }
+    return false;
+}
+
+// "<slot>,<id>,<period>,<phase>,<cond>,<data>"
+static bool CAN_Periodic_Set(const char *arg) {
+    CanPeriodicSlot slot = { .used = true };
+    char *end;
+
+    unsigned long index = strtoul(arg, &end, 10);
+    if (end == arg || *end != ',' || index >= CAN_PERIODIC_SLOTS) {
+        return false;
+    }
+    const char *p = end + 1;
+    unsigned long id = strtoul(p, &end, 16);
+    if (end == p || *end != ',' || id > 0x7FF) {
+        return false;
+    }
+    p = end + 1;
+    unsigned long period = strtoul(p, &end, 10);
+    if (end == p || *end != ',' || period == 0 || period > CAN_PERIODIC_MAX_MS) {
+        return false;
+    }
+    p = end + 1;
+    unsigned long phase = strtoul(p, &end, 10);
+    if (end == p || *end != ',' || phase >= period) {
+        return false;
+    }
+    p = end + 1;
+    const char *comma = strchr(p, ',');
+    if (comma == NULL || !CAN_Periodic_ParseCondition(p, (size_t)(comma - p), &slot)) {
+        return false;
+    }
+    p = comma + 1;
+    size_t hex = strlen(p);
+    if (hex % 2U != 0 || hex > 16U) {
+        return false;
+    }
+    for (size_t i = 0; i < hex; i += 2) {
+        char byte[3] = { p[i], p[i + 1], '\0' };
+        slot.data[i / 2U] = (uint8_t)strtoul(byte, &end, 16);
+        if (end != &byte[2]) {
+            return false;
+        }
+    }
+    slot.id = (uint16_t)id;
+    slot.dlc = (uint8_t)(hex / 2U);
+    slot.period_ms = (uint16_t)period;
+    slot.phase_ms = (uint16_t)phase;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    periodic_slots[index] = slot;
+    memset(&periodic_stats[index], 0, sizeof(periodic_stats[index]));
+    periodic_timed[index] = false;
+    __set_PRIMASK(primask);
+    return true;
+}
+
+static bool CAN_Periodic_Delete(const char *arg) {
+    char *end;
+    unsigned long index = strtoul(arg, &end, 10);
+    if (end == arg || *end != '\0' || index >= CAN_PERIODIC_SLOTS) {
+        return false;
+    }
+    periodic_slots[index].used = false; // A single store: the ISR sees the slot or not
+    return true;
+}
+
+static void CAN_Periodic_SendSlots(void) {
+    char line[96];
+
+    for (uint8_t i = 0; i < CAN_PERIODIC_SLOTS; i++) {
+        const CanPeriodicSlot *slot = &periodic_slots[i];
+        if (!slot->used) {
+            continue;
+        }
+        CanPeriodicStats stats;
+        CAN_Periodic_GetStats(i, &stats);
+        const char *cond = slot->cond == CAN_PERIODIC_ALWAYS ? "-" : periodic_signal_names[slot->cond];
+        int pos = snprintf(line, sizeof(line), "%u,%03X,%u,%u,%s%s,", i, slot->id, slot->period_ms,
+                           slot->phase_ms, slot->cond_off ? "!" : "", cond);
+        for (uint8_t b = 0; b < slot->dlc; b++) {
+            pos += snprintf(&line[pos], sizeof(line) - (size_t)pos, "%02X", slot->data[b]);
+        }
+        snprintf(&line[pos], sizeof(line) - (size_t)pos, ",%lu,%lu,%lu,%lu", (unsigned long)stats.sent,
+                 (unsigned long)stats.missed,
+                 (unsigned long)(stats.jitter_count ? stats.jitter_sum / stats.jitter_count : 0),
+                 (unsigned long)stats.jitter_max);
+        SendToAndroid(RESP_PTX, line);
+    }
+    SendToAndroid(RESP_PTX, "END");
+}
+
+void CAN_Periodic_Command(const char *value) {
+    bool ok;
+
+    if (value[0] == '\0' || strcmp(value, "GET") == 0) {
+        CAN_Periodic_SendSlots();
+        return;
+    } else if (strncmp(value, "SET:", 4) == 0) {
+        ok = CAN_Periodic_Set(value + 4);
+    } else if (strncmp(value, "DEL:", 4) == 0) {
+        ok = CAN_Periodic_Delete(value + 4);
+    } else if (strcmp(value, "RST") == 0) {
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        memset(periodic_stats, 0, sizeof(periodic_stats));
+        __set_PRIMASK(primask);
+        ok = true;
+    } else {
+        ok = false;
+    }
+    SendToAndroid(ok ? RESP_OK : RESP_ERR, ok ? CMD_PTX : ERR_INVALID_COMMAND);
+}
+#else
+// No TIM3 in the QEMU build
+void CAN_Periodic_Init(void) {
+}
+
+void CAN_Periodic_Command(const char *value) {
+    (void)value;
+    SendToAndroid(RESP_ERR, ERR_INVALID_COMMAND);
+}
+
+void CAN_Periodic_GetStats(uint8_t slot, CanPeriodicStats *stats) {
+    (void)slot;
+    memset(stats, 0, sizeof(*stats));
+}
+#endif // USE_QEMU
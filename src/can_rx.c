@@ -0,0 +1,81 @@
+#include "can_rx.h"
+#include <string.h>
+
+#if (CAN_RX_RING_SIZE & (CAN_RX_RING_SIZE - 1)) != 0
+#error "CAN_RX_RING_SIZE must be a power of two"
+#endif
+#if (CAN_RX_FIFO1_RING_SIZE & (CAN_RX_FIFO1_RING_SIZE - 1)) != 0
+#error "CAN_RX_FIFO1_RING_SIZE must be a power of two"
+#endif
+
+// Free-running indices: head is only written by the producer, tail only by the
+// consumer. Their difference is the fill level, wrap-around is harmless.
+typedef struct {
+    CanRxFrame *frames;
+    uint32_t size;
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    volatile CanRxRingStats stats;
+} CanRxRing;
+
+static CanRxFrame rx_frames0[CAN_RX_RING_SIZE];
+static CanRxFrame rx_frames1[CAN_RX_FIFO1_RING_SIZE];
+static CanRxRing rx_rings[CAN_RX_RING_COUNT] = {
+    [CAN_RX_RING_FIFO0] = { .frames = rx_frames0, .size = CAN_RX_RING_SIZE },
+    [CAN_RX_RING_FIFO1] = { .frames = rx_frames1, .size = CAN_RX_FIFO1_RING_SIZE },
+};
+
+bool CAN_RxRing_Push(CanRxRingId ring, const CanRxFrame *frame) {
+    CanRxRing *r = &rx_rings[ring];
+    uint32_t head = r->head;
+    uint32_t used = head - r->tail;
+
+    if (used >= r->size) {
+        r->stats.overflows++;
+        return false;
+    }
+
+    memcpy(&r->frames[head & (r->size - 1)], frame, sizeof(CanRxFrame));
+    __DMB(); // Slot contents must be visible before the new head
+    r->head = head + 1;
+
+    r->stats.pushed++;
+    if (used + 1 > r->stats.high_water) {
+        r->stats.high_water = used + 1;
+    }
+    return true;
+}
+
+static bool CAN_RxRing_PopFrom(CanRxRing *r, CanRxFrame *frame) {
+    uint32_t tail = r->tail;
+
+    if (tail == r->head) {
+        return false; // Empty
+    }
+    __DMB(); // Read the slot only after observing the head that published it
+
+    memcpy(frame, &r->frames[tail & (r->size - 1)], sizeof(CanRxFrame));
+    __DMB(); // Finish reading before handing the slot back to the producer
+    r->tail = tail + 1;
+    return true;
+}
+
+bool CAN_RxRing_Pop(CanRxFrame *frame) {
+    return CAN_RxRing_PopFrom(&rx_rings[CAN_RX_RING_FIFO1], frame) ||
+           CAN_RxRing_PopFrom(&rx_rings[CAN_RX_RING_FIFO0], frame);
+}
+
+void CAN_RxRing_GetStats(CanRxRingId ring, CanRxRingStats *stats) {
+    const CanRxRing *r = &rx_rings[ring];
+    stats->pushed = r->stats.pushed;
+    stats->overflows = r->stats.overflows;
+    stats->high_water = r->stats.high_water;
+}
+
+void CAN_RxRing_ResetStats(void) {
+    for (uint8_t i = 0; i < CAN_RX_RING_COUNT; i++) {
+        rx_rings[i].stats.pushed = 0;
+        rx_rings[i].stats.overflows = 0;
+        rx_rings[i].stats.high_water = 0;
+    }
+}
@@ -0,0 +1,298 @@
+#include "can_tx.h"
+#include "can.h"
+#include "uart.h" // For SendToAndroid
+#include <stdio.h>
+#include <string.h>
+
+#ifndef USE_QEMU
+typedef struct {
+    uint32_t id;
+    uint32_t stamp;    // HAL_GetTick() when queued
+    uint8_t dlc;
+    uint8_t attempts;  // Failed transmit attempts so far
+    uint8_t data[8];
+} CanTxEntry;
+
+// Sorted by ID, index 0 is sent first. Equal IDs keep their age order.
+static CanTxEntry tx_queue[CAN_TX_QUEUE_SIZE];
+static uint8_t tx_count = 0;
+
+// Frame currently owned by each hardware mailbox
+static CanTxEntry tx_mailbox[3];
+static bool tx_mailbox_busy[3];
+static uint32_t tx_mailbox_stamp[3]; // HAL_GetTick() when handed to the mailbox
+
+static CanTxIdStats tx_stats[CAN_TX_STATS_SLOTS];
+static uint8_t tx_stats_count = 0;
+static CanTxIdStats tx_stats_other; // IDs beyond CAN_TX_STATS_SLOTS
+
+static CanTxIdStats *CAN_TxStatsFor(uint32_t id) {
+    for (uint8_t i = 0; i < tx_stats_count; i++) {
+        if (tx_stats[i].id == id) {
+            return &tx_stats[i];
+        }
+    }
+    if (tx_stats_count < CAN_TX_STATS_SLOTS) {
+        tx_stats[tx_stats_count].id = id;
+        return &tx_stats[tx_stats_count++];
+    }
+    return &tx_stats_other;
+}
+
+// Insert keeping the queue sorted. New frames go after queued ones with the
+// same ID; a frame put back (ahead) goes before them, so an older payload
+// never follows a newer one. Must be called with interrupts masked.
+static bool CAN_TxInsert(const CanTxEntry *entry, bool ahead) {
+    if (tx_count >= CAN_TX_QUEUE_SIZE) {
+        return false;
+    }
+    uint8_t pos = tx_count;
+    while (pos > 0 && (tx_queue[pos - 1].id > entry->id || (ahead && tx_queue[pos - 1].id == entry->id))) {
+        tx_queue[pos] = tx_queue[pos - 1];
+        pos--;
+    }
+    tx_queue[pos] = *entry;
+    tx_count++;
+    return true;
+}
+
+static void CAN_TxRemove(uint8_t index) {
+    tx_count--;
+    memmove(&tx_queue[index], &tx_queue[index + 1], (tx_count - index) * sizeof(CanTxEntry));
+}
+
+// Move queued frames into free mailboxes. Must be called with interrupts masked.
+static void CAN_TxFill(void) {
+    uint32_t now = HAL_GetTick();
+
+    while (tx_count > 0 && HAL_CAN_GetTxMailboxesFreeLevel(&hcan) > 0) {
+        CanTxEntry entry = tx_queue[0];
+        CAN_TxRemove(0);
+
+        if (now - entry.stamp > CAN_TX_MAX_AGE_MS) {
+            CAN_TxStatsFor(entry.id)->expired++;
+            continue;
+        }
+
+        CAN_TxHeaderTypeDef TxHeader;
+        uint32_t TxMailbox;
+        TxHeader.StdId = entry.id;
+        TxHeader.ExtId = 0;
+        TxHeader.RTR = CAN_RTR_DATA;
+        TxHeader.IDE = CAN_ID_STD;
+        TxHeader.DLC = entry.dlc;
+        TxHeader.TransmitGlobalTime = DISABLE;
+
+        if (HAL_CAN_AddTxMessage(&hcan, &TxHeader, entry.data, &TxMailbox) != HAL_OK) {
+            CAN_TxInsert(&entry, true); // Put it back, retried on the next mailbox event
+            return;
+        }
+
+        uint8_t mb = (TxMailbox == CAN_TX_MAILBOX0) ? 0 : (TxMailbox == CAN_TX_MAILBOX1) ? 1 : 2;
+        tx_mailbox[mb] = entry;
+        tx_mailbox_busy[mb] = true;
+        tx_mailbox_stamp[mb] = now;
+    }
+}
+
+// A mailbox attempt failed: retry the frame or give up on it.
+static void CAN_TxRetry(uint8_t mb, bool count_attempt) {
+    if (!tx_mailbox_busy[mb]) {
+        return;
+    }
+    tx_mailbox_busy[mb] = false;
+
+    CanTxEntry *entry = &tx_mailbox[mb];
+    if (count_attempt) {
+        entry->attempts++;
+    }
+    if (entry->attempts >= CAN_TX_MAX_ATTEMPTS || !CAN_TxInsert(entry, true)) {
+        CAN_TxStatsFor(entry->id)->aborted++;
+    }
+}
+
+static void CAN_TxComplete(uint8_t mb) {
+    if (tx_mailbox_busy[mb]) {
+        tx_mailbox_busy[mb] = false;
+        CAN_TxStatsFor(tx_mailbox[mb].id)->sent++;
+    }
+    CAN_TxFill();
+}
+
+static void CAN_TxAborted(uint8_t mb) {
+    if (tx_mailbox_busy[mb]) {
+        tx_mailbox_busy[mb] = false;
+        CAN_TxStatsFor(tx_mailbox[mb].id)->aborted++;
+    }
+    CAN_TxFill();
+}
+
+void HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef *hcan) {
+    (void)hcan;
+    CAN_TxComplete(0);
+}
+
+void HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef *hcan) {
+    (void)hcan;
+    CAN_TxComplete(1);
+}
+
+void HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef *hcan) {
+    (void)hcan;
+    CAN_TxComplete(2);
+}
+
+void HAL_CAN_TxMailbox0AbortCallback(CAN_HandleTypeDef *hcan) {
+    (void)hcan;
+    CAN_TxAborted(0);
+}
+
+void HAL_CAN_TxMailbox1AbortCallback(CAN_HandleTypeDef *hcan) {
+    (void)hcan;
+    CAN_TxAborted(1);
+}
+
+void HAL_CAN_TxMailbox2AbortCallback(CAN_HandleTypeDef *hcan) {
+    (void)hcan;
+    CAN_TxAborted(2);
+}
+
+void CAN_TxQueue_OnError(uint32_t error_code) {
+    static const uint32_t alst[3] = { HAL_CAN_ERROR_TX_ALST0, HAL_CAN_ERROR_TX_ALST1, HAL_CAN_ERROR_TX_ALST2 };
+    static const uint32_t terr[3] = { HAL_CAN_ERROR_TX_TERR0, HAL_CAN_ERROR_TX_TERR1, HAL_CAN_ERROR_TX_TERR2 };
+
+    for (uint8_t mb = 0; mb < 3; mb++) {
+        if (error_code & terr[mb]) {
+            CAN_TxRetry(mb, true);
+        } else if (error_code & alst[mb]) {
+            CAN_TxRetry(mb, false); // Lost arbitration: not the frame's fault
+        }
+    }
+    CAN_TxFill();
+}
+
+bool CAN_TxQueue_Push(uint32_t id, const uint8_t *data, uint8_t len) {
+    CanTxEntry entry;
+    bool queued;
+
+    if (len > 8) len = 8;
+    entry.id = id;
+    entry.dlc = len;
+    entry.attempts = 0;
+    entry.stamp = HAL_GetTick();
+    memcpy(entry.data, data, len);
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    queued = CAN_TxInsert(&entry, false);
+    if (!queued) {
+        CAN_TxStatsFor(id)->rejected++;
+    }
+    CAN_TxFill();
+    __set_PRIMASK(primask);
+    return queued;
+}
+
+void CAN_TxQueue_Service(void) {
+    static const uint32_t mailbox_bits[3] = { CAN_TX_MAILBOX0, CAN_TX_MAILBOX1, CAN_TX_MAILBOX2 };
+    uint32_t now = HAL_GetTick();
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    // Frames that sat in the queue too long (e.g. mailboxes blocked)
+    for (uint8_t i = 0; i < tx_count;) {
+        if (now - tx_queue[i].stamp > CAN_TX_MAX_AGE_MS) {
+            CAN_TxStatsFor(tx_queue[i].id)->expired++;
+            CAN_TxRemove(i);
+        } else {
+            i++;
+        }
+    }
+
+    // Frames stuck in a mailbox (bus busy with higher priority traffic);
+    // the abort callback does the accounting
+    for (uint8_t mb = 0; mb < 3; mb++) {
+        if (tx_mailbox_busy[mb] && now - tx_mailbox_stamp[mb] > CAN_TX_MAX_AGE_MS) {
+            HAL_CAN_AbortTxRequest(&hcan, mailbox_bits[mb]);
+        }
+    }
+
+    CAN_TxFill();
+    __set_PRIMASK(primask);
+}
+
+bool CAN_TxQueue_IsPending(uint32_t id) {
+    bool pending = false;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    for (uint8_t i = 0; i < tx_count && !pending; i++) {
+        pending = tx_queue[i].id == id;
+    }
+    for (uint8_t mb = 0; mb < 3 && !pending; mb++) {
+        pending = tx_mailbox_busy[mb] && tx_mailbox[mb].id == id;
+    }
+    __set_PRIMASK(primask);
+    return pending;
+}
+
+const CanTxIdStats *CAN_TxQueue_GetStats(uint8_t *count) {
+    *count = tx_stats_count;
+    return tx_stats;
+}
+
+static void CAN_TxQueue_SendLine(const char *id, const CanTxIdStats *stats) {
+    char line[64];
+
+    snprintf(line, sizeof(line), "%s,%lu,%lu,%lu,%lu", id, (unsigned long)stats->sent,
+             (unsigned long)stats->aborted, (unsigned long)stats->expired, (unsigned long)stats->rejected);
+    SendToAndroid(RESP_CAN_TX, line);
+}
+
+static void CAN_TxQueue_SendStats(void) {
+    CanTxIdStats stats[CAN_TX_STATS_SLOTS];
+    CanTxIdStats other;
+    uint8_t count;
+
+    // Copied first: the mailbox interrupts update them
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    count = tx_stats_count;
+    memcpy(stats, tx_stats, sizeof(stats));
+    other = tx_stats_other;
+    __set_PRIMASK(primask);
+
+    for (uint8_t i = 0; i < count; i++) {
+        char id[12];
+        snprintf(id, sizeof(id), "%03lX", (unsigned long)stats[i].id);
+        CAN_TxQueue_SendLine(id, &stats[i]);
+    }
+    if (other.sent | other.aborted | other.expired | other.rejected) {
+        CAN_TxQueue_SendLine("OTH", &other);
+    }
+    SendToAndroid(RESP_CAN_TX, "END");
+}
+
+void CAN_TxQueue_Command(const char *value) {
+    if (value[0] == '\0' || strcmp(value, "GET") == 0) {
+        CAN_TxQueue_SendStats();
+    } else if (strcmp(value, "RST") == 0) {
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        memset(tx_stats, 0, sizeof(tx_stats));
+        memset(&tx_stats_other, 0, sizeof(tx_stats_other));
+        tx_stats_count = 0;
+        __set_PRIMASK(primask);
+        SendToAndroid(RESP_OK, CMD_CAN_TX);
+    } else {
+        SendToAndroid(RESP_ERR, ERR_INVALID_COMMAND);
+    }
+}
+#else
+// SocketCAN queues the frames in the QEMU build
+void CAN_TxQueue_Command(const char *value) {
+    (void)value;
+    SendToAndroid(RESP_ERR, ERR_INVALID_COMMAND);
+}
+#endif // USE_QEMU
@@ -1,6 +1,15 @@
 #include "commands.h"
 #include "uart.h" // For SendToAndroid
 #include "config.h" // For configuration
+#include "perf.h" // For !STA
+#include "proto.h" // For !BIN
+#include "sniffer.h" // For !SNF
+#include "can_health.h" // For !BUS
+#include "can_periodic.h" // For !PTX
+#include "boot.h" // For !BOT
+#include "status.h" // For !STS
+#include "isotp.h" // For !ITP
+#include "can_tx.h" // For !CTX
 #include <string.h>
 
 void ProcessAndroidCommand(const char *command, const char *value) {
@@ -14,24 +23,36 @@ void ProcessAndroidCommand(const char *command, const char *value) {
     } else if (strcmp(command, CMD_GET_VER) == 0) {
         send_version();
     } else if (strcmp(command, CMD_CFG) == 0) {
-        char parameter[32] = {0};
-        char val[32] = {0};
-        char *token;
-        char *saveptr;
+        // "GET:<name>", "SET:<name>:<value>,...", "BEGIN": split at the
+        // first ':' only, the rest may hold more fields
+        char parameter[8] = {0};
+        const char *rest = strchr(value, ':');
+        size_t len = rest ? (size_t)(rest - value) : strlen(value);
 
-        token = strtok_r((char *)value, ":", &saveptr);
-        if (token != NULL) {
-            strncpy(parameter, token, sizeof(parameter) - 1);
-            token = strtok_r(NULL, ":", &saveptr);
-            if (token != NULL) {
-                strncpy(val, token, sizeof(val) - 1);
-                ProcessConfigCommand(parameter, val); //Moved to config.c
-            } else {
-                SendToAndroid(RESP_ERR, ERR_INVALID_CONFIG);
-            }
-        } else {
+        if (len == 0 || len >= sizeof(parameter)) {
             SendToAndroid(RESP_ERR, ERR_INVALID_CONFIG);
+        } else {
+            memcpy(parameter, value, len);
+            ProcessConfigCommand(parameter, rest ? rest + 1 : ""); //Moved to config.c
         }
+    } else if (strcmp(command, CMD_STATS) == 0) {
+        Perf_Command(value); // Dump or reset the profiling counters
+    } else if (strcmp(command, CMD_BIN) == 0) {
+        Proto_Command(value); // Switch between ASCII lines and binary frames
+    } else if (strcmp(command, CMD_SNIFF) == 0) {
+        Sniffer_Command(value); // Raw bus streaming
+    } else if (strcmp(command, CMD_BUS) == 0) {
+        CAN_Health_Command(value); // Bus state and error counters
+    } else if (strcmp(command, CMD_PTX) == 0) {
+        CAN_Periodic_Command(value); // Periodic frames we transmit
+    } else if (strcmp(command, CMD_BOOT) == 0) {
+        Boot_Command(value); // Reset cause and boot times
+    } else if (strcmp(command, CMD_STATUS) == 0) {
+        Status_Command(value); // State snapshot, coalesced deltas
+    } else if (strcmp(command, CMD_ISOTP) == 0) {
+        IsoTp_Command(value); // ISO-TP reassembly counters
+    } else if (strcmp(command, CMD_CAN_TX) == 0) {
+        CAN_TxQueue_Command(value); // Per-ID CAN TX counters
     } else {
         SendToAndroid(RESP_ERR, ERR_INVALID_COMMAND); // Unknown command
     }
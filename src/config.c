@@ -1,35 +1,48 @@
 #include "config.h"
-#include "commands.h" // For SendToAndroid
-#include <stdio.h>     // For sscanf
-#include "stm32f1xx_hal.h" // Include the HAL *here* for flash operations
+#include "uart.h" // For SendToAndroid
+#include "can_filter.h" // For CAN_Filter_Apply
+#include "config_store.h"
+#include <stdio.h>
+#include <stdlib.h> // For strtoul
+#include <string.h>
 
 // --- Configuration Variables (Defaults) ---
-uint32_t config_ign_src = IGNITION_STATUS_ID;
-uint32_t config_illum_src = DASHBOARD_LIGHTS_ID;
-uint32_t config_rev_src = REVERSE_GEAR_ID;
-uint32_t config_park_src = DASHBOARD_LIGHTS_ID;
-uint32_t config_door_src = DOOR_STATUS_ID;
-
-// --- Flash Storage (STM32F103 Specific) ---
-
-// *IMPORTANT*:  Choose an address that is *outside* of your program code!
-//  On the STM32F103C8, the flash starts at 0x08000000.  The program code
-//  will typically occupy the first part of flash.  You need to choose an
-//  address that's far enough along to avoid overwriting your program.
-//  0x0800F000 is likely safe for smaller programs, but *check your .map file*!
-//  The .map file (generated by the linker) shows the memory layout of your
-//  program.  Look for the end address of your code.
-#define CONFIG_FLASH_ADDRESS 0x0800F000
-
-//  The STM32F103 has 1KB or 2KB pages (depending on the density).  We *must* erase
-//  an entire page before writing.  We'll use a single page for our configuration.
-#define CONFIG_PAGE_SIZE 1024 // Or 2048, depending on your chip.  Check datasheet!
-
-//  "Magic Number" to check if flash has been initialized.  Choose any unique value.
-#define CONFIG_MAGIC_NUMBER 0xCAFEBABE
-
-// Structure to hold our configuration data.  This makes it easier to
-//  read and write the data as a block.
+#define CONFIG_PARAM_DEFINE(name, var, def, min, max, flags) uint32_t var = def;
+CONFIG_TABLE(CONFIG_PARAM_DEFINE)
+#undef CONFIG_PARAM_DEFINE
+
+typedef struct {
+    const char *name;
+    uint32_t *var;
+    uint32_t min;
+    uint32_t max;
+    uint8_t flags;
+} ConfigParamDef;
+
+static const ConfigParamDef config_params[CFG_COUNT] = {
+#define CONFIG_PARAM_DEF(name, var, def, min, max, flags) { #name, &var, min, max, flags },
+    CONFIG_TABLE(CONFIG_PARAM_DEF)
+#undef CONFIG_PARAM_DEF
+};
+
+// --- Flash Storage ---
+// Saved through the record log in config_store.c as one uint32_t per
+// parameter, in table order. The layout is versioned; a newer layout may
+// only append parameters, so an older record loads as a prefix and the
+// parameters it lacks keep their defaults.
+#define CONFIG_VERSION 3 // 2: key_long_ms, key_repeat_ms; 3: sts_win_ms
+
+typedef struct {
+    uint32_t values[CFG_COUNT];
+} ConfigData;
+
+_Static_assert(sizeof(ConfigData) <= CONFIG_RECORD_PAYLOAD, "Config parameters must fit one record");
+
+// Single-page format of earlier firmware (erased and rewritten on every
+// save). Read once so an upgrade keeps the settings; the first save moves
+// them into the record log.
+#define CONFIG_LEGACY_MAGIC 0xCAFEBABE
+
 typedef struct {
     uint32_t magic_number;
     uint32_t ign_src;
@@ -37,118 +50,206 @@ typedef struct {
     uint32_t rev_src;
     uint32_t park_src;
     uint32_t door_src;
-} ConfigData;
+} LegacyConfigData;
+
+// --- Name Lookup ---
+// Names are matched by FNV-1a hash and then confirmed with one strcmp, so a
+// lookup costs one pass over the name. The hashes are filled in by the first
+// lookup, which also covers the QEMU build where load_config() never runs.
+static uint32_t config_hashes[CFG_COUNT];
+static bool config_hashed;
+
+static uint32_t config_hash(const char *name, size_t len) {
+    uint32_t hash = 2166136261U;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (uint8_t)name[i]) * 16777619U;
+    }
+    return hash;
+}
 
+static uint8_t config_find(const char *name, size_t len) {
+    if (!config_hashed) {
+        for (uint8_t i = 0; i < CFG_COUNT; i++) {
+            config_hashes[i] = config_hash(config_params[i].name, strlen(config_params[i].name));
+        }
+        config_hashed = true;
+    }
+
+    uint32_t hash = config_hash(name, len);
+    for (uint8_t i = 0; i < CFG_COUNT; i++) {
+        if (config_hashes[i] == hash && strncmp(config_params[i].name, name, len) == 0 &&
+            config_params[i].name[len] == '\0') {
+            return i;
+        }
+    }
+    return CFG_COUNT;
+}
+
+static void config_snapshot(ConfigData *config) {
+    for (uint8_t i = 0; i < CFG_COUNT; i++) {
+        config->values[i] = *config_params[i].var;
+    }
+}
 
 void load_config(void) {
-    ConfigData *config = (ConfigData *)CONFIG_FLASH_ADDRESS;
-
-    if (config->magic_number == CONFIG_MAGIC_NUMBER) {
-        // Valid configuration data found.  Load it.
-        config_ign_src = config->ign_src;
-        config_illum_src = config->illum_src;
-        config_rev_src = config->rev_src;
-        config_park_src = config->park_src;
-        config_door_src = config->door_src;
+    ConfigData config;
+    uint8_t version;
+
+    config_snapshot(&config); // Defaults for whatever an older record lacks
+    if (ConfigStore_Load(&config, sizeof(config), &version) > 0) {
+        (void)version; // Only appended parameters so far: older records load as a prefix
+        for (uint8_t i = 0; i < CFG_COUNT; i++) {
+            *config_params[i].var = config.values[i];
+        }
+        return;
+    }
+
+    const LegacyConfigData *legacy = (const LegacyConfigData *)CONFIG_STORE_ADDRESS;
+    if (legacy->magic_number == CONFIG_LEGACY_MAGIC) {
+        config_ign_src = legacy->ign_src;
+        config_illum_src = legacy->illum_src;
+        config_rev_src = legacy->rev_src;
+        config_park_src = legacy->park_src;
+        config_door_src = legacy->door_src;
     } // Else:  Use default values (already initialized above).
 }
-void save_config(void) {
 
+// Stages the values; EVT_CONFIG_WRITE programs them in the background
+void save_config(void) {
     ConfigData config;
 
-    config.magic_number = CONFIG_MAGIC_NUMBER;
-    config.ign_src = config_ign_src;
-    config.illum_src = config_illum_src;
-    config.rev_src = config_rev_src;
-    config.park_src = config_park_src;
-    config.door_src = config_door_src;
-
-    HAL_FLASH_Unlock();
-
-    // Erase the configuration page.
-    FLASH_EraseInitTypeDef erase_init;
-    erase_init.TypeErase = FLASH_TYPEERASE_PAGES;
-    erase_init.PageAddress = CONFIG_FLASH_ADDRESS;
-    erase_init.NbPages = 1; // Erase a single page
-    uint32_t page_error = 0; // Variable to hold error information
-
-    if (HAL_FLASHEx_Erase(&erase_init, &page_error) != HAL_OK) {
-        // Handle erase error.  Could be a flash protection issue,
-        //  or an invalid address.
-        SendToAndroid(RESP_ERR, "FLASH_ERASE_ERR");
-		HAL_FLASH_Lock(); //Always lock the flash after operation
+    config_snapshot(&config);
+    if (!ConfigStore_Save(&config, sizeof(config), CONFIG_VERSION)) {
+        SendToAndroid(RESP_ERR, "FLASH_WRITE_ERR");
+    }
+}
+
+// --- Commands ---
+static uint32_t config_staged[CFG_COUNT];
+static uint32_t config_staged_mask; // Bit per parameter staged since BEGIN
+static bool config_transaction;
+
+static void config_send_value(uint8_t i) {
+    char buf[40];
+    const ConfigParamDef *param = &config_params[i];
+    snprintf(buf, sizeof(buf), (param->flags & CONFIG_HEX) ? "%s:%#lx" : "%s:%lu", param->name,
+             (unsigned long)*param->var);
+    SendToAndroid(RESP_CFG, buf);
+}
+
+static void config_get(const char *name) {
+    if (strcmp(name, "*") == 0) {
+        for (uint8_t i = 0; i < CFG_COUNT; i++) {
+            config_send_value(i);
+        }
+        SendToAndroid(RESP_CFG, "END");
+        return;
+    }
+    uint8_t i = config_find(name, strlen(name));
+    if (i == CFG_COUNT) {
+        SendToAndroid(RESP_ERR, ERR_INVALID_CONFIG);
         return;
     }
+    config_send_value(i);
+}
 
-    // Program the configuration data.  We write it as a struct.
-	uint8_t * pData = (uint8_t *)&config;
-	for(int i = 0; i < sizeof(ConfigData); i+=4){
-		if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, CONFIG_FLASH_ADDRESS + i, *(uint32_t *)(pData + i)) != HAL_OK) {
-       		 // Handle program error.
-        	SendToAndroid(RESP_ERR, "FLASH_WRITE_ERR");
-			HAL_FLASH_Lock(); //Always lock the flash after operation
-        	return;
-		}
-	}
-    HAL_FLASH_Lock();
+// Parses "<name>:<value>[,<name>:<value>...]" into values/mask. Nothing is
+// returned for a line with any unknown name, bad number or value out of range.
+static const char *config_parse(const char *list, uint32_t *values, uint32_t *mask) {
+    const char *p = list;
+
+    *mask = 0;
+    while (true) {
+        const char *colon = strchr(p, ':');
+        if (colon == NULL) {
+            return ERR_INVALID_CONFIG;
+        }
+        uint8_t i = config_find(p, (size_t)(colon - p));
+        if (i == CFG_COUNT) {
+            return ERR_INVALID_CONFIG;
+        }
+        const ConfigParamDef *param = &config_params[i];
+        char *end;
+        unsigned long value = strtoul(colon + 1, &end, (param->flags & CONFIG_HEX) ? 16 : 10);
+        if (end == colon + 1 || (*end != ',' && *end != '\0')) {
+            return ERR_INVALID_CONFIG;
+        }
+        if (value < param->min || value > param->max) {
+            return ERR_CONFIG_RANGE;
+        }
+        values[i] = (uint32_t)value;
+        *mask |= 1UL << i;
+        if (*end == '\0') {
+            return NULL;
+        }
+        p = end + 1;
+    }
 }
 
-void ProcessConfigCommand(const char *parameter, const char *value) {
- // ... (Rest of ProcessConfigCommand - No Changes, see previous response) ...
-  if (strcmp(parameter, "GET") == 0) {
-        if (strcmp(value, "ign_src") == 0) {
-            char buf[32];
-            snprintf(buf, sizeof(buf), "ign_src:%#x", (unsigned int)config_ign_src);
-            SendToAndroid(RESP_CFG, buf);
-        } else if (strcmp(value, "illum_src") == 0) {
-            char buf[32];
-            snprintf(buf, sizeof(buf), "illum_src:%#x", (unsigned int)config_illum_src);
-            SendToAndroid(RESP_CFG, buf);
-        } else if (strcmp(value, "rev_src") == 0) {
-            char buf[32];
-            snprintf(buf, sizeof(buf), "rev_src:%#x", (unsigned int)config_rev_src);
-            SendToAndroid(RESP_CFG, buf);
-        } else if (strcmp(value, "park_src") == 0) {
-            char buf[32];
-            snprintf(buf, sizeof(buf), "park_src:%#x", (unsigned int)config_park_src);
-            SendToAndroid(RESP_CFG, buf);
-        } else if(strcmp(value, "door_src") == 0) {
-             char buf[32];
-            snprintf(buf, sizeof(buf), "door_src:%#x", (unsigned int)config_door_src);
-            SendToAndroid(RESP_CFG, buf);
+// Applies the masked values with a single save. Filters are reprogrammed
+// once if any CAN ID changed; if that fails the old values are restored.
+static void config_commit(const uint32_t *values, uint32_t mask) {
+    uint32_t old[CFG_COUNT];
+    bool refilter = false;
+
+    for (uint8_t i = 0; i < CFG_COUNT; i++) {
+        old[i] = *config_params[i].var;
+        if (mask & (1UL << i)) {
+            refilter |= (config_params[i].flags & CONFIG_REFILTER) && values[i] != old[i];
+            *config_params[i].var = values[i];
+        }
+    }
+    if (refilter && !CAN_Filter_Apply()) {
+        for (uint8_t i = 0; i < CFG_COUNT; i++) {
+            *config_params[i].var = old[i];
         }
-        // Add other configuration parameters as needed
-        else {
-            SendToAndroid(RESP_ERR, ERR_INVALID_CONFIG);
+        (void)CAN_Filter_Apply();
+        SendToAndroid(RESP_ERR, ERR_CAN_ERROR);
+        return;
+    }
+    save_config();
+    SendToAndroid(RESP_OK, CMD_CFG);
+}
+
+static void config_set(const char *list) {
+    uint32_t values[CFG_COUNT];
+    uint32_t mask;
+    const char *error = config_parse(list, values, &mask);
+
+    if (error != NULL) {
+        SendToAndroid(RESP_ERR, error);
+        return;
+    }
+    if (!config_transaction) {
+        config_commit(values, mask);
+        return;
+    }
+    for (uint8_t i = 0; i < CFG_COUNT; i++) {
+        if (mask & (1UL << i)) {
+            config_staged[i] = values[i];
         }
+    }
+    config_staged_mask |= mask;
+    SendToAndroid(RESP_OK, CMD_CFG);
+}
+
+// parameter is the first field after "!CFG:", value the rest of the line
+void ProcessConfigCommand(const char *parameter, const char *value) {
+    if (strcmp(parameter, "GET") == 0) {
+        config_get(value);
     } else if (strcmp(parameter, "SET") == 0) {
-        // Convert the value string to a uint32_t
-        unsigned int new_value;
-        if (sscanf(value, "%x", &new_value) == 1) { // Use %x for hex input
-            if (strcmp(value, "ign_src") == 0) {
-                config_ign_src = (uint32_t)new_value;
-				save_config();
-            } else if(strcmp(value, "illum_src") == 0) {
-                config_illum_src = (uint32_t)new_value;
-				save_config();
-            } else if(strcmp(value, "rev_src") == 0){
-                config_rev_src = (uint32_t)new_value;
-				save_config();
-            } else if(strcmp(value, "park_src") == 0){
-                config_park_src = (uint32_t)new_value;
-				save_config();
-            } else if (strcmp(value, "door_src") == 0){
-                config_door_src = (uint32_t)new_value;
-				save_config();
-            }
-            // Add other configuration parameters
-            else {
-                SendToAndroid(RESP_ERR, ERR_INVALID_CONFIG);
-            }
-        } else {
-            SendToAndroid(RESP_ERR, ERR_INVALID_CONFIG); // Invalid value format
-        }
+        config_set(value);
+    } else if (strcmp(parameter, "BEGIN") == 0) {
+        config_transaction = true; // A second BEGIN starts over
+        config_staged_mask = 0;
+        SendToAndroid(RESP_OK, CMD_CFG);
+    } else if (strcmp(parameter, "COMMIT") == 0 && config_transaction) {
+        config_transaction = false;
+        config_commit(config_staged, config_staged_mask);
+    } else if (strcmp(parameter, "ABORT") == 0 && config_transaction) {
+        config_transaction = false;
+        SendToAndroid(RESP_OK, CMD_CFG);
     } else {
-        SendToAndroid(RESP_ERR, ERR_INVALID_CONFIG); // Invalid parameter (not GET or SET)
+        SendToAndroid(RESP_ERR, ERR_INVALID_CONFIG); // Unknown, or COMMIT/ABORT without BEGIN
     }
 }
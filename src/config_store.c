@@ -0,0 +1,198 @@
+#include "config_store.h"
+#include "crc16.h"
+#include "scheduler.h"
+#include "uart.h" // For SendToAndroid
+#include <stddef.h>
+#include <string.h>
+
+#define CONFIG_RECORD_MAGIC 0xC5A1
+
+// Laid out in half-words, programmed in order with the CRC last: a record
+// cut short by a reset fails the CRC check and is ignored.
+typedef struct {
+    uint16_t magic;    // CONFIG_RECORD_MAGIC
+    uint8_t version;   // Layout version of the payload
+    uint8_t length;    // Payload bytes in use
+    uint32_t seq;      // Higher is newer
+    uint8_t payload[CONFIG_RECORD_PAYLOAD];
+    uint16_t crc;      // CRC-16 of everything above
+    uint16_t reserved; // Left erased
+} ConfigRecord;
+
+_Static_assert(sizeof(ConfigRecord) == CONFIG_RECORD_SIZE, "ConfigRecord must fill one slot");
+_Static_assert(CONFIG_STORE_PAGE_SIZE % CONFIG_RECORD_SIZE == 0, "Slots must tile a page");
+
+#define CONFIG_RECORD_HALFWORDS (CONFIG_RECORD_SIZE / 2)
+
+typedef enum {
+    STORE_IDLE,
+    STORE_ERASE,   // Active page full: erase the next one first
+    STORE_PROGRAM, // Programming store_record, one half-word per pass
+} ConfigStoreState;
+
+static ConfigStoreState store_state = STORE_IDLE;
+static uint8_t store_page;        // Page records are appended to
+static uint8_t store_slot;        // Next free slot in it (CONFIG_STORE_SLOTS: full)
+static uint32_t store_seq;        // Sequence number of the newest record
+static ConfigRecord store_record; // Record being programmed
+static uint8_t store_pos;         // Next half-word of store_record
+
+// Latest snapshot from ConfigStore_Save, not yet turned into a record
+static uint8_t store_staged[CONFIG_RECORD_PAYLOAD];
+static uint8_t store_staged_len;
+static uint8_t store_staged_version;
+static bool store_dirty = false;
+
+static uint32_t ConfigStore_SlotAddress(uint8_t page, uint8_t slot) {
+    return CONFIG_STORE_ADDRESS + (uint32_t)page * CONFIG_STORE_PAGE_SIZE +
+           (uint32_t)slot * CONFIG_RECORD_SIZE;
+}
+
+static bool ConfigStore_SlotErased(uint32_t address) {
+    const uint32_t *word = (const uint32_t *)(uintptr_t)address;
+    for (uint8_t i = 0; i < CONFIG_RECORD_SIZE / 4; i++) {
+        if (word[i] != 0xFFFFFFFFU) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool ConfigStore_RecordValid(const ConfigRecord *record) {
+    return record->magic == CONFIG_RECORD_MAGIC && record->length <= CONFIG_RECORD_PAYLOAD &&
+           record->crc == Crc16(CRC16_INIT, record, offsetof(ConfigRecord, crc));
+}
+
+uint8_t ConfigStore_Load(void *data, uint8_t size, uint8_t *version) {
+    const ConfigRecord *newest = NULL;
+
+    // With no record at all, start on the last page: the first page may
+    // still hold a config saved in the old single-page format
+    store_page = CONFIG_STORE_PAGES - 1;
+    for (uint8_t page = 0; page < CONFIG_STORE_PAGES; page++) {
+        for (uint8_t slot = 0; slot < CONFIG_STORE_SLOTS; slot++) {
+            const ConfigRecord *record = (const ConfigRecord *)(uintptr_t)ConfigStore_SlotAddress(page, slot);
+            if (ConfigStore_RecordValid(record) && (newest == NULL || record->seq > newest->seq)) {
+                newest = record;
+                store_page = page;
+            }
+        }
+    }
+
+    // Append after the last slot in use; torn records are skipped as well
+    store_slot = 0;
+    for (uint8_t slot = 0; slot < CONFIG_STORE_SLOTS; slot++) {
+        if (!ConfigStore_SlotErased(ConfigStore_SlotAddress(store_page, slot))) {
+            store_slot = slot + 1;
+        }
+    }
+
+    if (newest == NULL) {
+        store_seq = 0;
+        return 0;
+    }
+    store_seq = newest->seq;
+    uint8_t len = newest->length < size ? newest->length : size;
+    memcpy(data, newest->payload, len);
+    *version = newest->version;
+    return len;
+}
+
+bool ConfigStore_Save(const void *data, uint8_t size, uint8_t version) {
+    if (size > CONFIG_RECORD_PAYLOAD) {
+        return false;
+    }
+    memcpy(store_staged, data, size);
+    store_staged_len = size;
+    store_staged_version = version;
+    store_dirty = true;
+    Sched_Post(EVT_CONFIG_WRITE);
+    return true;
+}
+
+bool ConfigStore_Busy(void) {
+    return store_state != STORE_IDLE || store_dirty;
+}
+
+static void ConfigStore_Abort(const char *error) {
+    HAL_FLASH_Lock(); // Always lock the flash after operation
+    store_state = STORE_IDLE;
+    SendToAndroid(RESP_ERR, error);
+}
+
+static void ConfigStore_Begin(void) {
+    // Unused payload bytes stay 0xFF so their half-words need no programming
+    memset(&store_record, 0xFF, sizeof(store_record));
+    store_record.magic = CONFIG_RECORD_MAGIC;
+    store_record.version = store_staged_version;
+    store_record.length = store_staged_len;
+    store_record.seq = store_seq + 1;
+    memcpy(store_record.payload, store_staged, store_staged_len);
+    store_record.crc = Crc16(CRC16_INIT, &store_record, offsetof(ConfigRecord, crc));
+    store_dirty = false;
+    store_pos = 0;
+
+    HAL_FLASH_Unlock();
+    store_state = store_slot < CONFIG_STORE_SLOTS ? STORE_PROGRAM : STORE_ERASE;
+}
+
+static void ConfigStore_ErasePage(void) {
+    // Compaction: every record is a full snapshot, so the new page only
+    // needs the one being written. The full page keeps the newest valid
+    // record until that one is complete. store_page only moves once the
+    // erase succeeded: after a failure the next save erases the same page
+    // again instead of moving on to the one holding that record.
+    uint8_t page = (uint8_t)((store_page + 1) % CONFIG_STORE_PAGES);
+
+    FLASH_EraseInitTypeDef erase_init;
+    erase_init.TypeErase = FLASH_TYPEERASE_PAGES;
+    erase_init.PageAddress = ConfigStore_SlotAddress(page, 0);
+    erase_init.NbPages = 1;
+    uint32_t page_error = 0;
+    if (HAL_FLASHEx_Erase(&erase_init, &page_error) != HAL_OK) {
+        ConfigStore_Abort("FLASH_ERASE_ERR"); // store_slot stays full: erase again next time
+        return;
+    }
+    store_page = page;
+    store_slot = 0;
+    store_state = STORE_PROGRAM;
+}
+
+static void ConfigStore_ProgramNext(void) {
+    uint16_t halfword = ((const uint16_t *)&store_record)[store_pos];
+    uint32_t address = ConfigStore_SlotAddress(store_page, store_slot) + store_pos * 2U;
+
+    if (halfword != 0xFFFFU &&
+        HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, address, halfword) != HAL_OK) {
+        store_slot++; // Partly written, never reuse it
+        ConfigStore_Abort("FLASH_WRITE_ERR");
+        return;
+    }
+    if (++store_pos == CONFIG_RECORD_HALFWORDS) {
+        store_seq = store_record.seq;
+        store_slot++;
+        HAL_FLASH_Lock();
+        store_state = STORE_IDLE;
+    }
+}
+
+void ConfigStore_Service(void) {
+    switch (store_state) {
+        case STORE_IDLE:
+            if (!store_dirty) {
+                return;
+            }
+            ConfigStore_Begin();
+            break;
+        case STORE_ERASE:
+            ConfigStore_ErasePage();
+            break;
+        case STORE_PROGRAM:
+            ConfigStore_ProgramNext();
+            break;
+    }
+    // One step per pass: events posted meanwhile run before the next one
+    if (ConfigStore_Busy()) {
+        Sched_Post(EVT_CONFIG_WRITE);
+    }
+}
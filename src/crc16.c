@@ -0,0 +1,17 @@
+#include "crc16.h"
+
+// Nibble table: two lookups per byte, 32 bytes of flash
+static const uint16_t crc16_table[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+};
+
+uint16_t Crc16(uint16_t crc, const void *data, size_t len) {
+    const uint8_t *p = (const uint8_t *)data;
+    while (len--) {
+        crc = (uint16_t)((crc << 4) ^ crc16_table[(crc >> 12) ^ (*p >> 4)]);
+        crc = (uint16_t)((crc << 4) ^ crc16_table[(crc >> 12) ^ (*p & 0x0F)]);
+        p++;
+    }
+    return crc;
+}
@@ -0,0 +1,275 @@
+#include "isotp.h"
+#include "can.h" // For CAN_Transmit
+#include "uart.h" // For SendToAndroid, UART_TxFree
+#include <stdio.h>
+#include <string.h>
+
+// Protocol control information, high nibble of byte 0
+#define ISOTP_PCI_SINGLE      0x0
+#define ISOTP_PCI_FIRST       0x1
+#define ISOTP_PCI_CONSECUTIVE 0x2
+#define ISOTP_PCI_FLOW        0x3
+
+// Flow status, low nibble of a flow-control frame
+#define ISOTP_FS_CTS      0x0
+#define ISOTP_FS_OVERFLOW 0x2
+
+#define ISOTP_NO_SESSION 0xFF
+
+// Lines of "!TP:<id>,<offset>/<len>," plus the hex and '\n' (an upper bound)
+#define ISOTP_FORWARD_LINE (24U + 2U * ISOTP_FORWARD_CHUNK)
+
+_Static_assert((ISOTP_MAX_PAYLOAD + ISOTP_FORWARD_CHUNK - 1U) / ISOTP_FORWARD_CHUNK * ISOTP_FORWARD_LINE <=
+                   UART_TX_RING_SIZE,
+               "The largest message must fit into the UART queue, or it is never forwarded");
+
+typedef struct {
+    uint16_t rx_id;
+    uint16_t fc_id;
+    IsoTpHandler handler;
+} IsoTpDef;
+
+static const IsoTpDef isotp_defs[] = {
+#define ISOTP_DEF(name, rx_id, fc_id, handler) { rx_id, fc_id, handler },
+    ISOTP_TABLE(ISOTP_DEF)
+#undef ISOTP_DEF
+};
+#define ISOTP_COUNT (sizeof(isotp_defs) / sizeof(isotp_defs[0]))
+
+typedef struct {
+    uint8_t owner;      // Index into isotp_defs + 1, 0 if free
+    uint8_t next_sn;    // Expected sequence number (low nibble)
+    uint8_t block_left; // Consecutive frames until the next flow control (active only)
+    uint16_t length;    // Announced by the first frame
+    uint16_t received;
+    uint32_t last_at;   // Tick of the last frame, for N_Cr
+    uint8_t data[ISOTP_MAX_PAYLOAD];
+} IsoTpSession;
+
+static IsoTpSession isotp_sessions[ISOTP_SESSIONS];
+static uint8_t isotp_session_plus1[ISOTP_COUNT]; // Session of each entry + 1, 0 if none
+static IsoTpStats isotp_stats;
+
+static const char *const isotp_counter_tags[] = {
+#define ISOTP_COUNTER_TAG(name, tag) tag,
+    ISOTP_COUNTERS(ISOTP_COUNTER_TAG)
+#undef ISOTP_COUNTER_TAG
+};
+
+uint8_t IsoTp_GetIds(uint16_t *ids, uint8_t max) {
+    uint8_t count = 0;
+
+    for (uint8_t i = 0; i < ISOTP_COUNT && count < max; i++) {
+        ids[count++] = isotp_defs[i].rx_id;
+    }
+    return count;
+}
+
+static uint8_t IsoTp_SessionOf(uint8_t def) {
+    return (uint8_t)(isotp_session_plus1[def] - 1U); // ISOTP_NO_SESSION if none
+}
+
+static void IsoTp_Release(uint8_t def) {
+    uint8_t s = IsoTp_SessionOf(def);
+
+    if (s != ISOTP_NO_SESSION) {
+        isotp_sessions[s].owner = 0;
+        isotp_session_plus1[def] = 0;
+    }
+}
+
+static bool IsoTp_Expired(const IsoTpSession *session, uint32_t now) {
+    return now - session->last_at > ISOTP_TIMEOUT_MS;
+}
+
+// Free session, or one whose sender went quiet (reclaimed here, not by a timer)
+static uint8_t IsoTp_Allocate(uint8_t def, uint32_t now) {
+    for (uint8_t s = 0; s < ISOTP_SESSIONS; s++) {
+        IsoTpSession *session = &isotp_sessions[s];
+        if (session->owner != 0) {
+            if (!IsoTp_Expired(session, now)) {
+                continue;
+            }
+            isotp_stats.timeout++;
+            isotp_session_plus1[session->owner - 1U] = 0;
+        }
+        session->owner = (uint8_t)(def + 1U);
+        isotp_session_plus1[def] = (uint8_t)(s + 1U);
+        return s;
+    }
+    return ISOTP_NO_SESSION;
+}
+
+static void IsoTp_SendFlow(const IsoTpDef *def, uint8_t status) {
+    if (def->fc_id == 0) {
+        return; // Passive: the addressee answers
+    }
+    uint8_t fc[8] = { (uint8_t)((ISOTP_PCI_FLOW << 4) | status), ISOTP_BLOCK_SIZE, 0 /* STmin */ };
+    CAN_Transmit(def->fc_id, fc, sizeof(fc));
+}
+
+static void IsoTp_FirstFrame(uint8_t index, const uint8_t *data, uint8_t dlc, uint32_t now) {
+    const IsoTpDef *def = &isotp_defs[index];
+    uint16_t length = (uint16_t)(((data[0] & 0x0F) << 8) | data[1]);
+
+    if (IsoTp_SessionOf(index) != ISOTP_NO_SESSION) {
+        isotp_stats.aborted++; // A new first frame replaces the unfinished message
+        IsoTp_Release(index);
+    }
+    if (dlc < 8 || length < 8) {
+        return; // Malformed (or the 32-bit escape, which classic CAN never needs)
+    }
+    if (length > ISOTP_MAX_PAYLOAD) {
+        isotp_stats.oversize++;
+        IsoTp_SendFlow(def, ISOTP_FS_OVERFLOW);
+        return;
+    }
+
+    uint8_t s = IsoTp_Allocate(index, now);
+    if (s == ISOTP_NO_SESSION) {
+        isotp_stats.no_buffer++;
+        IsoTp_SendFlow(def, ISOTP_FS_OVERFLOW);
+        return;
+    }
+
+    IsoTpSession *session = &isotp_sessions[s];
+    session->length = length;
+    session->received = 6;
+    session->next_sn = 1;
+    session->block_left = ISOTP_BLOCK_SIZE;
+    session->last_at = now;
+    memcpy(session->data, &data[2], 6);
+    IsoTp_SendFlow(def, ISOTP_FS_CTS);
+}
+
+static void IsoTp_ConsecutiveFrame(uint8_t index, const uint8_t *data, uint8_t dlc, uint32_t now) {
+    uint8_t s = IsoTp_SessionOf(index);
+    if (s == ISOTP_NO_SESSION) {
+        return; // Joined mid-message, or after an error: wait for the next first frame
+    }
+
+    IsoTpSession *session = &isotp_sessions[s];
+    if (IsoTp_Expired(session, now)) {
+        isotp_stats.timeout++;
+        IsoTp_Release(index);
+        return;
+    }
+    if ((data[0] & 0x0F) != session->next_sn) {
+        isotp_stats.sequence++; // Lost or repeated frame: the message cannot be completed
+        IsoTp_Release(index);
+        return;
+    }
+
+    uint16_t chunk = (uint16_t)(session->length - session->received);
+    if (chunk > 7) {
+        chunk = 7;
+    }
+    if (dlc < chunk + 1U) {
+        isotp_stats.sequence++;
+        IsoTp_Release(index);
+        return;
+    }
+    memcpy(&session->data[session->received], &data[1], chunk);
+    session->received += chunk;
+    session->next_sn = (session->next_sn + 1U) & 0x0F;
+    session->last_at = now;
+
+    if (session->received == session->length) {
+        isotp_stats.complete++;
+        isotp_defs[index].handler(isotp_defs[index].rx_id, session->data, session->length);
+        IsoTp_Release(index);
+    } else if (ISOTP_BLOCK_SIZE != 0 && --session->block_left == 0) {
+        session->block_left = ISOTP_BLOCK_SIZE;
+        IsoTp_SendFlow(&isotp_defs[index], ISOTP_FS_CTS);
+    }
+}
+
+bool IsoTp_Receive(uint32_t id, const uint8_t *data, uint8_t dlc) {
+    uint8_t index = 0;
+
+    while (index < ISOTP_COUNT && isotp_defs[index].rx_id != id) {
+        index++;
+    }
+    if (index == ISOTP_COUNT) {
+        return false;
+    }
+    if (dlc == 0) {
+        return true;
+    }
+
+    uint32_t now = HAL_GetTick();
+    switch (data[0] >> 4) {
+        case ISOTP_PCI_SINGLE: {
+            uint8_t length = data[0] & 0x0F;
+            if (length == 0 || length > 7 || length + 1U > dlc) {
+                break;
+            }
+            if (IsoTp_SessionOf(index) != ISOTP_NO_SESSION) {
+                isotp_stats.aborted++;
+                IsoTp_Release(index);
+            }
+            isotp_stats.single++;
+            isotp_defs[index].handler(id, &data[1], length);
+            break;
+        }
+        case ISOTP_PCI_FIRST:
+            IsoTp_FirstFrame(index, data, dlc, now);
+            break;
+        case ISOTP_PCI_CONSECUTIVE:
+            IsoTp_ConsecutiveFrame(index, data, dlc, now);
+            break;
+        default:
+            break; // Flow control is for the sender
+    }
+    return true;
+}
+
+void IsoTp_Forward(uint32_t id, const uint8_t *data, uint16_t len) {
+    // Whole message or nothing: a partial payload is of no use to the head unit
+#ifndef USE_QEMU
+    uint32_t lines = (len + ISOTP_FORWARD_CHUNK - 1U) / ISOTP_FORWARD_CHUNK;
+    if (lines * ISOTP_FORWARD_LINE > UART_TxFree()) {
+        isotp_stats.forward_dropped++;
+        return;
+    }
+#endif
+
+    for (uint16_t offset = 0; offset < len; offset += ISOTP_FORWARD_CHUNK) {
+        char buf[16 + 2 * ISOTP_FORWARD_CHUNK];
+        uint16_t chunk = (uint16_t)(len - offset);
+        if (chunk > ISOTP_FORWARD_CHUNK) {
+            chunk = ISOTP_FORWARD_CHUNK;
+        }
+        int pos = snprintf(buf, sizeof(buf), "%03lX,%u/%u,", (unsigned long)id, offset, len);
+        for (uint16_t i = 0; i < chunk; i++) {
+            pos += snprintf(&buf[pos], sizeof(buf) - (size_t)pos, "%02X", data[offset + i]);
+        }
+        SendToAndroid(RESP_ISOTP, buf);
+    }
+}
+
+void IsoTp_GetStats(IsoTpStats *stats) {
+    *stats = isotp_stats;
+}
+
+static void IsoTp_SendCounters(void) {
+    const uint32_t *counters = (const uint32_t *)&isotp_stats;
+    char line[24];
+
+    for (uint8_t i = 0; i < sizeof(isotp_counter_tags) / sizeof(isotp_counter_tags[0]); i++) {
+        snprintf(line, sizeof(line), "%s,%lu", isotp_counter_tags[i], (unsigned long)counters[i]);
+        SendToAndroid(RESP_ISOTP_STATS, line);
+    }
+    SendToAndroid(RESP_ISOTP_STATS, "END");
+}
+
+void IsoTp_Command(const char *value) {
+    if (value[0] == '\0' || strcmp(value, "GET") == 0) {
+        IsoTp_SendCounters();
+    } else if (strcmp(value, "RST") == 0) {
+        memset(&isotp_stats, 0, sizeof(isotp_stats)); // Main loop only, like the receiver
+        SendToAndroid(RESP_OK, CMD_ISOTP);
+    } else {
+        SendToAndroid(RESP_ERR, ERR_INVALID_COMMAND);
+    }
+}
@@ -0,0 +1,104 @@
+#include "keys.h"
+#include "uart.h" // For SendToAndroid
+#include <stdio.h>
+
+typedef struct {
+    uint8_t bit;
+    uint8_t hold;
+    const char *name;
+} KeyDef;
+
+static const KeyDef key_defs[] = {
+#define KEY_DEF(bit, name, hold) { bit, hold, name },
+    KEY_TABLE(KEY_DEF)
+#undef KEY_DEF
+};
+#define KEY_COUNT (sizeof(key_defs) / sizeof(key_defs[0]))
+
+static const uint8_t key_known = 0
+#define KEY_BIT(bit, name, hold) | (bit)
+    KEY_TABLE(KEY_BIT)
+#undef KEY_BIT
+    ;
+
+static uint8_t key_raw;           // Bits in the latest frame
+static uint8_t key_stable;        // Debounced: keys reported as held
+static uint8_t key_long_sent;     // KEY_HOLD_LONG keys that already sent :LONG
+static uint32_t key_raw_at;       // key_raw last changed
+static uint32_t key_frame_at;     // Last 0x165 frame
+static uint32_t key_next_at[KEY_COUNT]; // Next :LONG or repeat while held
+
+static void Keys_Send(const KeyDef *def, const char *event) {
+    if (event == NULL) {
+        SendToAndroid(RESP_KEY, def->name);
+    } else {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%s:%s", def->name, event);
+        SendToAndroid(RESP_KEY, buf);
+    }
+}
+
+static void Keys_Evaluate(uint32_t now) {
+    // Debounce: take over the raw bits once they have been stable long enough
+    if (key_raw != key_stable && now - key_raw_at >= KEY_DEBOUNCE_MS) {
+        uint8_t changed = key_raw ^ key_stable;
+        key_stable = key_raw;
+        for (uint8_t i = 0; i < KEY_COUNT; i++) {
+            const KeyDef *def = &key_defs[i];
+            if (!(changed & def->bit)) {
+                continue;
+            }
+            if (key_stable & def->bit) {
+                key_next_at[i] = now + config_key_long_ms;
+                key_long_sent &= (uint8_t)~def->bit;
+                Keys_Send(def, NULL);
+            } else {
+                Keys_Send(def, KEY_EVENT_RELEASE);
+            }
+        }
+    }
+
+    // Hold: :LONG once, or the press again at the repeat rate
+    for (uint8_t i = 0; i < KEY_COUNT; i++) {
+        const KeyDef *def = &key_defs[i];
+        if (!(key_stable & def->bit) || (key_long_sent & def->bit) ||
+            (int32_t)(now - key_next_at[i]) < 0) {
+            continue;
+        }
+        if (def->hold == KEY_HOLD_REPEAT) {
+            key_next_at[i] += config_key_repeat_ms;
+            if ((int32_t)(now - key_next_at[i]) >= 0) {
+                key_next_at[i] = now + config_key_repeat_ms; // Fell behind: no burst
+            }
+            Keys_Send(def, NULL);
+        } else {
+            key_long_sent |= def->bit;
+            Keys_Send(def, KEY_EVENT_LONG);
+        }
+    }
+}
+
+void Keys_Update(uint8_t bits) {
+    uint32_t now = HAL_GetTick();
+
+    bits &= key_known; // Unassigned bits (0x20) are ignored
+    key_frame_at = now;
+    if (bits != key_raw) {
+        key_raw = bits;
+        key_raw_at = now;
+    }
+    Keys_Evaluate(now);
+}
+
+void Keys_Service(void) {
+    if ((key_raw | key_stable) == 0) {
+        return; // Nothing held
+    }
+
+    uint32_t now = HAL_GetTick();
+    if (key_raw != 0 && now - key_frame_at >= KEY_TIMEOUT_MS) {
+        key_raw = 0; // Frames stopped: release now, the silence was the debounce
+        key_raw_at = now - KEY_DEBOUNCE_MS;
+    }
+    Keys_Evaluate(now);
+}
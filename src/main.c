@@ -1,30 +1,74 @@
 #include "main.h"
 #include "can.h"
+#include "can_tx.h"
+#include "can_health.h"
+#include "can_periodic.h"
 #include "uart.h"
 #include "config.h"
+#include "config_store.h"
 #include "signals.h"
 #include "commands.h"
+#include "perf.h"
+#include "scheduler.h"
+#include "proto.h"
+#include "keys.h"
+#include "boot.h"
+#include "status.h"
 
 int main(void) {
+    Boot_Start(); // Reset cause, cycle counter for the boot times
+#ifndef USE_QEMU
+    // Outputs first, from the backup registers: still on the 8 MHz HSI,
+    // before the HSE/PLL lock and everything else
+    Boot_OutputsValid(GPIO_Status_Restore());
+#endif
+    Sched_Init(); // Before SysTick or any other interrupt can touch it
     HAL_Init();
+    HAL_NVIC_SetPriorityGrouping(NVIC_PRIORITYGROUP_4); // The IRQ_PRIO_* levels in main.h
     SystemClock_Config();
+    Boot_ClockReady();
+    Perf_Init(); // DWT cycle counter for the !STA profiling
 
 #ifndef USE_QEMU
+    load_config(); // Load configuration from flash (CAN filters are built from it)
     CAN_Init();
+    CAN_Periodic_Init(); // TIM3 releases the periodic CAN frames
     UART_Init();
-    GPIO_Status_Init();
-    load_config(); // Load configuration from flash
 #endif
 
     send_version();  // Send version at startup (defined in commands.c)
     SendToAndroid(RESP_OK, "INIT");
+    Boot_Report();
 
-    while (1) {
-        ReceiveFromAndroid(); // UART reception is interrupt-driven
 #ifndef USE_QEMU
-        CheckStatusSignals(); // Update output signals
-#endif
+    // Event-driven: interrupts post events, the core sleeps in between
+    Sched_SetHandler(EVT_CAN_RX, CAN_ProcessPending);       // Decode frames queued by the CAN RX interrupt
+    Sched_SetHandler(EVT_UART_RX, ReceiveFromAndroid);      // Lines published by the UART interrupts
+    Sched_SetHandler(EVT_CAN_TX_SERVICE, CAN_TxQueue_Service); // Expire CAN frames that waited too long
+    Sched_SetHandler(EVT_KEYS, Keys_Service);               // Steering wheel key hold/release timing
+    Sched_SetHandler(EVT_OUTPUTS, CheckStatusSignals);      // Update output signals
+    Sched_SetHandler(EVT_CAN_HEALTH, CAN_Health_Service);   // Bus state, bus-off recovery
+    Sched_SetHandler(EVT_STATUS, Status_Service);           // Coalesced state deltas (!STS:CHG:1)
+    Sched_SetHandler(EVT_UART_FLUSH, Proto_Flush);          // Binary mode: one frame per pass
+    Sched_SetHandler(EVT_CONFIG_WRITE, ConfigStore_Service); // Saved config, a half-word at a time
+    Sched_StartTimer(EVT_CAN_TX_SERVICE, 10);
+    Sched_StartTimer(EVT_KEYS, KEY_SERVICE_MS);
+    Sched_StartTimer(EVT_OUTPUTS, 10);
+    Sched_StartTimer(EVT_CAN_HEALTH, CAN_HEALTH_PERIOD_MS);
+    Sched_StartTimer(EVT_STATUS, STATUS_SERVICE_MS);
+
+    while (1) {
+        Sched_RunOnce();
+    }
+#else
+    while (1) {
+        CAN_ProcessPending(); // Decode frames queued by the CAN RX interrupt
+        ReceiveFromAndroid(); // Reads stdin
+        Keys_Service(); // Key hold/release timing
+        Status_Service(); // Coalesced state deltas
+        ConfigStore_Service(); // Saved config, a half-word at a time
     }
+#endif
 }
 
 void SystemClock_Config(void) {
@@ -57,6 +101,13 @@ void SystemClock_Config(void) {
   }
 }
 
+#ifndef USE_QEMU
+void SysTick_Handler(void) {
+    HAL_IncTick(); // Drives HAL_GetTick(), used to timestamp received frames
+    Sched_Tick();  // Timer wheel for the periodic jobs
+}
+#endif
+
 void Error_Handler(void) {
     __disable_irq();
 #ifndef USE_QEMU
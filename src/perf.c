@@ -0,0 +1,292 @@
+#include "perf.h"
+#include "uart.h" // For SendToAndroid
+#include "scheduler.h" // For Sched_Micros
+#include <stdio.h>
+#include <string.h>
+
+#ifndef PERF_DISABLE
+static const char *const section_tags[PERF_SECTION_COUNT] = {
+#define PERF_SECTION_TAG(name, tag) tag,
+    PERF_SECTIONS(PERF_SECTION_TAG)
+#undef PERF_SECTION_TAG
+};
+
+static const char *const counter_tags[PERF_COUNTER_COUNT] = {
+#define PERF_COUNTER_TAG(name, tag) tag,
+    PERF_COUNTERS(PERF_COUNTER_TAG)
+#undef PERF_COUNTER_TAG
+};
+
+static const char *const signal_tags[SIG_COUNT] = {
+#define PERF_SIGNAL_TAG(name, id, byte, bit, len, kind, scale, min, max, hyst, resp, on, off) #name,
+    SIGNAL_TABLE(PERF_SIGNAL_TAG)
+#undef PERF_SIGNAL_TAG
+};
+
+static PerfStats perf_stats[PERF_SECTION_COUNT];
+static uint32_t perf_reset_tick;
+volatile uint32_t perf_counters[PERF_COUNTER_COUNT];
+
+typedef struct {
+    uint32_t stamp_us;
+    uint32_t end; // Ring position just after the message (marks only)
+    uint8_t sig;
+} LatencyOrigin;
+
+static PerfStats latency_stats[SIG_COUNT];
+static LatencyOrigin latency_origin = { .stamp_us = PERF_LATENCY_NONE }; // Frame being decoded
+static LatencyOrigin latency_held[PERF_LATENCY_HELD]; // Queued, not yet in the TX ring
+static uint8_t latency_held_count;
+static LatencyOrigin latency_marks[PERF_LATENCY_MARKS]; // In the TX ring, oldest first
+static uint8_t latency_mark_head;
+static uint8_t latency_mark_count;
+
+void Perf_Init(void) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    Perf_Reset();
+}
+
+// Bucket b takes [2^(b+shift), 2^(b+shift+1)); the first bucket also takes
+// anything shorter and the last anything longer. Interrupts masked.
+static void Perf_Add(PerfStats *s, uint32_t value, uint32_t shift) {
+    uint32_t bucket = 0;
+    if (value >> shift) {
+        bucket = (31U - (uint32_t)__builtin_clz(value)) - shift;
+        if (bucket >= PERF_HIST_BUCKETS) {
+            bucket = PERF_HIST_BUCKETS - 1U;
+        }
+    }
+    if (s->count == 0 || value < s->min) {
+        s->min = value;
+    }
+    if (value > s->max) {
+        s->max = value;
+    }
+    s->count++;
+    s->total += value;
+    s->hist[bucket]++;
+}
+
+// Sections are recorded from both the main loop and interrupts, so the
+// update is done with interrupts masked (a few dozen cycles).
+void Perf_Record(PerfSection section, uint32_t cycles) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    Perf_Add(&perf_stats[section], cycles, 5U);
+    __set_PRIMASK(primask);
+}
+
+// --- End-to-End Latency ---
+void Perf_LatencyBegin(uint32_t stamp_us) {
+    latency_origin.stamp_us = stamp_us;
+    latency_origin.sig = SIG_COUNT; // Until a signal reports
+}
+
+void Perf_LatencySignal(uint8_t sig) {
+    latency_origin.sig = sig;
+}
+
+void Perf_LatencyHold(void) {
+    if (latency_origin.stamp_us == PERF_LATENCY_NONE || latency_origin.sig >= SIG_COUNT) {
+        return;
+    }
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (latency_held_count < PERF_LATENCY_HELD) {
+        latency_held[latency_held_count++] = latency_origin;
+    } else {
+        PERF_COUNT(LATENCY_LOST, 1);
+    }
+    __set_PRIMASK(primask);
+}
+
+// end = PERF_LATENCY_NONE: the write was dropped, so are its messages
+void Perf_LatencyQueued(uint32_t end) {
+    for (uint8_t i = 0; i < latency_held_count && end != PERF_LATENCY_NONE; i++) {
+        if (latency_mark_count == PERF_LATENCY_MARKS) {
+            PERF_COUNT(LATENCY_LOST, latency_held_count - i);
+            break;
+        }
+        LatencyOrigin *mark = &latency_marks[(latency_mark_head + latency_mark_count++) % PERF_LATENCY_MARKS];
+        *mark = latency_held[i];
+        mark->end = end;
+    }
+    latency_held_count = 0;
+}
+
+// Every mark the wire has passed ended (sent - end) byte times ago
+void Perf_LatencySent(uint32_t sent) {
+    uint32_t now = Sched_Micros();
+
+    while (latency_mark_count != 0) {
+        LatencyOrigin *mark = &latency_marks[latency_mark_head];
+        if ((int32_t)(sent - mark->end) < 0) {
+            break;
+        }
+        uint32_t behind = (sent - mark->end) * 10000000U / UART_BAUD_RATE; // 10 bits per byte
+        uint32_t latency = now - mark->stamp_us - behind;
+        if ((int32_t)latency >= 0) {
+            Perf_Add(&latency_stats[mark->sig], latency, 8U);
+        }
+        latency_mark_head = (uint8_t)((latency_mark_head + 1U) % PERF_LATENCY_MARKS);
+        latency_mark_count--;
+    }
+}
+
+void Perf_GetLatency(uint8_t sig, PerfStats *stats) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *stats = latency_stats[sig];
+    __set_PRIMASK(primask);
+}
+
+void Perf_GetStats(PerfSection section, PerfStats *stats) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *stats = perf_stats[section];
+    __set_PRIMASK(primask);
+}
+
+void Perf_Reset(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    memset(perf_stats, 0, sizeof(perf_stats));
+    memset(latency_stats, 0, sizeof(latency_stats));
+    for (uint8_t i = 0; i < PERF_COUNTER_COUNT; i++) {
+        perf_counters[i] = 0;
+    }
+    perf_reset_tick = HAL_GetTick();
+    __set_PRIMASK(primask);
+}
+
+static void Perf_SendSummary(void) {
+    char line[48];
+    PerfStats s;
+
+    for (uint8_t i = 0; i < PERF_SECTION_COUNT; i++) {
+        Perf_GetStats((PerfSection)i, &s);
+        snprintf(line, sizeof(line), "%s,%lu,%lu,%lu,%lu", section_tags[i], (unsigned long)s.count,
+                 (unsigned long)s.min, (unsigned long)(s.count ? s.total / s.count : 0),
+                 (unsigned long)s.max);
+        SendToAndroid(RESP_STATS, line);
+    }
+    for (uint8_t i = 0; i < PERF_COUNTER_COUNT; i++) {
+        snprintf(line, sizeof(line), "%s,%lu", counter_tags[i], (unsigned long)perf_counters[i]);
+        SendToAndroid(RESP_STATS, line);
+    }
+
+    // Share of the time since the last reset spent in WFI
+    uint64_t elapsed = (uint64_t)(HAL_GetTick() - perf_reset_tick) * (SystemCoreClock / 1000U);
+    Perf_GetStats(PERF_SLEEP, &s);
+    uint64_t idle = elapsed ? s.total * 1000U / elapsed : 0;
+    snprintf(line, sizeof(line), "IDLE,%lu", (unsigned long)(idle > 1000U ? 1000U : idle));
+    SendToAndroid(RESP_STATS, line);
+}
+
+static void Perf_SendHistograms(void) {
+    char line[56];
+    PerfStats s;
+
+    for (uint8_t i = 0; i < PERF_SECTION_COUNT; i++) {
+        Perf_GetStats((PerfSection)i, &s);
+        // Two lines of four buckets keep each message short
+        for (uint8_t b = 0; b < PERF_HIST_BUCKETS; b += 4) {
+            snprintf(line, sizeof(line), "%s:H%u,%lu,%lu,%lu,%lu", section_tags[i], b,
+                     (unsigned long)s.hist[b], (unsigned long)s.hist[b + 1],
+                     (unsigned long)s.hist[b + 2], (unsigned long)s.hist[b + 3]);
+            SendToAndroid(RESP_STATS, line);
+        }
+    }
+}
+
+static void Perf_SendLatency(bool histograms) {
+    char line[56];
+    PerfStats s;
+
+    for (uint8_t i = 0; i < SIG_COUNT; i++) {
+        Perf_GetLatency(i, &s);
+        if (s.count == 0) {
+            continue;
+        }
+        if (!histograms) {
+            snprintf(line, sizeof(line), "LAT:%s,%lu,%lu,%lu,%lu", signal_tags[i], (unsigned long)s.count,
+                     (unsigned long)s.min, (unsigned long)(s.total / s.count), (unsigned long)s.max);
+            SendToAndroid(RESP_STATS, line);
+            continue;
+        }
+        for (uint8_t b = 0; b < PERF_HIST_BUCKETS; b += 4) {
+            snprintf(line, sizeof(line), "LAT:%s:H%u,%lu,%lu,%lu,%lu", signal_tags[i], b,
+                     (unsigned long)s.hist[b], (unsigned long)s.hist[b + 1],
+                     (unsigned long)s.hist[b + 2], (unsigned long)s.hist[b + 3]);
+            SendToAndroid(RESP_STATS, line);
+        }
+    }
+}
+
+void Perf_Command(const char *value) {
+    if (value[0] == '\0' || strcmp(value, "GET") == 0) {
+        Perf_SendSummary();
+    } else if (strcmp(value, "HIST") == 0) {
+        Perf_SendHistograms();
+    } else if (strcmp(value, "LAT") == 0) {
+        Perf_SendLatency(false);
+    } else if (strcmp(value, "LATH") == 0) {
+        Perf_SendLatency(true);
+    } else if (strcmp(value, "RST") == 0) {
+        Perf_Reset();
+        SendToAndroid(RESP_OK, CMD_STATS);
+        return;
+    } else {
+        SendToAndroid(RESP_ERR, ERR_INVALID_COMMAND);
+        return;
+    }
+    SendToAndroid(RESP_STATS, "END");
+}
+#else
+void Perf_Init(void) {
+}
+
+void Perf_Record(PerfSection section, uint32_t cycles) {
+    (void)section;
+    (void)cycles;
+}
+
+void Perf_GetStats(PerfSection section, PerfStats *stats) {
+    (void)section;
+    memset(stats, 0, sizeof(*stats));
+}
+
+void Perf_Reset(void) {
+}
+
+void Perf_LatencyBegin(uint32_t stamp_us) {
+    (void)stamp_us;
+}
+
+void Perf_LatencySignal(uint8_t sig) {
+    (void)sig;
+}
+
+void Perf_LatencyHold(void) {
+}
+
+void Perf_LatencyQueued(uint32_t end) {
+    (void)end;
+}
+
+void Perf_LatencySent(uint32_t sent) {
+    (void)sent;
+}
+
+void Perf_GetLatency(uint8_t sig, PerfStats *stats) {
+    (void)sig;
+    memset(stats, 0, sizeof(*stats));
+}
+
+void Perf_Command(const char *value) {
+    (void)value;
+    SendToAndroid(RESP_STATS, "OFF"); // Built with PERF_DISABLE
+}
+#endif // PERF_DISABLE
@@ -0,0 +1,270 @@
+#include "proto.h"
+#include "commands.h" // For ProcessAndroidCommand
+#include "crc16.h"
+#include "perf.h"
+#include "scheduler.h"
+#include "uart.h" // For SendToAndroid, UART_TxWrite
+#include <string.h>
+
+#ifndef USE_QEMU
+#define PROTO_MSG_MAX  (PROTO_FRAME_MAX - 2) // Room left for the CRC
+#define PROTO_WIRE_MAX (PROTO_FRAME_MAX + PROTO_FRAME_MAX / 254 + 2) // COBS overhead + delimiter
+#define PROTO_NO_STATE 0xFF
+
+static volatile bool proto_binary = false;
+
+// Frame being filled, messages only (the CRC is appended on flush). Thread
+// and ISR senders share it, so it is only touched with interrupts masked.
+static uint8_t proto_batch[PROTO_FRAME_MAX];
+static uint8_t proto_batch_len = 0;
+static uint8_t proto_state_at = PROTO_NO_STATE; // Last message, if it is a STATE one
+
+// --- COBS ---
+// Replaces every 0x00 with the distance to the next one, so 0x00 only ever
+// appears as the frame delimiter.
+static uint16_t Proto_CobsEncode(const uint8_t *src, uint16_t len, uint8_t *dst) {
+    uint16_t out = 1;
+    uint16_t code_at = 0;
+    uint8_t code = 1;
+
+    for (uint16_t i = 0; i < len; i++) {
+        if (src[i] == 0) {
+            dst[code_at] = code;
+            code_at = out++;
+            code = 1;
+        } else {
+            dst[out++] = src[i];
+            if (++code == 0xFF) {
+                dst[code_at] = code;
+                code_at = out++;
+                code = 1;
+            }
+        }
+    }
+    dst[code_at] = code;
+    return out;
+}
+
+// In place: the output never overtakes the input. Returns 0 on a bad frame.
+static uint16_t Proto_CobsDecode(uint8_t *buf, uint16_t len) {
+    uint16_t in = 0;
+    uint16_t out = 0;
+
+    while (in < len) {
+        uint8_t code = buf[in++];
+        if (code == 0 || in + code - 1U > len) {
+            return 0;
+        }
+        for (uint8_t i = 1; i < code; i++) {
+            buf[out++] = buf[in++];
+        }
+        if (code != 0xFF && in < len) {
+            buf[out++] = 0;
+        }
+    }
+    return out;
+}
+
+// --- Transmit ---
+// Must be called with interrupts masked.
+static void Proto_FlushLocked(void) {
+    uint8_t wire[PROTO_WIRE_MAX];
+
+    if (proto_batch_len == 0) {
+        return;
+    }
+    uint16_t crc = Crc16(CRC16_INIT, proto_batch, proto_batch_len);
+    proto_batch[proto_batch_len] = (uint8_t)crc;
+    proto_batch[proto_batch_len + 1] = (uint8_t)(crc >> 8);
+    uint16_t len = Proto_CobsEncode(proto_batch, proto_batch_len + 2U, wire);
+    wire[len++] = 0;
+    UART_TxWrite(wire, len);
+    proto_batch_len = 0;
+    proto_state_at = PROTO_NO_STATE;
+}
+
+// Opens a message of the given payload length, flushing first if it does
+// not fit. Returns its offset in the batch. Interrupts masked.
+static uint8_t Proto_OpenLocked(uint8_t type, uint8_t len) {
+    if (proto_batch_len + 2U + len > PROTO_MSG_MAX) {
+        Proto_FlushLocked();
+    }
+    if (proto_batch_len == 0) {
+        Sched_Post(EVT_UART_FLUSH); // Sent once this scheduler pass is done
+    }
+    uint8_t at = proto_batch_len;
+    proto_batch[at] = type;
+    proto_batch[at + 1] = len;
+    proto_batch_len = (uint8_t)(at + 2U + len);
+    proto_state_at = PROTO_NO_STATE;
+    return at;
+}
+
+void Proto_SendText(const char *response, const char *value) {
+    uint8_t response_len = (uint8_t)strnlen(response, PROTO_MSG_MAX - 3);
+    uint8_t value_len = (uint8_t)strnlen(value, PROTO_MSG_MAX - 3 - response_len);
+    uint8_t len = (uint8_t)(response_len + 1U + value_len);
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint8_t *payload = &proto_batch[Proto_OpenLocked(PROTO_MSG_TEXT, len) + 2];
+    memcpy(payload, response, response_len);
+    payload[response_len] = ':';
+    memcpy(payload + response_len + 1, value, value_len);
+    PERF_LATENCY_HOLD(); // Timed once the batch is in the TX ring
+    __set_PRIMASK(primask);
+}
+
+void Proto_SendSignal(uint8_t signal, int32_t value) {
+    uint8_t entry[6];
+    uint8_t len = 0;
+    uint32_t zigzag = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+
+    entry[len++] = signal;
+    do {
+        uint8_t byte = zigzag & 0x7F;
+        zigzag >>= 7;
+        entry[len++] = zigzag ? (byte | 0x80) : byte;
+    } while (zigzag);
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (proto_state_at != PROTO_NO_STATE && proto_batch_len + len <= PROTO_MSG_MAX) {
+        // Extend the STATE message that ends the batch
+        proto_batch[proto_state_at + 1] += len;
+        memcpy(&proto_batch[proto_batch_len], entry, len);
+        proto_batch_len += len;
+    } else {
+        uint8_t at = Proto_OpenLocked(PROTO_MSG_STATE, len);
+        memcpy(&proto_batch[at + 2], entry, len);
+        proto_state_at = at;
+    }
+    PERF_LATENCY_HOLD();
+    __set_PRIMASK(primask);
+}
+
+void Proto_SendFrame(uint32_t stamp_us, uint32_t id, uint8_t dlc, const uint8_t *data) {
+    if (dlc > 8) {
+        dlc = 8; // DLC 9-15 still carries 8 data bytes
+    }
+    uint8_t len = (uint8_t)(9U + dlc);
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint8_t *payload = &proto_batch[Proto_OpenLocked(PROTO_MSG_FRAME, len) + 2];
+    memcpy(payload, &stamp_us, 4); // Cortex-M3 is little-endian
+    memcpy(payload + 4, &id, 4);
+    payload[8] = dlc;
+    memcpy(payload + 9, data, dlc);
+    __set_PRIMASK(primask);
+}
+
+void Proto_Flush(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    Proto_FlushLocked();
+    __set_PRIMASK(primask);
+}
+
+// --- Receive ---
+static void Proto_DispatchText(const uint8_t *payload, uint8_t len) {
+    char command[4] = {0};
+    char value[PROTO_FRAME_MAX] = {0};
+    const uint8_t *colon = memchr(payload, ':', len);
+    uint8_t command_len = colon ? (uint8_t)(colon - payload) : len;
+
+    memcpy(command, payload, command_len < 3 ? command_len : 3);
+    if (colon) {
+        memcpy(value, colon + 1, (size_t)(len - command_len - 1));
+    }
+    ProcessAndroidCommand(command, value);
+}
+
+bool Proto_Receive(uint8_t *frame, uint16_t len) {
+    len = Proto_CobsDecode(frame, len);
+    if (len < 2 || len > PROTO_FRAME_MAX) {
+        return false;
+    }
+    len -= 2;
+    if (Crc16(CRC16_INIT, frame, len) != (uint16_t)(frame[len] | (frame[len + 1] << 8))) {
+        return false;
+    }
+
+    // Check every length before running anything
+    uint16_t pos = 0;
+    while (pos < len) {
+        if (pos + 2U > len || pos + 2U + frame[pos + 1] > len) {
+            return false;
+        }
+        pos += 2U + frame[pos + 1];
+    }
+
+    for (pos = 0; pos < len; pos += 2U + frame[pos + 1]) {
+        if (frame[pos] == PROTO_MSG_TEXT) {
+            Proto_DispatchText(&frame[pos + 2], frame[pos + 1]);
+        } // Other types are not sent by the head unit and are ignored
+    }
+    return true;
+}
+
+bool Proto_IsBinary(void) {
+    return proto_binary;
+}
+
+void Proto_Command(const char *value) {
+    bool binary;
+    if (strcmp(value, "1") == 0) {
+        binary = true;
+    } else if (strcmp(value, "0") == 0) {
+        binary = false;
+    } else {
+        SendToAndroid(RESP_ERR, ERR_INVALID_COMMAND);
+        return;
+    }
+
+    // Acknowledge in the current mode, then switch. Anything queued before
+    // the switch still goes out in the old framing.
+    SendToAndroid(RESP_OK, CMD_BIN);
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    Proto_FlushLocked();
+    proto_binary = binary;
+    __set_PRIMASK(primask);
+}
+#else
+// QEMU talks over stdio: ASCII only
+bool Proto_IsBinary(void) {
+    return false;
+}
+
+void Proto_Command(const char *value) {
+    (void)value;
+    SendToAndroid(RESP_ERR, ERR_INVALID_COMMAND);
+}
+
+void Proto_SendText(const char *response, const char *value) {
+    (void)response;
+    (void)value;
+}
+
+void Proto_SendSignal(uint8_t signal, int32_t value) {
+    (void)signal;
+    (void)value;
+}
+
+void Proto_SendFrame(uint32_t stamp_us, uint32_t id, uint8_t dlc, const uint8_t *data) {
+    (void)stamp_us;
+    (void)id;
+    (void)dlc;
+    (void)data;
+}
+
+void Proto_Flush(void) {
+}
+
+bool Proto_Receive(uint8_t *frame, uint16_t len) {
+    (void)frame;
+    (void)len;
+    return false;
+}
+#endif // USE_QEMU
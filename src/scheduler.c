@@ -0,0 +1,163 @@
+#include "scheduler.h"
+#include "perf.h"
+
+#if (SCHED_WHEEL_SLOTS & (SCHED_WHEEL_SLOTS - 1)) != 0
+#error "SCHED_WHEEL_SLOTS must be a power of two"
+#endif
+
+#define SCHED_NO_TIMER 0xFF
+
+static volatile uint32_t sched_events;
+static SchedHandler sched_handlers[EVT_COUNT];
+#ifndef PERF_DISABLE
+static uint32_t sched_post_stamp[EVT_COUNT]; // CYCCNT when the bit was first set
+#endif
+
+// --- Timer Wheel ---
+// Timers are chained per slot (due & mask). A tick only walks the current
+// slot; timers that are not due yet (more than one turn away) stay put.
+// Only SysTick and Sched_StartTimer (IRQs masked) touch the wheel.
+typedef struct {
+    uint32_t due;
+    uint32_t period;
+    uint8_t event;
+    uint8_t next;
+} SchedTimer;
+
+static SchedTimer sched_timers[SCHED_MAX_TIMERS];
+static uint8_t sched_timer_count;
+static uint8_t sched_wheel[SCHED_WHEEL_SLOTS];
+static uint32_t sched_now;
+
+static void Sched_Link(uint8_t index) {
+    uint8_t slot = (uint8_t)(sched_timers[index].due & (SCHED_WHEEL_SLOTS - 1));
+    sched_timers[index].next = sched_wheel[slot];
+    sched_wheel[slot] = index;
+}
+
+void Sched_Init(void) {
+    sched_events = 0;
+    sched_timer_count = 0;
+    sched_now = 0;
+    for (uint8_t i = 0; i < SCHED_WHEEL_SLOTS; i++) {
+        sched_wheel[i] = SCHED_NO_TIMER;
+    }
+}
+
+void Sched_SetHandler(SchedEvent event, SchedHandler handler) {
+    sched_handlers[event] = handler;
+}
+
+bool Sched_StartTimer(SchedEvent event, uint32_t period_ms) {
+    if (sched_timer_count >= SCHED_MAX_TIMERS || period_ms == 0) {
+        return false;
+    }
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint8_t index = sched_timer_count++;
+    sched_timers[index].due = sched_now + period_ms;
+    sched_timers[index].period = period_ms;
+    sched_timers[index].event = (uint8_t)event;
+    Sched_Link(index);
+    __set_PRIMASK(primask);
+    return true;
+}
+
+void Sched_Post(SchedEvent event) {
+    uint32_t bit = 1UL << event;
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+#ifndef PERF_DISABLE
+    if (!(sched_events & bit)) {
+        sched_post_stamp[event] = DWT->CYCCNT;
+    }
+#endif
+    sched_events |= bit;
+    __set_PRIMASK(primask);
+}
+
+void Sched_Tick(void) {
+    uint8_t slot = (uint8_t)(++sched_now & (SCHED_WHEEL_SLOTS - 1));
+    uint8_t index = sched_wheel[slot];
+    uint8_t keep = SCHED_NO_TIMER;
+    uint8_t expired = SCHED_NO_TIMER;
+
+    // Split the slot into timers due now and timers for a later turn
+    while (index != SCHED_NO_TIMER) {
+        uint8_t next = sched_timers[index].next;
+        if (sched_timers[index].due == sched_now) {
+            sched_timers[index].next = expired;
+            expired = index;
+        } else {
+            sched_timers[index].next = keep;
+            keep = index;
+        }
+        index = next;
+    }
+    sched_wheel[slot] = keep;
+
+    while (expired != SCHED_NO_TIMER) {
+        uint8_t next = sched_timers[expired].next;
+        Sched_Post((SchedEvent)sched_timers[expired].event);
+        sched_timers[expired].due += sched_timers[expired].period;
+        Sched_Link(expired);
+        expired = next;
+    }
+}
+
+// The SysTick tick count plus how far the down-counter is into the current
+// millisecond. A reload that happened while interrupts are masked (or from a
+// higher-priority handler) shows as a pending SysTick with VAL already back
+// near LOAD; that millisecond is not in the tick count yet.
+uint32_t Sched_Micros(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t tick = HAL_GetTick();
+    uint32_t load = SysTick->LOAD;
+    uint32_t val = SysTick->VAL;
+    if ((SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) && val > load / 2U) {
+        tick++;
+    }
+    __set_PRIMASK(primask);
+    return tick * 1000U + (load - val) * 1000U / (load + 1U);
+}
+
+void Sched_RunOnce(void) {
+    uint32_t events;
+#ifndef PERF_DISABLE
+    uint32_t stamps[EVT_COUNT];
+#endif
+
+    // Race-free sleep: the check and the WFI run with interrupts masked. A
+    // pending interrupt still wakes the core, and is taken as soon as they
+    // are unmasked again.
+    PERF_START(SLEEP);
+    __disable_irq();
+    while (sched_events == 0) {
+        __WFI();
+        __enable_irq();
+        __ISB();
+        __disable_irq();
+    }
+    events = sched_events;
+    sched_events = 0;
+#ifndef PERF_DISABLE
+    for (uint8_t event = 0; event < EVT_COUNT; event++) {
+        stamps[event] = sched_post_stamp[event];
+    }
+#endif
+    __enable_irq();
+    PERF_STOP(SLEEP);
+
+    for (uint8_t event = 0; event < EVT_COUNT; event++) {
+        if (!(events & (1UL << event))) {
+            continue;
+        }
+#ifndef PERF_DISABLE
+        Perf_Record(PERF_EVENT_LATENCY, DWT->CYCCNT - stamps[event]);
+#endif
+        if (sched_handlers[event]) {
+            sched_handlers[event]();
+        }
+    }
+}
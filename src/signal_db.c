@@ -0,0 +1,170 @@
+#include "signal_db.h"
+#include "uart.h" // For SendToAndroid
+#include "scheduler.h"
+#include "proto.h"
+#include "keys.h"
+#include "perf.h"
+#include "status.h"
+#include <stdio.h>
+
+typedef struct {
+    const char *response;
+    const char *on;
+    const char *off;
+    int16_t scale;
+    int16_t min;
+    int16_t max;
+    int16_t hyst;
+    uint8_t byte;
+    uint8_t bit;
+    uint8_t len;
+    uint8_t kind;
+} SignalDef;
+
+static const SignalDef signal_defs[SIG_COUNT] = {
+#define SIGNAL_DEF(name, id, byte, bit, len, kind, scale, min, max, hyst, resp, on, off) \
+    { resp, on, off, scale, min, max, hyst, byte, bit, len, kind },
+    SIGNAL_TABLE(SIGNAL_DEF)
+#undef SIGNAL_DEF
+};
+
+static SignalState signal_state;
+
+uint32_t SignalDb_GetId(SignalId sig) {
+    switch (sig) {
+#define SIGNAL_ID(name, id, byte, bit, len, kind, scale, min, max, hyst, resp, on, off) \
+        case SIG_##name: return (id);
+        SIGNAL_TABLE(SIGNAL_ID)
+#undef SIGNAL_ID
+        default: return 0;
+    }
+}
+
+SignalMask SignalDb_GetState(void) {
+    return signal_state.bits;
+}
+
+int32_t SignalDb_GetValue(SignalId sig) {
+    if (signal_defs[sig].kind == SIGNAL_BOOL) {
+        return (signal_state.bits >> sig) & 1U;
+    }
+    return signal_state.value[sig];
+}
+
+// Extract a big-endian bit field; returns false if the frame is too short.
+static bool SignalDb_Extract(const SignalDef *def, const uint8_t *data, uint8_t data_len, uint32_t *raw) {
+    uint8_t nbytes = (uint8_t)((def->bit + def->len + 7) / 8);
+    uint32_t window = 0;
+
+    if (def->byte + nbytes > data_len) {
+        return false;
+    }
+    for (uint8_t i = 0; i < nbytes; i++) {
+        window = (window << 8) | data[def->byte + i];
+    }
+    *raw = (window >> def->bit) & ((1UL << def->len) - 1);
+    return true;
+}
+
+static void SignalDb_DecodeOne(uint8_t sig, const uint8_t *data, uint8_t data_len) {
+    const SignalDef *def = &signal_defs[sig];
+    uint32_t raw;
+
+    if (!SignalDb_Extract(def, data, data_len, &raw)) {
+        return;
+    }
+    PERF_LATENCY_SIGNAL(sig);
+
+    switch (def->kind) {
+        case SIGNAL_BOOL: {
+            bool on = (int32_t)raw >= def->min && (int32_t)raw <= def->max;
+            bool was_on = (signal_state.bits & ((SignalMask)1 << sig)) != 0;
+            if (on != was_on) {
+                signal_state.bits ^= ((SignalMask)1 << sig);
+                if (Status_Coalesce(sig)) {
+                    // Sent with the next !STS delta
+                } else if (Proto_IsBinary()) {
+                    Proto_SendSignal(sig, on);
+                } else {
+                    SendToAndroid(def->response, on ? def->on : def->off);
+                }
+                Sched_Post(EVT_OUTPUTS); // Outputs follow the state word
+            }
+            break;
+        }
+        case SIGNAL_VALUE: {
+            int32_t value = (int32_t)raw * def->scale;
+            int32_t delta = value - signal_state.value[sig];
+            if (delta < 0) {
+                delta = -delta;
+            }
+            if (delta != 0 && delta >= def->hyst) {
+                signal_state.value[sig] = value;
+                if (Status_Coalesce(sig)) {
+                    // Sent with the next !STS delta
+                } else if (Proto_IsBinary()) {
+                    Proto_SendSignal(sig, value);
+                } else {
+                    char buf[12];
+                    snprintf(buf, sizeof(buf), "%ld", (long)value);
+                    SendToAndroid(def->response, buf);
+                }
+            }
+            break;
+        }
+        case SIGNAL_KEY:
+            Keys_Update((uint8_t)raw); // Press/hold/release events come from keys.c
+            break;
+        default:
+            break;
+    }
+}
+
+// Bits of the payload, loaded little-endian into a uint64_t, that the given
+// signals read. Frames differing only outside them (alive counters,
+// checksums, other ECUs' fields) decode to the same result.
+uint64_t SignalDb_FieldMask(SignalMask signals) {
+    uint64_t mask = 0;
+
+    while (signals != 0) {
+        const SignalDef *def = &signal_defs[__builtin_ctzll(signals)];
+        uint8_t last = (uint8_t)(def->byte + (def->bit + def->len + 7) / 8 - 1);
+        signals &= signals - 1;
+        for (uint8_t k = def->bit; k < def->bit + def->len; k++) {
+            uint8_t byte = (uint8_t)(last - k / 8);
+            if (byte < 8) {
+                mask |= (uint64_t)1 << (byte * 8U + k % 8U);
+            }
+        }
+    }
+    return mask;
+}
+
+// Boolean signals that are on in this frame, without touching the
+// change-detection state: the frame is decoded again in the main loop.
+// Interrupt-safe (reads the constant table only).
+SignalMask SignalDb_Peek(SignalMask signals, const uint8_t *data, uint8_t data_len) {
+    SignalMask on = 0;
+
+    while (signals != 0) {
+        uint8_t sig = (uint8_t)__builtin_ctzll(signals);
+        const SignalDef *def = &signal_defs[sig];
+        uint32_t raw;
+        signals &= signals - 1;
+        if (def->kind == SIGNAL_BOOL && SignalDb_Extract(def, data, data_len, &raw) &&
+            (int32_t)raw >= def->min && (int32_t)raw <= def->max) {
+            on |= (SignalMask)1 << sig;
+        }
+    }
+    return on;
+}
+
+// Decode only the signals carried by this frame: the cost depends on the
+// number of signals in the frame, not on the size of the table.
+void SignalDb_Decode(SignalMask signals, const uint8_t *data, uint8_t data_len) {
+    while (signals != 0) {
+        uint8_t sig = (uint8_t)__builtin_ctzll(signals);
+        signals &= signals - 1;
+        SignalDb_DecodeOne(sig, data, data_len);
+    }
+}
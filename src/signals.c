@@ -1,4 +1,5 @@
 #include "signals.h"
+#include "signal_db.h"
 #ifndef USE_QEMU
 void GPIO_Status_Init(void) {
     __HAL_RCC_GPIOB_CLK_ENABLE(); // Enable GPIOB clock
@@ -34,27 +35,158 @@ void GPIO_Status_Init(void) {
     HAL_GPIO_Init(REAR_PORT, &GPIO_InitStruct);
 }
 
+// --- Output Driver ---
+// Change-driven: the decoder posts EVT_OUTPUTS when the state word changes
+// and the scheduler's periodic tick retries edges held back by a delay or a
+// minimum time. With nothing to do it returns after one comparison. All
+// edges due at the same time go out in one BSRR write.
+typedef struct {
+    uint16_t pin;
+    uint8_t signal;
+    uint16_t on_delay;
+    uint16_t off_delay;
+    uint16_t min_on;
+    uint16_t min_off;
+} OutputDef;
+
+static const OutputDef output_defs[] = {
+#define OUTPUT_DEF(name, pin, signal, on_delay, off_delay, min_on, min_off) \
+    { pin, signal, on_delay, off_delay, min_on, min_off },
+    OUTPUT_TABLE(OUTPUT_DEF)
+#undef OUTPUT_DEF
+};
+#define OUTPUT_COUNT (sizeof(output_defs) / sizeof(output_defs[0]))
+
+static SignalMask output_seen;       // State word at the last evaluation
+static bool output_pending;          // An edge is waiting for its time
+static uint16_t output_pins;         // Pins currently driven high
+static uint16_t output_switched;     // Pins switched since reset (minimum times apply)
+static uint32_t output_request_at[OUTPUT_COUNT]; // Signal changed
+static uint32_t output_edge_at[OUTPUT_COUNT];    // Pin last switched
+static uint16_t output_restored;     // Pins restored at boot, held until switched
+static uint16_t output_fast;         // Pins switched on by the fast path, not yet confirmed
+
+// Interrupts masked: the fast path switches pins from the FIFO1 interrupt
+static void Output_Write(uint32_t set, uint32_t reset) {
+    output_pins = (uint16_t)((output_pins | set) & ~reset);
+    output_switched |= (uint16_t)(set | reset);
+    output_restored &= (uint16_t)~(set | reset);
+    WRITE_REG(OUTPUT_PORT->BSRR, set | (reset << 16));
+    BKP->DR2 = output_pins;
+    BKP->DR1 = OUTPUT_BKP_MAGIC ^ output_pins;
+}
+
+// Runs before HAL_Init() and SystemClock_Config(): register writes only
+uint16_t GPIO_Status_Restore(void) {
+    uint16_t pins = 0;
+
+    __HAL_RCC_GPIOB_CLK_ENABLE();
+    __HAL_RCC_PWR_CLK_ENABLE();
+    __HAL_RCC_BKP_CLK_ENABLE();
+    HAL_PWR_EnableBkUpAccess(); // Left on: every output change writes the backup registers
+
+    uint16_t saved = (uint16_t)BKP->DR2;
+    if (((uint16_t)BKP->DR1 ^ saved) == OUTPUT_BKP_MAGIC) {
+        for (uint8_t i = 0; i < OUTPUT_COUNT; i++) {
+            pins |= saved & output_defs[i].pin;
+        }
+        // Set the output latch while the pins are still inputs, so they come
+        // up at the restored level without a glitch
+        WRITE_REG(OUTPUT_PORT->BSRR, pins);
+        output_pins = pins;
+        output_restored = pins;
+        output_pending = pins != 0; // Checked against the bus from the first EVT_OUTPUTS
+    }
+    GPIO_Status_Init();
+    return pins;
+}
+
 void CheckStatusSignals(void) {
-    // --- State variables are now static within this function ---
-    static bool ign_state_local = false;
-    static bool illum_state_local = false;
-    static bool park_state_local = false;
-    static bool rear_state_local = false;
-    //Removed, because door is handled in can.c
-    //static bool door_state_local = false;
+    SignalMask state = SignalDb_GetState();
+    if (state == output_seen && !output_pending && output_fast == 0) {
+        return; // A fast-path pin is checked on every pass until confirmed or given up
+    }
+
+    uint32_t now = HAL_GetTick();
+    uint32_t set = 0;
+    uint32_t reset = 0;
+    uint16_t confirmed = 0;
+    output_pending = false;
 
-    // --- Set IGN/ACC ---
-    HAL_GPIO_WritePin(IGN_PORT, IGN_PIN, ign_state_local ? GPIO_PIN_SET : GPIO_PIN_RESET);
+    for (uint8_t i = 0; i < OUTPUT_COUNT; i++) {
+        const OutputDef *def = &output_defs[i];
+        SignalMask bit = (SignalMask)1 << def->signal;
+        bool want = (state & bit) != 0;
+        bool on = (output_pins & def->pin) != 0;
 
-    // --- Set ILLUM ---
-    HAL_GPIO_WritePin(ILLUM_PORT, ILLUM_PIN, illum_state_local ? GPIO_PIN_SET : GPIO_PIN_RESET);
+        if ((state ^ output_seen) & bit) {
+            output_request_at[i] = now;
+        }
+        if (output_fast & def->pin) {
+            // Switched on ahead of the decoder: keep it until the decoded
+            // state agrees, or give up after OUTPUT_FAST_CONFIRM_MS
+            if (want || now - output_edge_at[i] >= OUTPUT_FAST_CONFIRM_MS) {
+                confirmed |= def->pin;
+            } else {
+                output_pending = true;
+                continue;
+            }
+        }
+        if (want == on) {
+            continue; // Also cancels an edge that was still being delayed
+        }
 
-    // --- Set PARK ---
-    HAL_GPIO_WritePin(PARK_PORT, PARK_PIN, park_state_local ? GPIO_PIN_SET : GPIO_PIN_RESET);
+        // The edge is due once the signal has been stable for the delay and
+        // the pin has held its current level for its minimum time
+        uint32_t delay_end = output_request_at[i] + (want ? def->on_delay : def->off_delay);
+        uint32_t hold_end = output_edge_at[i] + (on ? def->min_on : def->min_off);
+        if ((int32_t)(now - delay_end) < 0 ||
+            ((output_switched & def->pin) && (int32_t)(now - hold_end) < 0) ||
+            ((output_restored & def->pin) && now < OUTPUT_BOOT_HOLD_MS)) {
+            output_pending = true;
+            continue;
+        }
+
+        output_edge_at[i] = now;
+        if (want) {
+            set |= def->pin;
+        } else {
+            reset |= def->pin;
+        }
+    }
+    output_seen = state;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    output_fast &= (uint16_t)~confirmed;
+    reset &= ~(uint32_t)output_fast; // Switched on by the fast path since the loop looked
+    if (set | reset) {
+        Output_Write(set, reset);
+    }
+    __set_PRIMASK(primask);
+}
 
-    // --- Set REAR ---
-    HAL_GPIO_WritePin(REAR_PORT, REAR_PIN, rear_state_local ? GPIO_PIN_SET : GPIO_PIN_RESET);
+// FIFO1 interrupt: switch on the outputs whose signal the frame turns on,
+// where no on-delay or minimum off time stands in the way. Switching off is
+// left to CheckStatusSignals() and its delays.
+uint16_t GPIO_Status_FastPath(SignalMask signals, SignalMask on) {
+    uint32_t now = HAL_GetTick();
+    uint16_t set = 0;
 
-    //No need to set door status, it is just for information.
+    for (uint8_t i = 0; i < OUTPUT_COUNT; i++) {
+        const OutputDef *def = &output_defs[i];
+        SignalMask bit = (SignalMask)1 << def->signal;
+        if (!(signals & bit) || !(on & bit) || (output_pins & def->pin) || def->on_delay != 0 ||
+            ((output_switched & def->pin) && now - output_edge_at[i] < def->min_off)) {
+            continue;
+        }
+        output_edge_at[i] = now;
+        set |= def->pin;
+    }
+    if (set != 0) {
+        Output_Write(set, 0); // Nothing that switches outputs can preempt this interrupt
+        output_fast |= set;
+    }
+    return set;
 }
 #endif // Not USE_QEMU
@@ -0,0 +1,247 @@
+#include "sniffer.h"
+#include "can_filter.h"
+#include "proto.h"
+#include "uart.h" // For SendToAndroid, UART_TxFree
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef USE_QEMU
+#if (SNIFFER_ID_SLOTS & (SNIFFER_ID_SLOTS - 1)) != 0
+#error "SNIFFER_ID_SLOTS must be a power of two"
+#endif
+
+typedef struct {
+    uint32_t id;
+    bool used;
+    bool forwarded;     // data/dlc hold the last frame sent for this ID
+    uint16_t divisor;
+    uint16_t phase;     // Frames since the last one that passed decimation
+    uint8_t dlc;
+    uint8_t data[8];
+} SnifferSlot;
+
+static bool sniffer_active = false;
+static bool sniffer_changes_only = false;
+static uint16_t sniffer_divisor = 1; // Given to IDs seen for the first time
+static SnifferSlot sniffer_slots[SNIFFER_ID_SLOTS];
+static uint32_t sniffer_credits;     // In 1/1000 byte, so slow refills are not rounded away
+static uint32_t sniffer_refill_tick;
+static SnifferStats sniffer_stats;
+
+static const char *const sniffer_counter_tags[] = {
+#define SNIFFER_COUNTER_TAG(name, tag) tag,
+    SNIFFER_COUNTERS(SNIFFER_COUNTER_TAG)
+#undef SNIFFER_COUNTER_TAG
+};
+
+// Open addressing on a multiplicative hash; slots are never freed, the
+// table only fills up with the IDs present on the bus.
+static SnifferSlot *Sniffer_Slot(uint32_t id) {
+    uint32_t hash = (id * 2654435761U) >> 16;
+
+    for (uint32_t n = 0; n < SNIFFER_ID_SLOTS; n++) {
+        SnifferSlot *slot = &sniffer_slots[(hash + n) & (SNIFFER_ID_SLOTS - 1)];
+        if (!slot->used) {
+            slot->id = id;
+            slot->used = true;
+            slot->forwarded = false;
+            slot->divisor = sniffer_divisor;
+            slot->phase = 0;
+            return slot;
+        }
+        if (slot->id == id) {
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+// Spend cost bytes of credit if there is enough of it and of UART ring.
+static bool Sniffer_TakeCredit(uint32_t cost) {
+    uint32_t now = HAL_GetTick();
+    uint32_t elapsed = now - sniffer_refill_tick;
+
+    sniffer_refill_tick = now;
+    if (elapsed > 1000U) {
+        elapsed = 1000U; // More than refills the bucket anyway
+    }
+    sniffer_credits += elapsed * SNIFFER_BYTES_PER_SEC;
+    if (sniffer_credits > SNIFFER_CREDIT_MAX * 1000U) {
+        sniffer_credits = SNIFFER_CREDIT_MAX * 1000U;
+    }
+
+    if (cost * 1000U > sniffer_credits || UART_TxFree() < SNIFFER_TX_RESERVE + cost) {
+        return false;
+    }
+    sniffer_credits -= cost * 1000U;
+    return true;
+}
+
+void Sniffer_Forward(const CanRxFrame *frame) {
+    SnifferSlot *slot = Sniffer_Slot(frame->id);
+    uint8_t dlc = frame->dlc > CAN_RX_MAX_DLC ? CAN_RX_MAX_DLC : frame->dlc; // Every ID passes here
+
+    sniffer_stats.seen++;
+    if (slot == NULL) {
+        sniffer_stats.untracked++;
+    } else {
+        uint16_t phase = slot->phase;
+        slot->phase = (uint16_t)((phase + 1U) % slot->divisor);
+        if (phase != 0) {
+            sniffer_stats.decimated++;
+            return;
+        }
+        if (sniffer_changes_only && slot->forwarded && slot->dlc == dlc &&
+            memcmp(slot->data, frame->data, dlc) == 0) {
+            sniffer_stats.unchanged++;
+            return;
+        }
+    }
+
+    if (Proto_IsBinary()) {
+        if (!Sniffer_TakeCredit(2U + 9U + dlc)) {
+            sniffer_stats.dropped++;
+            return;
+        }
+        Proto_SendFrame(frame->stamp_us, frame->id, dlc, frame->data);
+    } else {
+        static const char hex[] = "0123456789ABCDEF";
+        char value[48]; // Extended ID: 20 characters of prefix, 16 of data
+        int len;
+        if (frame->id & CAN_RX_ID_EXT) {
+            len = snprintf(value, sizeof(value), "%08lX,%08lX,%u,", (unsigned long)frame->stamp_us,
+                           (unsigned long)(frame->id & ~CAN_RX_ID_EXT), dlc);
+        } else {
+            len = snprintf(value, sizeof(value), "%08lX,%03lX,%u,", (unsigned long)frame->stamp_us,
+                           (unsigned long)frame->id, dlc);
+        }
+        for (uint8_t i = 0; i < dlc; i++) {
+            value[len++] = hex[frame->data[i] >> 4];
+            value[len++] = hex[frame->data[i] & 0x0F];
+        }
+        value[len] = '\0';
+        if (!Sniffer_TakeCredit((uint32_t)len + 6U)) { // "!SNF:" and '\n'
+            sniffer_stats.dropped++;
+            return;
+        }
+        SendToAndroid(RESP_SNIFF, value);
+    }
+
+    sniffer_stats.sent++;
+    if (slot != NULL) {
+        slot->forwarded = true;
+        slot->dlc = dlc;
+        memcpy(slot->data, frame->data, dlc);
+    }
+}
+
+bool Sniffer_IsActive(void) {
+    return sniffer_active;
+}
+
+void Sniffer_GetStats(SnifferStats *stats) {
+    *stats = sniffer_stats;
+}
+
+static bool Sniffer_Start(bool on) {
+    if (!CAN_Filter_SetSniffer(on)) {
+        return false;
+    }
+    if (on && !sniffer_active) {
+        memset(&sniffer_stats, 0, sizeof(sniffer_stats));
+        for (uint32_t i = 0; i < SNIFFER_ID_SLOTS; i++) {
+            sniffer_slots[i].forwarded = false; // First frame of every ID goes out
+            sniffer_slots[i].phase = 0;
+        }
+        sniffer_credits = SNIFFER_CREDIT_MAX * 1000U;
+        sniffer_refill_tick = HAL_GetTick();
+    }
+    sniffer_active = on;
+    return true;
+}
+
+// "<n>" for every ID or "<id>:<n>" for one
+static bool Sniffer_SetDivisor(const char *arg) {
+    char *end;
+    unsigned long first = strtoul(arg, &end, 16);
+
+    if (*end == ':') {
+        char *end_n;
+        unsigned long n = strtoul(end + 1, &end_n, 10);
+        if (end == arg || *end_n != '\0' || n == 0 || n > 0xFFFF) {
+            return false;
+        }
+        SnifferSlot *slot = Sniffer_Slot((uint32_t)first);
+        if (slot == NULL) {
+            return false; // Table full
+        }
+        slot->divisor = (uint16_t)n;
+        slot->phase = 0;
+        return true;
+    }
+
+    unsigned long n = strtoul(arg, &end, 10);
+    if (end == arg || *end != '\0' || n == 0 || n > 0xFFFF) {
+        return false;
+    }
+    sniffer_divisor = (uint16_t)n;
+    for (uint32_t i = 0; i < SNIFFER_ID_SLOTS; i++) {
+        sniffer_slots[i].divisor = sniffer_divisor;
+        sniffer_slots[i].phase = 0;
+    }
+    return true;
+}
+
+static void Sniffer_SendCounters(void) {
+    const uint32_t *counters = (const uint32_t *)&sniffer_stats;
+    char line[24];
+
+    for (uint8_t i = 0; i < sizeof(sniffer_counter_tags) / sizeof(sniffer_counter_tags[0]); i++) {
+        snprintf(line, sizeof(line), "%s,%lu", sniffer_counter_tags[i], (unsigned long)counters[i]);
+        SendToAndroid(RESP_SNIFF, line);
+    }
+    SendToAndroid(RESP_SNIFF, "END");
+}
+
+void Sniffer_Command(const char *value) {
+    bool ok;
+
+    if (strcmp(value, "1") == 0 || strcmp(value, "0") == 0) {
+        if (!Sniffer_Start(value[0] == '1')) {
+            SendToAndroid(RESP_ERR, ERR_CAN_ERROR);
+            return;
+        }
+        ok = true;
+    } else if (strcmp(value, "CHG:1") == 0 || strcmp(value, "CHG:0") == 0) {
+        sniffer_changes_only = value[4] == '1';
+        ok = true;
+    } else if (strncmp(value, "DIV:", 4) == 0) {
+        ok = Sniffer_SetDivisor(value + 4);
+    } else if (strcmp(value, "CNT") == 0) {
+        Sniffer_SendCounters();
+        return;
+    } else {
+        ok = false;
+    }
+    SendToAndroid(ok ? RESP_OK : RESP_ERR, ok ? CMD_SNIFF : ERR_INVALID_COMMAND);
+}
+#else
+// No acceptance filters to open in the QEMU build
+bool Sniffer_IsActive(void) {
+    return false;
+}
+
+void Sniffer_Forward(const CanRxFrame *frame) {
+    (void)frame;
+}
+
+void Sniffer_Command(const char *value) {
+    (void)value;
+    SendToAndroid(RESP_ERR, ERR_INVALID_COMMAND);
+}
+
+void Sniffer_GetStats(SnifferStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+}
+#endif // USE_QEMU
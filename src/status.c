@@ -0,0 +1,115 @@
+#include "status.h"
+#include "signal_db.h" // For SignalDb_GetValue
+#include "uart.h" // For SendToAndroid
+#include "proto.h" // For Proto_SendSignal
+#include "scheduler.h" // For Sched_Post
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+    const char *response;
+    const char *on;
+    const char *off;
+    uint8_t kind;
+} StatusField;
+
+static const StatusField status_fields[SIG_COUNT] = {
+#define STATUS_FIELD(name, id, byte, bit, len, kind, scale, min, max, hyst, resp, on, off) { resp, on, off, kind },
+    SIGNAL_TABLE(STATUS_FIELD)
+#undef STATUS_FIELD
+};
+
+// Signals with a state to report: everything but the keys
+#define STATUS_SIGNAL(name, id, byte, bit, len, kind, scale, min, max, hyst, resp, on, off) \
+    | ((kind) != SIGNAL_KEY ? SIG_BIT(name) : 0)
+#define STATUS_SIGNALS (0 SIGNAL_TABLE(STATUS_SIGNAL))
+
+// Longest field of each signal, separator included: ",<resp>=<value>",
+// with a SIGNAL_VALUE printed as a full int32_t ("-2147483648")
+#define STATUS_FIELD_MAX(name, id, byte, bit, len, kind, scale, min, max, hyst, resp, on, off) \
+    + ((kind) == SIGNAL_KEY ? 0                                                              \
+       : sizeof(resp) + 1 + ((kind) == SIGNAL_VALUE ? 11                                       \
+                             : (sizeof(on) > sizeof(off) ? sizeof(on) : sizeof(off)) - 1))
+#define STATUS_LINE_MAX (0 SIGNAL_TABLE(STATUS_FIELD_MAX))
+
+_Static_assert(sizeof("!" RESP_STATUS ":") + STATUS_LINE_MAX + 1 <= UART_TX_LINE_SIZE,
+               "A full !STS line must fit one SendToAndroid() line");
+
+static bool status_deltas;         // !STS:CHG:1
+static SignalMask status_pending;  // Changed since the window opened
+static uint32_t status_opened;     // HAL_GetTick() of the window's first change
+
+// Main loop only, like the decoder that feeds it
+static void Status_Send(SignalMask signals) {
+    if (Proto_IsBinary()) {
+        while (signals != 0) {
+            uint8_t sig = (uint8_t)__builtin_ctzll(signals);
+            signals &= signals - 1;
+            Proto_SendSignal(sig, SignalDb_GetValue((SignalId)sig));
+        }
+        return;
+    }
+
+    char line[STATUS_LINE_MAX + 1];
+    int pos = 0;
+    while (signals != 0 && pos < (int)sizeof(line)) {
+        uint8_t sig = (uint8_t)__builtin_ctzll(signals);
+        const StatusField *field = &status_fields[sig];
+        int32_t value = SignalDb_GetValue((SignalId)sig);
+        signals &= signals - 1;
+        if (field->kind == SIGNAL_BOOL) {
+            pos += snprintf(&line[pos], sizeof(line) - (size_t)pos, "%s%s=%s", pos ? "," : "",
+                            field->response, value ? field->on : field->off);
+        } else {
+            pos += snprintf(&line[pos], sizeof(line) - (size_t)pos, "%s%s=%ld", pos ? "," : "",
+                            field->response, (long)value);
+        }
+    }
+    SendToAndroid(RESP_STATUS, line);
+}
+
+bool Status_Coalesce(uint8_t sig) {
+    if (!status_deltas) {
+        return false;
+    }
+    if (status_pending == 0) {
+        status_opened = HAL_GetTick();
+        if (config_sts_win_ms == 0) {
+            Sched_Post(EVT_STATUS); // Sent after the rest of this pass
+        }
+    }
+    status_pending |= (SignalMask)1 << sig;
+    return true;
+}
+
+void Status_Service(void) {
+    if (status_pending == 0 || HAL_GetTick() - status_opened < config_sts_win_ms) {
+        return;
+    }
+    SignalMask changed = status_pending;
+    status_pending = 0;
+    Status_Send(changed);
+}
+
+void Status_Command(const char *value) {
+    bool ok;
+
+    if (value[0] == '\0' || strcmp(value, "GET") == 0) {
+        status_pending = 0; // The snapshot carries them
+        Status_Send(STATUS_SIGNALS);
+        return;
+    } else if (strcmp(value, "CHG:1") == 0) {
+        status_deltas = true;
+        ok = true;
+    } else if (strcmp(value, "CHG:0") == 0) {
+        if (status_pending != 0) {
+            Status_Send(status_pending);
+            status_pending = 0;
+        }
+        status_deltas = false;
+        ok = true;
+    } else {
+        ok = false;
+    }
+    SendToAndroid(ok ? RESP_OK : RESP_ERR, ok ? CMD_STATUS : ERR_INVALID_COMMAND);
+}
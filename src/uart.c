@@ -1,10 +1,68 @@
 #include "uart.h"
 #include "commands.h" // For ProcessAndroidCommand
+#include "perf.h"
+#include "scheduler.h"
+#include "proto.h"
+
+#include <stdio.h>
+#include <string.h>
 
 #ifndef USE_QEMU
 UART_HandleTypeDef huart1; // Define huart1 here
+static DMA_HandleTypeDef hdma_usart1_tx;
+
+// --- UART TX Queue ---
+// Outbound byte ring drained by USART1 TX DMA. Indices are free-running;
+// tx_inflight is the length of the chunk currently owned by the DMA (0 = idle).
+// All updates happen with interrupts masked, so writers may be in thread or
+// interrupt context.
+#if (UART_TX_RING_SIZE & (UART_TX_RING_SIZE - 1)) != 0
+#error "UART_TX_RING_SIZE must be a power of two"
+#endif
+static uint8_t tx_ring[UART_TX_RING_SIZE];
+static volatile uint32_t tx_head = 0;
+static volatile uint32_t tx_tail = 0;
+static volatile uint32_t tx_inflight = 0;
+static volatile UartTxStats tx_stats;
+
+static void UART_TxKick(void);
+
+// --- UART RX (circular DMA) ---
+// DMA1 Channel 5 writes into rx_dma_buf forever. The interrupts (USART IDLE,
+// DMA half/full) only scan the new bytes for '\n' or 0x00 (the binary frame
+// delimiter) and publish the position just after the last one in
+// rx_line_end. ReceiveFromAndroid() consumes up to that position from the
+// main loop and splits lines or frames according to the protocol mode.
+//
+// Positions are free-running byte counts (index & (UART_RX_DMA_SIZE - 1)), so
+// the interrupts can tell when the DMA has lapped a stalled main loop: more
+// than UART_RX_DMA_SIZE bytes unread means the oldest ones were overwritten.
+// The reader then resumes half a buffer behind the DMA: the half and full
+// transfer interrupts scan at least every half buffer, so those bytes are
+// still intact and a lap while reading them is caught by the next interrupt.
+// The line cut at the resync point is discarded as an overflow; complete
+// lines after it are still handled.
+#if (UART_RX_DMA_SIZE & (UART_RX_DMA_SIZE - 1)) != 0
+#error "UART_RX_DMA_SIZE must be a power of two"
+#endif
+static DMA_HandleTypeDef hdma_usart1_rx;
+static uint8_t rx_dma_buf[UART_RX_DMA_SIZE];
+static uint32_t rx_scan_pos = 0;              // ISR: next byte to scan
+static volatile uint32_t rx_line_end = 0;     // ISR -> main: end of last complete line
+static volatile bool rx_restart = false;      // ISR -> main: DMA stopped on error
+static volatile bool rx_lapped = false;       // ISR -> main: unread bytes were overwritten
+static volatile uint32_t rx_resync_pos = 0;   // ISR -> main: where reading resumes after a lap
+static volatile uint32_t rx_read_pos = 0;     // Main: next byte to consume
+static char rx_line[UART_RX_LINE_SIZE];
+static uint32_t rx_line_len = 0;
+static bool rx_line_overflow = false;
+static volatile UartRxStats rx_stats;
+
+static void UART_RxStart(void);
 #endif
 
+static void UART_DispatchLine(char *line);
+
 void UART_Init(void) {
 // ... (All the UART initialization code from the original main.c) ...
     __HAL_RCC_USART1_CLK_ENABLE();
@@ -38,44 +96,216 @@ void UART_Init(void) {
         Error_Handler();
     }
 
-    // Enable UART RX interrupt
-    HAL_NVIC_SetPriority(USART1_IRQn, 0, 0);
+    // --- TX DMA (DMA1 Channel 4) ---
+    __HAL_RCC_DMA1_CLK_ENABLE();
+    hdma_usart1_tx.Instance = DMA1_Channel4;
+    hdma_usart1_tx.Init.Direction = DMA_MEMORY_TO_PERIPH;
+    hdma_usart1_tx.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_usart1_tx.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_usart1_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma_usart1_tx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    hdma_usart1_tx.Init.Mode = DMA_NORMAL;
+    hdma_usart1_tx.Init.Priority = DMA_PRIORITY_LOW;
+    if (HAL_DMA_Init(&hdma_usart1_tx) != HAL_OK) {
+        Error_Handler();
+    }
+    __HAL_LINKDMA(&huart1, hdmatx, hdma_usart1_tx);
+
+    HAL_NVIC_SetPriority(DMA1_Channel4_IRQn, IRQ_PRIO_UART, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Channel4_IRQn);
+
+    // --- RX DMA (DMA1 Channel 5, circular) ---
+    hdma_usart1_rx.Instance = DMA1_Channel5;
+    hdma_usart1_rx.Init.Direction = DMA_PERIPH_TO_MEMORY;
+    hdma_usart1_rx.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_usart1_rx.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_usart1_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma_usart1_rx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    hdma_usart1_rx.Init.Mode = DMA_CIRCULAR;
+    hdma_usart1_rx.Init.Priority = DMA_PRIORITY_MEDIUM;
+    if (HAL_DMA_Init(&hdma_usart1_rx) != HAL_OK) {
+        Error_Handler();
+    }
+    __HAL_LINKDMA(&huart1, hdmarx, hdma_usart1_rx);
+
+    HAL_NVIC_SetPriority(DMA1_Channel5_IRQn, IRQ_PRIO_UART, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Channel5_IRQn);
+
+    // Enable UART interrupt (IDLE line, errors and TX completion only;
+    // received bytes are moved by the DMA)
+    HAL_NVIC_SetPriority(USART1_IRQn, IRQ_PRIO_UART, 0);
     HAL_NVIC_EnableIRQ(USART1_IRQn);
-    __HAL_UART_ENABLE_IT(&huart1, UART_IT_RXNE);
+    UART_RxStart();
 }
 #ifndef USE_QEMU
-void USART1_IRQHandler(void) {
- // ... (All the UART RX interrupt handler code) ...
-     if (__HAL_UART_GET_FLAG(&huart1, UART_FLAG_RXNE)) {
-        static uint8_t rx_buffer[64];
-        static uint8_t rx_index = 0;
-        uint8_t received_byte = (uint8_t)(huart1.Instance->DR & 0xFF);
-
-        if (received_byte == '\n') {
-            rx_buffer[rx_index] = '\0'; // Null-terminate
-            char command[4] = {0};
-            char value[32] = {0};
-            char *token;
-            char *saveptr;
-
-            token = strtok_r((char *)rx_buffer, ":\n", &saveptr);
-            if (token != NULL && token[0] == '!') {
-                strncpy(command, token + 1, 3);
-                token = strtok_r(NULL, ":\n", &saveptr);
-                if (token != NULL) {
-                    strncpy(value, token, sizeof(value) - 1);
-                }
-                ProcessAndroidCommand(command, value);
-            }
-            rx_index = 0; // Reset for the next message.
-        } else {
-            if (rx_index < sizeof(rx_buffer) - 1) {
-                rx_buffer[rx_index++] = received_byte;
-            } // else:  Buffer overflow - handle or ignore
+static void UART_RxStart(void) {
+    rx_scan_pos = 0;
+    rx_line_end = 0;
+    rx_lapped = false;
+    rx_read_pos = 0;
+    rx_line_len = 0;
+    rx_line_overflow = false;
+    if (HAL_UART_Receive_DMA(&huart1, rx_dma_buf, UART_RX_DMA_SIZE) != HAL_OK) {
+        Error_Handler();
+    }
+    __HAL_UART_CLEAR_IDLEFLAG(&huart1);
+    __HAL_UART_ENABLE_IT(&huart1, UART_IT_IDLE);
+}
+
+// Scan what the DMA wrote since the last call and publish the end of the last
+// complete line. Runs from the USART and DMA interrupts (same priority).
+static void UART_RxPublish(void) {
+    uint32_t dma_index = (UART_RX_DMA_SIZE - __HAL_DMA_GET_COUNTER(huart1.hdmarx)) & (UART_RX_DMA_SIZE - 1);
+    uint32_t pos = rx_scan_pos;
+    uint32_t dma_pos = pos + ((dma_index - pos) & (UART_RX_DMA_SIZE - 1));
+    uint32_t line_end = rx_line_end;
+
+    while (pos != dma_pos) {
+        uint8_t byte = rx_dma_buf[pos & (UART_RX_DMA_SIZE - 1)];
+        pos++;
+        if (byte == '\n' || byte == 0) {
+            line_end = pos;
         }
-        __HAL_UART_CLEAR_FLAG(&huart1, UART_FLAG_RXNE);
+    }
+    rx_scan_pos = pos;
+    if (dma_pos - rx_read_pos > UART_RX_DMA_SIZE) {
+        rx_resync_pos = dma_pos - UART_RX_DMA_SIZE / 2;
+        rx_lapped = true;
+        Sched_Post(EVT_UART_RX);
+    }
+    if (line_end != rx_line_end) {
+        rx_line_end = line_end;
+        Sched_Post(EVT_UART_RX);
+    }
+}
+
+void USART1_IRQHandler(void) {
+    PERF_START(UART_ISR);
+    if (__HAL_UART_GET_FLAG(&huart1, UART_FLAG_IDLE)) {
+        __HAL_UART_CLEAR_IDLEFLAG(&huart1);
+        UART_RxPublish();
     }
     HAL_UART_IRQHandler(&huart1);
+    PERF_STOP(UART_ISR);
+}
+
+void DMA1_Channel5_IRQHandler(void) {
+    HAL_DMA_IRQHandler(&hdma_usart1_rx);
+}
+
+void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef *huart) {
+    if (huart->Instance == USART1) {
+        UART_RxPublish();
+    }
+}
+
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart) {
+    if (huart->Instance == USART1) {
+        UART_RxPublish(); // Circular mode: the DMA has already wrapped
+    }
+}
+
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart) {
+    // The HAL stops the RX DMA on overrun/framing errors; restart it from the
+    // main loop so the consumer state is reset in one place.
+    if (huart->Instance == USART1) {
+        rx_stats.errors++;
+        rx_restart = true;
+        Sched_Post(EVT_UART_RX);
+    }
+}
+
+void UART_RxGetStats(UartRxStats *stats) {
+    stats->lines = rx_stats.lines;
+    stats->overflows = rx_stats.overflows;
+    stats->errors = rx_stats.errors;
+    stats->bad_frames = rx_stats.bad_frames;
+}
+
+void DMA1_Channel4_IRQHandler(void) {
+    HAL_DMA_IRQHandler(&hdma_usart1_tx);
+}
+
+// Start the DMA on the next contiguous run of queued bytes, if it is idle.
+// Must be called with interrupts masked.
+static void UART_TxKick(void) {
+    uint32_t used = tx_head - tx_tail;
+    uint32_t offset = tx_tail & (UART_TX_RING_SIZE - 1);
+    uint32_t chunk;
+
+    if (tx_inflight != 0 || used == 0) {
+        return;
+    }
+
+    chunk = UART_TX_RING_SIZE - offset; // Stop at the end of the buffer
+    if (chunk > used) {
+        chunk = used;
+    }
+
+    tx_inflight = chunk;
+    if (HAL_UART_Transmit_DMA(&huart1, &tx_ring[offset], (uint16_t)chunk) != HAL_OK) {
+        tx_inflight = 0; // Retried on the next write
+    }
+}
+
+// Called by the HAL on USART TC after the last DMA byte has left the shifter.
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart) {
+    if (huart->Instance != USART1) {
+        return;
+    }
+    tx_tail += tx_inflight;
+    PERF_LATENCY_SENT(tx_tail); // The last byte has just left the shifter
+    tx_stats.bytes_sent += tx_inflight;
+    PERF_COUNT(UART_BYTES, tx_inflight);
+    tx_inflight = 0;
+    UART_TxKick(); // Chain the next chunk (e.g. the part after the wrap)
+}
+
+bool UART_TxWrite(const uint8_t *data, uint16_t len) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint32_t used = tx_head - tx_tail;
+    if (len > UART_TX_RING_SIZE - used) {
+        // Drop-newest: the whole message is rejected so the head unit never
+        // sees a truncated line.
+        tx_stats.dropped_msgs++;
+        tx_stats.dropped_bytes += len;
+        PERF_LATENCY_DISCARD();
+        __set_PRIMASK(primask);
+        return false;
+    }
+
+    uint32_t offset = tx_head & (UART_TX_RING_SIZE - 1);
+    uint32_t first = UART_TX_RING_SIZE - offset;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(&tx_ring[offset], data, first);
+    memcpy(&tx_ring[0], data + first, len - first);
+    tx_head += len;
+    PERF_LATENCY_QUEUED(tx_head);
+
+    tx_stats.bytes_queued += len;
+    if (used + len > tx_stats.high_water) {
+        tx_stats.high_water = used + len;
+    }
+
+    UART_TxKick();
+    __set_PRIMASK(primask);
+    return true;
+}
+
+uint32_t UART_TxFree(void) {
+    return UART_TX_RING_SIZE - (tx_head - tx_tail);
+}
+
+void UART_TxGetStats(UartTxStats *stats) {
+    stats->bytes_queued = tx_stats.bytes_queued;
+    stats->bytes_sent = tx_stats.bytes_sent;
+    stats->dropped_msgs = tx_stats.dropped_msgs;
+    stats->dropped_bytes = tx_stats.dropped_bytes;
+    stats->high_water = tx_stats.high_water;
 }
 #endif
 
@@ -84,39 +314,120 @@ void SendToAndroid(const char *response, const char *value) {
     printf("!%s:%s\n", response, value);
     fflush(stdout);
 #else
-    char message[64];
-    snprintf(message, sizeof(message), "!%s:%s\n", response, value);
-    HAL_UART_Transmit(&huart1, (uint8_t *)message, strlen(message), HAL_MAX_DELAY);
+    // Only formats and queues, the DMA does the rest. Safe from any context.
+    PERF_START(UART_SEND);
+    if (Proto_IsBinary()) {
+        Proto_SendText(response, value); // Batched into the next binary frame
+        PERF_STOP(UART_SEND);
+        return;
+    }
+    char message[UART_TX_LINE_SIZE];
+    int len = snprintf(message, sizeof(message), "!%s:%s\n", response, value);
+    if (len >= 0) { // Nothing to send on an encoding error, but the section still closes
+        if (len >= (int)sizeof(message)) {
+            len = sizeof(message) - 1;
+            message[len - 1] = '\n'; // Keep the line terminated when truncated
+        }
+        PERF_LATENCY_HOLD(); // Time it if a received frame caused it
+        UART_TxWrite((const uint8_t *)message, (uint16_t)len);
+    }
+    PERF_STOP(UART_SEND);
 #endif
 }
 
+// Split "!CMD:value" and hand it to the command dispatcher. The value is the
+// rest of the line, so multi-field values such as "SET:ign_src:0x36" survive.
+static void UART_DispatchLine(char *line) {
+    char command[4] = {0};
+    char value[UART_RX_LINE_SIZE] = {0};
+    char *token;
+    char *saveptr;
+
+    token = strtok_r(line, ":\r\n", &saveptr);
+    if (token != NULL && token[0] == '!') {
+        strncpy(command, token + 1, 3);
+        token = strtok_r(NULL, "\r\n", &saveptr);
+        if (token != NULL) {
+            strncpy(value, token, sizeof(value) - 1);
+        }
+        ProcessAndroidCommand(command, value);
+    }
+}
+
 void ReceiveFromAndroid(void) {
 #ifndef USE_QEMU
-    // UART RX is interrupt-driven, so this function is empty in the real HW build
-#else
- // QEMU version - Reads from stdin
-    // ... (QEMU stdin handling - Remains unchanged) ...
-     char buffer[256];
-    if (fgets(buffer, sizeof(buffer), stdin) != NULL) {
-        size_t len = strlen(buffer);
-        if (len > 0 && buffer[len - 1] == '\n') {
-            buffer[len - 1] = '\0';
+    // Parse and execute complete lines published by the RX interrupts. This
+    // runs in the main loop so slow commands never delay CAN reception.
+    if (rx_restart) {
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        rx_restart = false;
+        HAL_UART_AbortReceive(&huart1);
+        UART_RxStart();
+        __set_PRIMASK(primask);
+        return;
+    }
+
+    uint32_t end = rx_line_end;
+    while ((int32_t)(end - rx_read_pos) > 0) {
+        if (rx_lapped) {
+            uint32_t primask = __get_PRIMASK();
+            __disable_irq();
+            rx_lapped = false;
+            rx_read_pos = rx_resync_pos;
+            end = rx_line_end;
+            __set_PRIMASK(primask);
+            rx_line_len = 0;
+            rx_line_overflow = true; // Drop the line cut at the resync point
+            continue;
         }
+        uint8_t byte = rx_dma_buf[rx_read_pos & (UART_RX_DMA_SIZE - 1)];
+        rx_read_pos++;
 
-        char command[4] = {0};
-        char value[32] = {0};
-        char *token;
-        char *saveptr;
-
-        token = strtok_r(buffer, ":\n", &saveptr);
-        if (token != NULL && token[0] == '!') {
-            strncpy(command, token + 1, 3);
-            token = strtok_r(NULL, ":\n", &saveptr);
-            if (token != NULL) {
-                strncpy(value, token, sizeof(value) - 1);
+        if (Proto_IsBinary()) {
+            if (byte == 0) {
+                if (rx_line_overflow) {
+                    rx_stats.overflows++;
+                } else if (rx_line_len > 0) {
+                    if (Proto_Receive((uint8_t *)rx_line, (uint16_t)rx_line_len)) {
+                        rx_stats.lines++;
+                    } else {
+                        rx_stats.bad_frames++;
+                    }
+                }
+                rx_line_len = 0;
+                rx_line_overflow = false;
+                continue;
+            }
+        } else if (byte == '\n') {
+            if (rx_line_overflow) {
+                rx_stats.overflows++; // Too long, discarded as a whole
+            } else {
+                rx_line[rx_line_len] = '\0';
+                rx_stats.lines++;
+                UART_DispatchLine(rx_line);
             }
-            ProcessAndroidCommand(command, value);
+            rx_line_len = 0;
+            rx_line_overflow = false;
+            continue;
+        } else if (byte == 0) {
+            // A binary frame while in ASCII mode: drop the partial line
+            rx_line_len = 0;
+            rx_line_overflow = false;
+            continue;
+        }
+
+        if (rx_line_len < sizeof(rx_line) - 1) {
+            rx_line[rx_line_len++] = (char)byte;
+        } else {
+            rx_line_overflow = true;
         }
     }
+#else
+ // QEMU version - Reads from stdin
+     char buffer[256];
+    if (fgets(buffer, sizeof(buffer), stdin) != NULL) {
+        UART_DispatchLine(buffer);
+    }
 #endif
 }
\ No newline at end of file
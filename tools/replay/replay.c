@@ -0,0 +1,531 @@
+// candump / Vector ASC replay through the firmware's real CAN RX path.
+//
+// Built by [env:replay] (native): src/*.c except main.c plus this file, on
+// top of lib/hal_shim in manual mode. Every logged frame is offered to the
+// bxCAN model at its log time, so it goes through the acceptance filters,
+// the 3-deep hardware FIFO, the RX interrupt, the RX ring and the decoder
+// exactly as on the target. UART output is paced at the real baud rate in
+// log time, so its drop counters are meaningful too.
+//
+// Usage: replay [-s speed] [-i irq_ms] [-l loop_ms] [-o uart.out] [-b] [-c cmd]... [-e sec]... [-q] log...
+//   -s  0 = as fast as possible (default), 1 = real time, N = N x real time
+//   -i  take the CAN RX interrupt only every irq_ms of log time (default 0 =
+//       immediately). Models long critical sections or a polled design; frames
+//       that overrun the FIFO are reported as lost.
+//   -l  run the main loop only every loop_ms of log time (default 0 = after
+//       every frame). Frames that overflow the RX ring are reported as lost.
+//   -o  write everything sent to the head unit to a file
+//   -b  talk to the head unit in binary frames (!BIN:1) instead of ASCII
+//   -c  send a command line first, e.g. -c '!SNF:1' -c '!SNF:CHG:1'
+//   -e  drive the controller bus-off at sec seconds of log time (ACK errors
+//       until TEC passes 255), to exercise the bus-off recovery
+//   -q  do not list lost frames, only count them
+
+#include "hal_shim.h"
+#include "boot.h"
+#include "can.h"
+#include "can_rx.h"
+#include "can_health.h"
+#include "can_periodic.h"
+#include "can_tx.h"
+#include "config.h"
+#include "config_store.h"
+#include "isotp.h"
+#include "keys.h"
+#include "perf.h"
+#include "proto.h"
+#include "signals.h"
+#include "sniffer.h"
+#include "status.h"
+#include "uart.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+    uint64_t t_us; // Log time relative to the first frame of the file
+    uint32_t id;
+    uint8_t dlc;
+    uint8_t data[8];
+} ReplayFrame;
+
+static struct {
+    double speed;
+    uint32_t irq_ms;
+    uint32_t loop_ms;
+    bool quiet;
+    bool binary;
+    const char *commands[16];
+    int command_count;
+    uint64_t bus_off_us[16];
+    int bus_off_count;
+    FILE *uart_out;
+} opt;
+
+static struct {
+    uint64_t frames;      // Frames read from the logs
+    uint64_t rejected;    // Not accepted by the acceptance filters
+    uint64_t fifo_lost;   // Overwritten in the hardware FIFO
+    uint64_t ring_lost;   // Dropped because the RX ring was full
+    uint64_t decoded;
+    uint64_t uart_bytes;
+    uint64_t log_us;
+    uint64_t host_ns;     // Time spent in the RX path (ISR + decode)
+    uint32_t health_tick; // Last EVT_CAN_HEALTH, which runs on its own period
+    uint32_t *latency_ns; // Per decode batch, divided by its frame count
+    size_t latency_count, latency_cap;
+} stats;
+
+void Error_Handler(void) {
+    fprintf(stderr, "replay: firmware called Error_Handler\n");
+    exit(2);
+}
+
+static uint64_t host_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000U + (uint64_t)now.tv_nsec;
+}
+
+static void uart_tx_hook(const uint8_t *data, size_t len) {
+    stats.uart_bytes += len;
+    if (opt.uart_out) {
+        fwrite(data, 1, len, opt.uart_out);
+    }
+}
+
+// --- Log parsing ---
+static int parse_hex_bytes(const char *s, uint8_t *data, bool packed) {
+    int n = 0;
+    while (n < 8) {
+        while (!packed && (*s == ' ' || *s == '\t')) {
+            s++;
+        }
+        unsigned int byte;
+        if (sscanf(s, "%2x", &byte) != 1) {
+            break;
+        }
+        data[n++] = (uint8_t)byte;
+        s += 2;
+    }
+    return n;
+}
+
+// Accepts, one frame per line:
+//   (1436509052.249713) can0 036#0E00000000       candump -l
+//   (1436509052.249713)  can0  036   [8]  0E 00 ...  candump -ta
+//   can0  036   [8]  0E 00 ...                     candump (no time)
+//   0.249713 1  36   Rx   d 8 0E 00 ...            Vector ASC
+// Extended, remote and error frames and all other lines are skipped.
+static bool parse_line(const char *line, ReplayFrame *frame, bool *has_time) {
+    double t = 0;
+    char iface[32], id_str[32], dir[8], type[8];
+    const char *rest;
+    int consumed = 0;
+
+    *has_time = false;
+    if (sscanf(line, " (%lf) %31s %n", &t, iface, &consumed) == 2) {
+        *has_time = true;
+        rest = line + consumed;
+    } else if (sscanf(line, " %lf %31s %31s %7s %7s %n", &t, iface, id_str, dir, type, &consumed) == 5) {
+        // ASC: "<time> <channel> <id>[x] Rx|Tx d <dlc> <bytes>"
+        unsigned int dlc;
+        int dlc_len = 0;
+        char *end;
+        if (strcmp(type, "d") != 0 || strchr(id_str, 'x') || sscanf(line + consumed, "%u %n", &dlc, &dlc_len) != 1 ||
+            dlc > 15U) {
+            return false;
+        }
+        rest = line + consumed + dlc_len;
+        *has_time = true;
+        frame->id = (uint32_t)strtoul(id_str, &end, 16);
+        frame->dlc = (uint8_t)dlc; // DLC 9-15 is kept, the shim reports it as bxCAN does
+        frame->t_us = (uint64_t)(t * 1e6);
+        return *end == '\0' && frame->id <= 0x7FFU &&
+               parse_hex_bytes(rest, frame->data, false) >= (dlc > 8U ? 8U : dlc);
+    } else if (sscanf(line, " %31s %n", iface, &consumed) == 1) {
+        rest = line + consumed;
+    } else {
+        return false;
+    }
+
+    char *end;
+    unsigned long id = strtoul(rest, &end, 16);
+    if (end == rest || id > 0x7FFUL || end - rest > 3) {
+        return false; // Not a standard identifier
+    }
+    frame->id = (uint32_t)id;
+    frame->t_us = (uint64_t)(t * 1e6);
+    if (*end == '#') {
+        if (end[1] == 'R') {
+            return false;
+        }
+        frame->dlc = (uint8_t)parse_hex_bytes(end + 1, frame->data, true);
+        return true;
+    }
+    unsigned int dlc;
+    if (sscanf(end, " [%u] %n", &dlc, &consumed) != 1 || dlc > 8U) {
+        return false;
+    }
+    frame->dlc = (uint8_t)dlc;
+    return parse_hex_bytes(end + consumed, frame->data, false) >= frame->dlc;
+}
+
+// --- Replay ---
+static void record_latency(uint64_t ns, uint32_t frames) {
+    if (stats.latency_count == stats.latency_cap) {
+        stats.latency_cap = stats.latency_cap ? stats.latency_cap * 2U : 4096U;
+        stats.latency_ns = realloc(stats.latency_ns, stats.latency_cap * sizeof(*stats.latency_ns));
+        if (!stats.latency_ns) {
+            perror("replay");
+            exit(1);
+        }
+    }
+    stats.latency_ns[stats.latency_count++] = (uint32_t)(ns / frames);
+}
+
+// Both RX rings (FIFO0 and FIFO1) together
+static void ring_totals(CanRxRingStats *total) {
+    memset(total, 0, sizeof(*total));
+    for (uint8_t i = 0; i < CAN_RX_RING_COUNT; i++) {
+        CanRxRingStats ring;
+        CAN_RxRing_GetStats((CanRxRingId)i, &ring);
+        total->pushed += ring.pushed;
+        total->overflows += ring.overflows;
+    }
+}
+
+// One pass of main()'s loop body. The RX ring drain is timed on its own.
+static void main_loop_pass(void) {
+    CanRxRingStats ring;
+    ring_totals(&ring);
+    uint64_t before = stats.decoded;
+    uint32_t pending = ring.pushed - (uint32_t)stats.decoded;
+
+    uint64_t t0 = host_ns();
+    CAN_ProcessPending();
+    uint64_t ns = host_ns() - t0;
+    stats.host_ns += ns;
+    stats.decoded += pending;
+    if (stats.decoded > before) {
+        record_latency(ns, (uint32_t)(stats.decoded - before));
+    }
+
+    ReceiveFromAndroid();
+    CAN_TxQueue_Service();
+    Keys_Service();
+    CheckStatusSignals();
+    Status_Service();
+    Proto_Flush(); // EVT_UART_FLUSH: one binary frame per pass
+    ConfigStore_Service(); // EVT_CONFIG_WRITE: one program step
+}
+
+// The errors a transceiver without a bus sees: every transmission goes
+// unacknowledged, TEC climbs by 8 per frame (passing warning and passive)
+// and the controller ends up bus-off.
+static void inject_bus_off(double t_s) {
+    static const uint16_t tec_steps[] = { 96, 128, 256 };
+    for (size_t i = 0; i < sizeof(tec_steps) / sizeof(tec_steps[0]); i++) {
+        HalShim_CanSetErrors(tec_steps[i], 0, 3); // LEC 3: acknowledgment error
+        HalShim_ServiceIrqs();
+    }
+    if (!opt.quiet) {
+        printf("BUSOFF %.6f injected\n", t_s);
+    }
+}
+
+// Takes the CAN RX interrupt and reports frames the RX ring had to drop.
+static void service_rx_irq(const ReplayFrame *frame, double t_s) {
+    CanRxRingStats before, after;
+    ring_totals(&before);
+    uint64_t t0 = host_ns();
+    HAL_NVIC_EnableIRQ(USB_LP_CAN1_RX0_IRQn);
+    HalShim_ServiceIrqs();
+    if (opt.irq_ms) {
+        HAL_NVIC_DisableIRQ(USB_LP_CAN1_RX0_IRQn); // Held off until the next window
+    }
+    stats.host_ns += host_ns() - t0;
+    ring_totals(&after);
+
+    uint32_t lost = after.overflows - before.overflows;
+    stats.ring_lost += lost;
+    if (lost && !opt.quiet) {
+        printf("LOST %.6f %03X ring full (%u frame%s)\n", t_s, (unsigned)frame->id, lost, lost > 1 ? "s" : "");
+    }
+}
+
+static void replay_file(FILE *log, uint64_t base_us, uint64_t *end_us, uint64_t wall_start) {
+    char line[512];
+    ReplayFrame frame;
+    bool has_time;
+    bool first = true;
+    uint64_t t0 = 0, last = 0;
+    uint64_t next_irq = 0, next_loop = 0;
+
+    while (fgets(line, sizeof(line), log)) {
+        memset(&frame, 0, sizeof(frame));
+        if (!parse_line(line, &frame, &has_time)) {
+            continue;
+        }
+        if (!has_time) {
+            frame.t_us = last + 1000U; // Untimed logs: one frame per millisecond
+        } else if (first) {
+            t0 = frame.t_us;
+        }
+        first = false;
+        uint64_t t_us = has_time ? frame.t_us - t0 : frame.t_us;
+        if (t_us < last) {
+            t_us = last; // Tolerate small reordering in merged logs
+        }
+        last = t_us;
+        uint64_t now_us = base_us + t_us;
+        double t_s = (double)now_us / 1e6;
+
+        // Bring firmware time up to the frame (SysTick, UART/CAN TX pacing)
+        while (HalShim_NowUs() + 1000U <= now_us) {
+            HalShim_AdvanceTime(1);
+        }
+        // EVT_CAN_HEALTH runs on its own period, also while no frame gets
+        // through (bus-off)
+        if (HAL_GetTick() - stats.health_tick >= CAN_HEALTH_PERIOD_MS) {
+            stats.health_tick = HAL_GetTick();
+            CAN_Health_Service();
+        }
+        for (int i = 0; i < opt.bus_off_count; i++) {
+            if (opt.bus_off_us[i] != UINT64_MAX && now_us >= opt.bus_off_us[i]) {
+                opt.bus_off_us[i] = UINT64_MAX;
+                inject_bus_off(t_s);
+            }
+        }
+        if (opt.speed > 0) {
+            uint64_t due_ns = wall_start + (uint64_t)((double)now_us * 1000.0 / opt.speed);
+            uint64_t wall = host_ns();
+            if (due_ns > wall) {
+                usleep((useconds_t)((due_ns - wall) / 1000U));
+            }
+        }
+
+        stats.frames++;
+        bool overrun;
+        uint64_t inject_start = host_ns();
+        if (!HalShim_CanInject(frame.id, frame.dlc, frame.data, &overrun)) {
+            stats.rejected++;
+            continue;
+        }
+        stats.host_ns += host_ns() - inject_start;
+        if (overrun) {
+            stats.fifo_lost++;
+            if (!opt.quiet) {
+                printf("LOST %.6f %03X hardware FIFO overrun\n", t_s, (unsigned)frame.id);
+            }
+        }
+        if (opt.irq_ms == 0 || now_us >= next_irq) {
+            service_rx_irq(&frame, t_s);
+            next_irq = now_us + opt.irq_ms * 1000U;
+        }
+        if (opt.loop_ms == 0 || now_us >= next_loop) {
+            main_loop_pass();
+            next_loop = now_us + opt.loop_ms * 1000U;
+        }
+    }
+    *end_us = base_us + last;
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static const char *perf_signal_name(uint8_t sig) {
+    static const char *const names[SIG_COUNT] = {
+#define SIGNAL_NAME(name, id, byte, bit, len, kind, scale, min, max, hyst, resp, on, off) #name,
+        SIGNAL_TABLE(SIGNAL_NAME)
+#undef SIGNAL_NAME
+    };
+    return names[sig];
+}
+
+static uint32_t percentile(double p) {
+    size_t i = (size_t)(p / 100.0 * (double)(stats.latency_count - 1U) + 0.5);
+    return stats.latency_ns[i];
+}
+
+static void report(uint64_t wall_ns) {
+    UartTxStats uart;
+    UART_TxGetStats(&uart);
+    double host_s = (double)stats.host_ns / 1e9;
+    double log_s = (double)stats.log_us / 1e6;
+
+    printf("frames      %llu read, %llu rejected by filters, %llu decoded\n",
+           (unsigned long long)stats.frames, (unsigned long long)stats.rejected,
+           (unsigned long long)stats.decoded);
+    printf("lost        %llu hardware FIFO overrun, %llu RX ring full\n",
+           (unsigned long long)stats.fifo_lost, (unsigned long long)stats.ring_lost);
+    printf("time        %.3f s of log in %.3f s (x%.0f)\n", log_s, (double)wall_ns / 1e9,
+           wall_ns ? log_s / ((double)wall_ns / 1e9) : 0.0);
+    printf("rx path     %.0f frames/s (%.3f s host time in ISR + decode)\n",
+           host_s > 0 ? (double)stats.decoded / host_s : 0.0, host_s);
+    printf("uart        %llu bytes sent (%.1f%% of 38400 baud), %u messages dropped\n",
+           (unsigned long long)stats.uart_bytes,
+           log_s > 0 ? (double)stats.uart_bytes * 10.0 / log_s / UART_BAUD_RATE * 100.0 : 0.0,
+           (unsigned)uart.dropped_msgs);
+#ifndef PERF_DISABLE
+    uint32_t hits = perf_counters[PERF_CNT_CACHE_HITS];
+    uint32_t misses = perf_counters[PERF_CNT_CACHE_MISSES];
+    printf("rx cache    %u repeats skipped, %u decoded (%.1f%% hit)\n", (unsigned)hits, (unsigned)misses,
+           hits + misses ? (double)hits * 100.0 / (double)(hits + misses) : 0.0);
+    for (uint8_t i = 0; i < SIG_COUNT; i++) {
+        PerfStats lat;
+        Perf_GetLatency(i, &lat);
+        if (lat.count) {
+            printf("latency %-5s %lu messages, frame to last UART byte us: min %lu  mean %lu  max %lu\n",
+                   perf_signal_name(i), (unsigned long)lat.count, (unsigned long)lat.min,
+                   (unsigned long)(lat.total / lat.count), (unsigned long)lat.max);
+        }
+    }
+    PerfStats fast;
+    Perf_GetStats(PERF_CAN_FAST, &fast);
+    if (fast.count) {
+        double mhz = SystemCoreClock / 1e6;
+        printf("fast path   %lu output edges, FIFO1 interrupt to pin us: min %.2f  mean %.2f  max %.2f\n",
+               (unsigned long)fast.count, fast.min / mhz, (double)fast.total / fast.count / mhz, fast.max / mhz);
+    }
+#endif
+    IsoTpStats tp;
+    IsoTp_GetStats(&tp);
+    if (tp.single + tp.complete + tp.sequence + tp.timeout + tp.oversize + tp.no_buffer + tp.aborted) {
+        printf("iso-tp      %u single, %u multi-frame, %u sequence errors, %u timeouts, %u oversize, "
+               "%u no buffer, %u aborted, %u not forwarded\n",
+               (unsigned)tp.single, (unsigned)tp.complete, (unsigned)tp.sequence, (unsigned)tp.timeout,
+               (unsigned)tp.oversize, (unsigned)tp.no_buffer, (unsigned)tp.aborted,
+               (unsigned)tp.forward_dropped);
+    }
+    CanHealthStats bus;
+    CAN_Health_GetStats(&bus);
+    printf("bus         %u warning, %u passive, %u bus-off, %u recovered, %u ACK errors, "
+           "load %.1f%% (last %u ms)\n",
+           (unsigned)bus.warnings, (unsigned)bus.passives, (unsigned)bus.bus_offs, (unsigned)bus.recoveries,
+           (unsigned)bus.ack, (double)bus.load / 10.0, CAN_HEALTH_PERIOD_MS);
+    printf("rx fifos    FIFO0 %u full, %u overrun; FIFO1 %u full, %u overrun\n", (unsigned)bus.fulls,
+           (unsigned)bus.overruns, (unsigned)bus.fulls1, (unsigned)bus.overruns1);
+    for (uint8_t i = 0; i < CAN_PERIODIC_SLOTS; i++) {
+        CanPeriodicStats ptx;
+        CAN_Periodic_GetStats(i, &ptx);
+        if (ptx.sent + ptx.missed) {
+            printf("periodic %u  %u sent, %u missed, jitter us: mean %u  max %u\n", i, (unsigned)ptx.sent,
+                   (unsigned)ptx.missed, (unsigned)(ptx.jitter_count ? ptx.jitter_sum / ptx.jitter_count : 0),
+                   (unsigned)ptx.jitter_max);
+        }
+    }
+    if (Sniffer_IsActive()) {
+        SnifferStats sniff;
+        Sniffer_GetStats(&sniff);
+        printf("sniffer     %u seen, %u sent, %u decimated, %u unchanged, %u dropped, %u untracked\n",
+               (unsigned)sniff.seen, (unsigned)sniff.sent, (unsigned)sniff.decimated,
+               (unsigned)sniff.unchanged, (unsigned)sniff.dropped, (unsigned)sniff.untracked);
+    }
+    if (stats.latency_count) {
+        qsort(stats.latency_ns, stats.latency_count, sizeof(*stats.latency_ns), cmp_u32);
+        printf("decode ns   p50 %u  p90 %u  p99 %u  p99.9 %u  max %u\n",
+               (unsigned)percentile(50), (unsigned)percentile(90), (unsigned)percentile(99),
+               (unsigned)percentile(99.9), (unsigned)stats.latency_ns[stats.latency_count - 1U]);
+    }
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: replay [-s speed] [-i irq_ms] [-l loop_ms] [-o uart.out] [-b] [-c cmd]... "
+                    "[-e sec]... [-q] log...\n");
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    int c;
+    while ((c = getopt(argc, argv, "s:i:l:o:bc:e:q")) != -1) {
+        switch (c) {
+            case 's': opt.speed = atof(optarg); break;
+            case 'i': opt.irq_ms = (uint32_t)atoi(optarg); break;
+            case 'l': opt.loop_ms = (uint32_t)atoi(optarg); break;
+            case 'q': opt.quiet = true; break;
+            case 'b': opt.binary = true; break;
+            case 'c':
+                if (opt.command_count == (int)(sizeof(opt.commands) / sizeof(opt.commands[0]))) {
+                    usage();
+                }
+                opt.commands[opt.command_count++] = optarg;
+                break;
+            case 'e':
+                if (opt.bus_off_count == (int)(sizeof(opt.bus_off_us) / sizeof(opt.bus_off_us[0]))) {
+                    usage();
+                }
+                opt.bus_off_us[opt.bus_off_count++] = (uint64_t)(atof(optarg) * 1e6);
+                break;
+            case 'o':
+                opt.uart_out = fopen(optarg, "wb");
+                if (!opt.uart_out) {
+                    perror(optarg);
+                    return 1;
+                }
+                break;
+            default: usage();
+        }
+    }
+    if (optind >= argc) {
+        usage();
+    }
+
+    HalShim_SetManual(true);
+    HalShim_UartSetTxHook(uart_tx_hook);
+    Boot_Start();
+    Boot_OutputsValid(GPIO_Status_Restore());
+    HAL_Init();
+    RCC_ClkInitTypeDef clocks = {0}; // SystemClock_Config() is in main.c: run at 72 MHz like it does
+    HAL_RCC_ClockConfig(&clocks, FLASH_LATENCY_2);
+    Boot_ClockReady();
+    load_config();
+    CAN_Init();
+    CAN_Periodic_Init();
+    UART_Init();
+    for (int i = 0; i < opt.command_count; i++) {
+        HalShim_UartInject((const uint8_t *)opt.commands[i], strlen(opt.commands[i]));
+        HalShim_UartInject((const uint8_t *)"\n", 1);
+        HalShim_ServiceIrqs();
+        ReceiveFromAndroid();
+    }
+    if (opt.binary) {
+        Proto_Command("1"); // As if the head unit had sent !BIN:1 (after the -c lines)
+    }
+    if (opt.irq_ms) {
+        HAL_NVIC_DisableIRQ(USB_LP_CAN1_RX0_IRQn);
+    }
+
+    // Logs are played back to back, each starting 1 s after the previous ended
+    uint64_t wall_start = host_ns();
+    uint64_t base_us = HalShim_NowUs();
+    for (int i = optind; i < argc; i++) {
+        FILE *log = strcmp(argv[i], "-") == 0 ? stdin : fopen(argv[i], "r");
+        if (!log) {
+            perror(argv[i]);
+            return 1;
+        }
+        uint64_t end_us;
+        replay_file(log, base_us, &end_us, wall_start);
+        stats.log_us = end_us;
+        base_us = end_us + 1000000U;
+        if (log != stdin) {
+            fclose(log);
+        }
+    }
+    main_loop_pass(); // Drain whatever a slow loop left behind
+    while (ConfigStore_Busy()) {
+        ConfigStore_Service(); // Finish a save made by a -c command
+    }
+    HalShim_AdvanceTime(100);
+
+    report(host_ns() - wall_start);
+    if (opt.uart_out) {
+        fclose(opt.uart_out);
+    }
+    return stats.fifo_lost || stats.ring_lost ? 3 : 0;
+}